@@ -0,0 +1,16 @@
+//! Criterion settings shared by the benchmarks of every crate
+//!
+//! Included with `#[path]` from each crate's `benches/`, so the crates need
+//! no common dev-dependency.  Comparing against saved baselines is covered
+//! in the README.
+
+use criterion::Criterion;
+use std::time::Duration;
+
+/// Short warm-up and measurement, with changes under 3% treated as noise
+pub fn config() -> Criterion {
+    Criterion::default()
+        .warm_up_time(Duration::from_secs(1))
+        .measurement_time(Duration::from_secs(5))
+        .noise_threshold(0.03)
+}
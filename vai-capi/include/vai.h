@@ -0,0 +1,148 @@
+/**
+ * VAI decoding C API
+ *
+ * Opens a VAI file from a path or from read/seek callbacks without loading
+ * it whole: only the header, asset records and timeline are read up front,
+ * and asset payloads are fetched when first needed.  Frames are rendered at
+ * any timestamp into caller-owned buffers, in RGBA or I420.  Tightly packed
+ * buffers are composed into directly; padded strides cost one extra copy.
+ *
+ * Handles are thread-safe: every function may be called from any thread,
+ * and concurrent calls on one handle are serialised.  Only vai_close() must
+ * not race with other calls on the same handle.
+ *
+ * Link against libvai (built from the vai-capi crate).
+ */
+
+#ifndef VAI_H
+#define VAI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct vai_decoder vai_decoder_t;
+
+typedef enum {
+    VAI_OK                   =  0,
+    VAI_ERR_INVALID_ARGUMENT = -1,
+    VAI_ERR_IO               = -2,
+    VAI_ERR_FORMAT           = -3,
+    VAI_ERR_DECODE           = -4,
+    VAI_ERR_OUT_OF_RANGE     = -5,
+    VAI_ERR_PANIC            = -6,
+} vai_status_t;
+
+typedef enum {
+    /* 4 bytes per pixel, R G B A */
+    VAI_PIXEL_RGBA = 0,
+    /* Planar YUV 4:2:0, BT.601 limited range; chroma planes are
+     * ceil(width/2) x ceil(height/2) */
+    VAI_PIXEL_I420 = 1,
+} vai_pixel_format_t;
+
+/* Byte source for vai_open_reader().  Callbacks are never invoked
+ * concurrently, but may be invoked from any thread using the handle. */
+typedef struct {
+    void *opaque;
+    /* Reads up to len bytes into buf; returns the count, 0 at end of
+     * stream, or negative on error */
+    int64_t (*read)(void *opaque, uint8_t *buf, size_t len);
+    /* Moves to absolute byte offset; returns 0 on success */
+    int (*seek)(void *opaque, uint64_t offset);
+    /* Called once when the reader is no longer needed: from vai_close(),
+     * or before a failed vai_open_reader() returns.  May be NULL. */
+    void (*release)(void *opaque);
+} vai_reader_t;
+
+typedef struct {
+    uint16_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps_num;
+    uint32_t fps_den;
+    uint64_t duration_ms;
+    uint64_t total_frames;
+    uint32_t asset_count;
+    uint32_t timeline_count;
+    uint32_t preview_count;
+} vai_info_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t width;
+    uint32_t height;
+    /* On-disk codec tag: 0 AVIF, 1 raw, 2 zstd, 3 LZ4, 4 QOI, 5 AV1 track */
+    uint8_t  codec;
+} vai_asset_info_t;
+
+typedef struct {
+    uint32_t asset_id;
+    uint64_t start_time_ms;
+    uint64_t end_time_ms;
+    int32_t  x;
+    int32_t  y;
+    int32_t  z_order;
+    uint32_t frame_index;
+} vai_timeline_entry_t;
+
+/* ── Opening ── */
+
+/* Opens the file at path (UTF-8).  On success stores a new handle in *out. */
+vai_status_t vai_open_file(const char *path, vai_decoder_t **out);
+
+/* Opens a file through callbacks.  The reader is copied; opaque must stay
+ * valid until release is called (or until vai_close() without one). */
+vai_status_t vai_open_reader(const vai_reader_t *reader, vai_decoder_t **out);
+
+/* Frees the handle.  NULL is ignored. */
+void vai_close(vai_decoder_t *decoder);
+
+/* Message for the last failed call on this thread, or NULL.  Valid until
+ * the next call on this thread. */
+const char *vai_last_error(void);
+
+/* ── Index ── */
+
+vai_status_t vai_get_info(const vai_decoder_t *decoder, vai_info_t *out);
+
+/* index < asset_count */
+vai_status_t vai_get_asset(const vai_decoder_t *decoder, uint32_t index, vai_asset_info_t *out);
+
+/* index < timeline_count; entries are in file order */
+vai_status_t vai_get_timeline_entry(const vai_decoder_t *decoder, uint32_t index,
+                                    vai_timeline_entry_t *out);
+
+/* ── Rendering ── */
+
+/* Bytes needed for a tightly packed frame in format */
+size_t vai_frame_size(const vai_decoder_t *decoder, vai_pixel_format_t format);
+
+/* Renders the frame at timestamp_ms into dst.  stride is the distance
+ * between rows in bytes (at least width * 4); 0 means tightly packed.
+ * Tightly packed frames are rendered in place, without a copy. */
+vai_status_t vai_render_rgba(vai_decoder_t *decoder, uint64_t timestamp_ms,
+                             uint8_t *dst, size_t stride);
+
+/* Renders the frame at timestamp_ms into three planes.  A stride of 0
+ * means the plane's width.  When every stride equals its plane's width,
+ * the planes are rendered in place, without a copy. */
+vai_status_t vai_render_i420(vai_decoder_t *decoder, uint64_t timestamp_ms,
+                             uint8_t *y, size_t y_stride,
+                             uint8_t *u, size_t u_stride,
+                             uint8_t *v, size_t v_stride);
+
+/* Hints that playback will continue from timestamp_ms: decodes what the
+ * next frames need in parallel, so the renders that follow start warm.
+ * Blocks until done.  format selects the cache that is warmed. */
+vai_status_t vai_prefetch(vai_decoder_t *decoder, uint64_t timestamp_ms,
+                          uint32_t frames, vai_pixel_format_t format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VAI_H */
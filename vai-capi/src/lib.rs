@@ -0,0 +1,626 @@
+//! VAI C API
+//!
+//! A general-purpose C interface to the decoder, declared in
+//! `include/vai.h`, for embedding VAI playback in other media frameworks.
+//! Unlike the VLC plugin's interface it opens files lazily from a path or
+//! from read/seek callbacks, renders any timestamp into caller-owned RGBA or
+//! I420 buffers, and its handles may be shared between threads.
+
+use std::cell::RefCell;
+use std::ffi::{c_char, c_int, c_void, CStr, CString};
+use std::fs::File;
+use std::io::{self, BufReader, Read, Seek, SeekFrom};
+use std::panic::{self, AssertUnwindSafe};
+use std::ptr;
+use std::slice;
+use std::sync::{Mutex, MutexGuard};
+use image::{ImageBuffer, Rgba, RgbaImage};
+use vai_decoder::yuv::{self, I420Frame, I420Planes};
+use vai_decoder::{DecoderConfig, FrameCompositor, PayloadReader};
+
+/// Status codes returned by every fallible call (`vai_status_t`)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum VaiStatus {
+    Ok = 0,
+    InvalidArgument = -1,
+    Io = -2,
+    Format = -3,
+    Decode = -4,
+    OutOfRange = -5,
+    Panic = -6,
+}
+
+/// `vai_pixel_format_t`; taken as a plain int so unknown values are rejected
+/// instead of being undefined behaviour
+const PIXEL_RGBA: c_int = 0;
+const PIXEL_I420: c_int = 1;
+
+/// `vai_reader_t`
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct VaiReader {
+    pub opaque: *mut c_void,
+    pub read: Option<unsafe extern "C" fn(opaque: *mut c_void, buf: *mut u8, len: usize) -> i64>,
+    pub seek: Option<unsafe extern "C" fn(opaque: *mut c_void, offset: u64) -> c_int>,
+    pub release: Option<unsafe extern "C" fn(opaque: *mut c_void)>,
+}
+
+/// `vai_info_t`
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct VaiInfo {
+    pub version: u16,
+    pub width: u32,
+    pub height: u32,
+    pub fps_num: u32,
+    pub fps_den: u32,
+    pub duration_ms: u64,
+    pub total_frames: u64,
+    pub asset_count: u32,
+    pub timeline_count: u32,
+    pub preview_count: u32,
+}
+
+/// `vai_asset_info_t`
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct VaiAssetInfo {
+    pub id: u32,
+    pub width: u32,
+    pub height: u32,
+    pub codec: u8,
+}
+
+/// `vai_timeline_entry_t`
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct VaiTimelineEntry {
+    pub asset_id: u32,
+    pub start_time_ms: u64,
+    pub end_time_ms: u64,
+    pub x: i32,
+    pub y: i32,
+    pub z_order: i32,
+    pub frame_index: u32,
+}
+
+/// The object behind a `vai_decoder_t *`
+pub struct VaiDecoder {
+    inner: Mutex<Inner>,
+    info: VaiInfo,
+}
+
+struct Inner {
+    compositor: FrameCompositor,
+    /// Reused targets for padded strides, copied out to the caller's rows;
+    /// tightly packed buffers are rendered into directly
+    rgba: Option<RgbaImage>,
+    i420: Option<I420Frame>,
+}
+
+/// A failed call: its status and the message for `vai_last_error`
+struct Failure(VaiStatus, String);
+
+type CallResult = std::result::Result<(), Failure>;
+
+impl From<vai_decoder::Error> for Failure {
+    fn from(e: vai_decoder::Error) -> Self {
+        use vai_decoder::Error as E;
+        let status = match &e {
+            E::Io(_) | E::Core(vai_core::Error::Io(_)) => VaiStatus::Io,
+            E::Core(_) | E::AssetNotFound(_) | E::SliceOutOfBounds => VaiStatus::Format,
+            E::TrackFrameOutOfRange(_) | E::InvalidTimestamp(_) => VaiStatus::OutOfRange,
+            E::RenderPanicked(_) => VaiStatus::Panic,
+            E::Image(_) | E::AvifDecode(_) | E::AvifUnsupported(_) | E::SpriteDecode(_) => VaiStatus::Decode,
+        };
+        Failure(status, e.to_string())
+    }
+}
+
+fn invalid(what: &str) -> Failure {
+    Failure(VaiStatus::InvalidArgument, what.to_string())
+}
+
+thread_local! {
+    static LAST_ERROR: RefCell<Option<CString>> = const { RefCell::new(None) };
+}
+
+/// Runs an API call: catches panics and records the error message
+fn call(f: impl FnOnce() -> CallResult) -> VaiStatus {
+    let (status, message) = match panic::catch_unwind(AssertUnwindSafe(f)) {
+        Ok(Ok(())) => (VaiStatus::Ok, None),
+        Ok(Err(Failure(status, message))) => (status, Some(message)),
+        Err(_) => (VaiStatus::Panic, Some("internal panic".to_string())),
+    };
+    LAST_ERROR.with(|last| {
+        *last.borrow_mut() = message.map(|m| CString::new(m.replace('\0', " ")).unwrap_or_default());
+    });
+    status
+}
+
+/// `Read + Seek` adapter over `vai_reader_t`
+struct CallbackReader {
+    callbacks: VaiReader,
+    position: u64,
+}
+
+// vai.h requires `opaque` to be usable from any thread; calls are serialised
+// by the decoder's mutex.
+unsafe impl Send for CallbackReader {}
+
+impl Read for CallbackReader {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        let read = self.callbacks.read.ok_or(io::ErrorKind::Unsupported)?;
+        let n = unsafe { read(self.callbacks.opaque, buf.as_mut_ptr(), buf.len()) };
+        if n < 0 {
+            return Err(io::Error::other("read callback failed"));
+        }
+        self.position += n as u64;
+        Ok(n as usize)
+    }
+}
+
+impl Seek for CallbackReader {
+    fn seek(&mut self, pos: SeekFrom) -> io::Result<u64> {
+        let target = match pos {
+            SeekFrom::Start(offset) => offset,
+            SeekFrom::Current(delta) => self
+                .position
+                .checked_add_signed(delta)
+                .ok_or(io::ErrorKind::InvalidInput)?,
+            SeekFrom::End(_) => return Err(io::ErrorKind::Unsupported.into()),
+        };
+        if target != self.position {
+            let seek = self.callbacks.seek.ok_or(io::ErrorKind::Unsupported)?;
+            if unsafe { seek(self.callbacks.opaque, target) } != 0 {
+                return Err(io::Error::other("seek callback failed"));
+            }
+            self.position = target;
+        }
+        Ok(target)
+    }
+}
+
+impl Drop for CallbackReader {
+    fn drop(&mut self) {
+        if let Some(release) = self.callbacks.release {
+            unsafe { release(self.callbacks.opaque) };
+        }
+    }
+}
+
+impl VaiDecoder {
+    fn open<R: PayloadReader + 'static>(reader: R) -> std::result::Result<Self, Failure> {
+        let compositor = FrameCompositor::open_lazy(reader, DecoderConfig::default())?;
+        let container = compositor.container();
+        let header = &container.header;
+        let info = VaiInfo {
+            version: header.version,
+            width: header.width,
+            height: header.height,
+            fps_num: header.fps_num,
+            fps_den: header.fps_den,
+            duration_ms: header.duration_ms,
+            total_frames: container.frame_count(),
+            asset_count: container.assets.len() as u32,
+            timeline_count: container.timeline.len() as u32,
+            preview_count: container.previews.len() as u32,
+        };
+        Ok(Self {
+            inner: Mutex::new(Inner {
+                compositor,
+                rgba: None,
+                i420: None,
+            }),
+            info,
+        })
+    }
+
+    fn lock(&self) -> MutexGuard<'_, Inner> {
+        // A panic mid-render leaves nothing half-updated that matters
+        self.inner.lock().unwrap_or_else(|e| e.into_inner())
+    }
+}
+
+/// Stores a new handle in `*out`
+unsafe fn hand_out(decoder: VaiDecoder, out: *mut *mut VaiDecoder) {
+    unsafe { ptr::write(out, Box::into_raw(Box::new(decoder))) };
+}
+
+unsafe fn decoder_ref<'a>(decoder: *const VaiDecoder) -> std::result::Result<&'a VaiDecoder, Failure> {
+    unsafe { decoder.as_ref() }.ok_or_else(|| invalid("null decoder"))
+}
+
+/// Copies rows of `row_len` bytes from a packed plane into a strided one
+unsafe fn copy_plane(src: &[u8], row_len: usize, dst: *mut u8, stride: usize) {
+    let stride = if stride == 0 { row_len } else { stride };
+    for (row, line) in src.chunks_exact(row_len).enumerate() {
+        unsafe { ptr::copy_nonoverlapping(line.as_ptr(), dst.add(row * stride), row_len) };
+    }
+}
+
+// ──────────────────── C-ABI functions ────────────────────
+
+/// See `vai_open_file` in vai.h
+#[no_mangle]
+pub unsafe extern "C" fn vai_open_file(path: *const c_char, out: *mut *mut VaiDecoder) -> VaiStatus {
+    call(|| {
+        if path.is_null() || out.is_null() {
+            return Err(invalid("null argument"));
+        }
+        let path = unsafe { CStr::from_ptr(path) }
+            .to_str()
+            .map_err(|_| invalid("path is not UTF-8"))?;
+        let file = File::open(path).map_err(|e| Failure(VaiStatus::Io, format!("{path}: {e}")))?;
+        let decoder = VaiDecoder::open(BufReader::new(file))?;
+        unsafe { hand_out(decoder, out) };
+        Ok(())
+    })
+}
+
+/// See `vai_open_reader` in vai.h
+#[no_mangle]
+pub unsafe extern "C" fn vai_open_reader(reader: *const VaiReader, out: *mut *mut VaiDecoder) -> VaiStatus {
+    call(|| {
+        if reader.is_null() {
+            return Err(invalid("null argument"));
+        }
+        // Owned from here on: every failure drops it, which calls `release`
+        let reader = CallbackReader {
+            callbacks: unsafe { *reader },
+            position: 0,
+        };
+        if out.is_null() {
+            return Err(invalid("null argument"));
+        }
+        if reader.callbacks.read.is_none() || reader.callbacks.seek.is_none() {
+            return Err(invalid("reader needs read and seek callbacks"));
+        }
+        let decoder = VaiDecoder::open(reader)?;
+        unsafe { hand_out(decoder, out) };
+        Ok(())
+    })
+}
+
+/// See `vai_close` in vai.h
+#[no_mangle]
+pub unsafe extern "C" fn vai_close(decoder: *mut VaiDecoder) {
+    if !decoder.is_null() {
+        let _ = panic::catch_unwind(AssertUnwindSafe(|| drop(unsafe { Box::from_raw(decoder) })));
+    }
+}
+
+/// See `vai_last_error` in vai.h
+#[no_mangle]
+pub extern "C" fn vai_last_error() -> *const c_char {
+    LAST_ERROR.with(|last| last.borrow().as_ref().map_or(ptr::null(), |m| m.as_ptr()))
+}
+
+/// See `vai_get_info` in vai.h
+#[no_mangle]
+pub unsafe extern "C" fn vai_get_info(decoder: *const VaiDecoder, out: *mut VaiInfo) -> VaiStatus {
+    call(|| {
+        let decoder = unsafe { decoder_ref(decoder)? };
+        let out = unsafe { out.as_mut() }.ok_or_else(|| invalid("null output"))?;
+        *out = decoder.info;
+        Ok(())
+    })
+}
+
+/// See `vai_get_asset` in vai.h
+#[no_mangle]
+pub unsafe extern "C" fn vai_get_asset(decoder: *const VaiDecoder, index: u32, out: *mut VaiAssetInfo) -> VaiStatus {
+    call(|| {
+        let decoder = unsafe { decoder_ref(decoder)? };
+        let out = unsafe { out.as_mut() }.ok_or_else(|| invalid("null output"))?;
+        let inner = decoder.lock();
+        let asset = inner
+            .compositor
+            .container()
+            .assets
+            .get(index as usize)
+            .ok_or_else(|| Failure(VaiStatus::OutOfRange, format!("asset index {index}")))?;
+        *out = VaiAssetInfo {
+            id: asset.id,
+            width: asset.width,
+            height: asset.height,
+            codec: asset.codec.tag(),
+        };
+        Ok(())
+    })
+}
+
+/// See `vai_get_timeline_entry` in vai.h
+#[no_mangle]
+pub unsafe extern "C" fn vai_get_timeline_entry(
+    decoder: *const VaiDecoder,
+    index: u32,
+    out: *mut VaiTimelineEntry,
+) -> VaiStatus {
+    call(|| {
+        let decoder = unsafe { decoder_ref(decoder)? };
+        let out = unsafe { out.as_mut() }.ok_or_else(|| invalid("null output"))?;
+        let inner = decoder.lock();
+        let entry = inner
+            .compositor
+            .container()
+            .timeline
+            .get(index as usize)
+            .ok_or_else(|| Failure(VaiStatus::OutOfRange, format!("timeline index {index}")))?;
+        *out = VaiTimelineEntry {
+            asset_id: entry.asset_id,
+            start_time_ms: entry.start_time_ms,
+            end_time_ms: entry.end_time_ms,
+            x: entry.position_x,
+            y: entry.position_y,
+            z_order: entry.z_order,
+            frame_index: entry.frame_index,
+        };
+        Ok(())
+    })
+}
+
+/// See `vai_frame_size` in vai.h
+#[no_mangle]
+pub unsafe extern "C" fn vai_frame_size(decoder: *const VaiDecoder, format: c_int) -> usize {
+    let Some(decoder) = (unsafe { decoder.as_ref() }) else {
+        return 0;
+    };
+    let (width, height) = (decoder.info.width, decoder.info.height);
+    match format {
+        PIXEL_RGBA => width as usize * height as usize * 4,
+        PIXEL_I420 => yuv::i420_frame_size(width, height),
+        _ => 0,
+    }
+}
+
+/// See `vai_render_rgba` in vai.h
+#[no_mangle]
+pub unsafe extern "C" fn vai_render_rgba(
+    decoder: *const VaiDecoder,
+    timestamp_ms: u64,
+    dst: *mut u8,
+    stride: usize,
+) -> VaiStatus {
+    call(|| {
+        let decoder = unsafe { decoder_ref(decoder)? };
+        let (width, height) = (decoder.info.width, decoder.info.height);
+        let row_len = width as usize * 4;
+        if dst.is_null() || (stride != 0 && stride < row_len) {
+            return Err(invalid("bad destination buffer"));
+        }
+
+        let mut inner = decoder.lock();
+        let Inner { compositor, rgba, .. } = &mut *inner;
+        if stride == 0 || stride == row_len {
+            let pixels = unsafe { slice::from_raw_parts_mut(dst, row_len * height as usize) };
+            let mut frame =
+                ImageBuffer::<Rgba<u8>, _>::from_raw(width, height, pixels).expect("sized from the header");
+            compositor.render_frame_into(timestamp_ms, &mut frame)?;
+        } else {
+            let frame = rgba.get_or_insert_with(|| RgbaImage::new(width, height));
+            compositor.render_frame_into(timestamp_ms, frame)?;
+            unsafe { copy_plane(frame.as_raw(), row_len, dst, stride) };
+        }
+        Ok(())
+    })
+}
+
+/// See `vai_render_i420` in vai.h
+#[no_mangle]
+pub unsafe extern "C" fn vai_render_i420(
+    decoder: *const VaiDecoder,
+    timestamp_ms: u64,
+    y: *mut u8,
+    y_stride: usize,
+    u: *mut u8,
+    u_stride: usize,
+    v: *mut u8,
+    v_stride: usize,
+) -> VaiStatus {
+    call(|| {
+        let decoder = unsafe { decoder_ref(decoder)? };
+        let (width, height) = (decoder.info.width, decoder.info.height);
+        let (chroma_width, _) = yuv::chroma_dimensions(width, height);
+        let (luma_row, chroma_row) = (width as usize, chroma_width as usize);
+        if y.is_null() || u.is_null() || v.is_null() {
+            return Err(invalid("null plane"));
+        }
+        if (y_stride != 0 && y_stride < luma_row)
+            || (u_stride != 0 && u_stride < chroma_row)
+            || (v_stride != 0 && v_stride < chroma_row)
+        {
+            return Err(invalid("stride smaller than the plane width"));
+        }
+
+        let mut inner = decoder.lock();
+        let Inner { compositor, i420, .. } = &mut *inner;
+        let tight = |stride, row| stride == 0 || stride == row;
+        if tight(y_stride, luma_row) && tight(u_stride, chroma_row) && tight(v_stride, chroma_row) {
+            let chroma_len = chroma_row * yuv::chroma_dimensions(width, height).1 as usize;
+            let mut planes = unsafe {
+                I420Planes::new(
+                    width,
+                    height,
+                    slice::from_raw_parts_mut(y, luma_row * height as usize),
+                    slice::from_raw_parts_mut(u, chroma_len),
+                    slice::from_raw_parts_mut(v, chroma_len),
+                )
+            }
+            .expect("sized from the header");
+            compositor.render_frame_i420_into(timestamp_ms, &mut planes)?;
+            return Ok(());
+        }
+
+        let frame = i420.get_or_insert_with(|| I420Frame::new(width, height));
+        compositor.render_frame_i420_into(timestamp_ms, frame)?;
+
+        let (src_y, src_u, src_v) = frame.planes();
+        unsafe {
+            copy_plane(src_y, luma_row, y, y_stride);
+            copy_plane(src_u, chroma_row, u, u_stride);
+            copy_plane(src_v, chroma_row, v, v_stride);
+        }
+        Ok(())
+    })
+}
+
+/// See `vai_prefetch` in vai.h
+#[no_mangle]
+pub unsafe extern "C" fn vai_prefetch(
+    decoder: *const VaiDecoder,
+    timestamp_ms: u64,
+    frames: u32,
+    format: c_int,
+) -> VaiStatus {
+    call(|| {
+        let decoder = unsafe { decoder_ref(decoder)? };
+        let i420 = match format {
+            PIXEL_RGBA => false,
+            PIXEL_I420 => true,
+            _ => return Err(invalid("unknown pixel format")),
+        };
+        decoder.lock().compositor.warm(timestamp_ms, frames, i420)?;
+        Ok(())
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use vai_core::{Asset, AssetCodec, TimelineEntry, VaiContainer, VaiHeader};
+
+    struct Memory {
+        data: Vec<u8>,
+        position: usize,
+        released: bool,
+    }
+
+    unsafe extern "C" fn memory_read(opaque: *mut c_void, buf: *mut u8, len: usize) -> i64 {
+        let memory = unsafe { &mut *(opaque as *mut Memory) };
+        let n = len.min(memory.data.len() - memory.position);
+        unsafe { ptr::copy_nonoverlapping(memory.data[memory.position..].as_ptr(), buf, n) };
+        memory.position += n;
+        n as i64
+    }
+
+    unsafe extern "C" fn memory_seek(opaque: *mut c_void, offset: u64) -> c_int {
+        let memory = unsafe { &mut *(opaque as *mut Memory) };
+        memory.position = (offset as usize).min(memory.data.len());
+        0
+    }
+
+    unsafe extern "C" fn memory_release(opaque: *mut c_void) {
+        unsafe { (*(opaque as *mut Memory)).released = true };
+    }
+
+    fn memory_reader(memory: &mut Memory) -> VaiReader {
+        VaiReader {
+            opaque: memory as *mut Memory as *mut c_void,
+            read: Some(memory_read),
+            seek: Some(memory_seek),
+            release: Some(memory_release),
+        }
+    }
+
+    /// A file with one 4x2 raw sprite covering the frame: a dark row over a light one
+    fn two_row_file() -> Memory {
+        let header = VaiHeader::new(4, 2, 30, 1, 1000, 1, 1);
+        let pixels: Vec<u8> = [10u8, 200].iter().flat_map(|&v| [v, v, v, 255].repeat(4)).collect();
+        let asset = Asset::with_codec(7, 4, 2, AssetCodec::Raw, pixels);
+        let timeline = vec![TimelineEntry::new(7, 0, 1000, 0, 0, 0)];
+        let mut data = Vec::new();
+        VaiContainer::new(header, vec![asset], timeline).write(&mut data).unwrap();
+        Memory {
+            data,
+            position: 0,
+            released: false,
+        }
+    }
+
+    #[test]
+    fn test_open_reader_exposes_index() {
+        let mut memory = two_row_file();
+        let reader = memory_reader(&mut memory);
+
+        unsafe {
+            let mut decoder = ptr::null_mut();
+            assert_eq!(vai_open_reader(&reader, &mut decoder), VaiStatus::Ok);
+
+            let mut info = VaiInfo::default();
+            assert_eq!(vai_get_info(decoder, &mut info), VaiStatus::Ok);
+            assert_eq!((info.width, info.height, info.total_frames), (4, 2, 30));
+            assert_eq!((info.asset_count, info.timeline_count), (1, 1));
+
+            let mut asset = VaiAssetInfo::default();
+            assert_eq!(vai_get_asset(decoder, 0, &mut asset), VaiStatus::Ok);
+            assert_eq!((asset.id, asset.codec), (7, AssetCodec::Raw.tag()));
+            assert_eq!(vai_get_asset(decoder, 1, &mut asset), VaiStatus::OutOfRange);
+            assert!(!vai_last_error().is_null());
+
+            assert_eq!(vai_frame_size(decoder, PIXEL_I420), 4 * 2 + 2 * 2);
+            vai_close(decoder);
+        }
+        assert!(memory.released);
+    }
+
+    #[test]
+    fn test_open_reader_releases_on_invalid_reader() {
+        let mut memory = two_row_file();
+        let mut reader = memory_reader(&mut memory);
+        reader.seek = None;
+
+        let mut decoder = ptr::null_mut();
+        let status = unsafe { vai_open_reader(&reader, &mut decoder) };
+        assert_eq!(status, VaiStatus::InvalidArgument);
+        assert!(decoder.is_null());
+        assert!(memory.released);
+    }
+
+    #[test]
+    fn test_render_honours_strides() {
+        let mut memory = two_row_file();
+        let reader = memory_reader(&mut memory);
+        const PAD: u8 = 0xAA;
+
+        unsafe {
+            let mut decoder = ptr::null_mut();
+            assert_eq!(vai_open_reader(&reader, &mut decoder), VaiStatus::Ok);
+
+            // RGBA rows of 16 bytes in a 20-byte stride
+            let mut rgba = vec![PAD; 20 * 2];
+            assert_eq!(vai_render_rgba(decoder, 0, rgba.as_mut_ptr(), 20), VaiStatus::Ok);
+            for (row, value) in [(0, 10u8), (1, 200)] {
+                let line = &rgba[row * 20..][..20];
+                assert_eq!(&line[..16], &[value, value, value, 255].repeat(4)[..], "row {row}");
+                assert!(line[16..].iter().all(|&b| b == PAD), "row {row} padding");
+            }
+            let mut short = vec![0u8; 20 * 2];
+            assert_eq!(vai_render_rgba(decoder, 0, short.as_mut_ptr(), 12), VaiStatus::InvalidArgument);
+
+            // I420 luma rows of 4 bytes in 7, chroma rows of 2 in 5
+            let (mut y, mut u, mut v) = (vec![PAD; 7 * 2], vec![PAD; 5], vec![PAD; 5]);
+            let status = vai_render_i420(decoder, 0, y.as_mut_ptr(), 7, u.as_mut_ptr(), 5, v.as_mut_ptr(), 5);
+            assert_eq!(status, VaiStatus::Ok);
+            let (dark, light) = (y[0], y[7]);
+            assert!(dark < light);
+            assert!(y[..4].iter().all(|&b| b == dark) && y[7..11].iter().all(|&b| b == light));
+            assert!(y[4..7].iter().chain(&y[11..]).all(|&b| b == PAD));
+            for plane in [&u, &v] {
+                assert!(plane[..2].iter().all(|&b| b != PAD) && plane[2..].iter().all(|&b| b == PAD));
+            }
+
+            // Tightly packed buffers are rendered in place, to the same pixels
+            let mut tight = vec![PAD; 16 * 2];
+            assert_eq!(vai_render_rgba(decoder, 0, tight.as_mut_ptr(), 16), VaiStatus::Ok);
+            assert_eq!(tight, [&rgba[..16], &rgba[20..36]].concat());
+            let (mut ty, mut tu, mut tv) = (vec![PAD; 4 * 2], vec![PAD; 2], vec![PAD; 2]);
+            let status = vai_render_i420(decoder, 0, ty.as_mut_ptr(), 0, tu.as_mut_ptr(), 0, tv.as_mut_ptr(), 0);
+            assert_eq!(status, VaiStatus::Ok);
+            assert_eq!(ty, [&y[..4], &y[7..11]].concat());
+            assert_eq!((&tu[..], &tv[..]), (&u[..2], &v[..2]));
+            vai_close(decoder);
+        }
+    }
+}
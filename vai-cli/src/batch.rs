@@ -0,0 +1,249 @@
+//! `vai encode-batch`: many inputs, one set of workers
+//!
+//! Encoding short clips one process at a time leaves most cores idle: each
+//! clip's chunks are too small to fill a thread per core, and scene
+//! detection is serial.  The batch encoder keeps `jobs` files in flight,
+//! pulled from one shared queue, and splits the machine between them: every
+//! file encodes with its share of the threads and buffers at most its share
+//! of the memory budget, so while one file detects scenes the others keep
+//! the encoder threads busy.  FFmpeg is initialised once for the process.
+//!
+//! The split is static, not one pool fed by every file: each file keeps its
+//! `cores / jobs` threads and `memory / jobs` frame budget from start to
+//! finish, and runs its own parallel steps on them.  The encoder's parallel
+//! steps are scoped to one file's chunk, so sharing threads across files
+//! would mean a scheduler inside the encoder.  The cost is the tail of a
+//! batch: once fewer files than `jobs` remain, their shares do not grow and
+//! the freed cores sit idle.  Order long inputs first to keep the tail short.
+
+use anyhow::{anyhow, bail, Context, Result};
+use std::collections::HashMap;
+use std::panic::{self, AssertUnwindSafe};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::Mutex;
+use std::thread;
+use std::time::{Duration, Instant};
+use vai_encoder::{EncoderConfig, SceneAnalyzer};
+
+/// How a batch shares the machine
+pub struct BatchOptions {
+    /// Files encoded at once (0 = one per four cores)
+    pub jobs: usize,
+    /// Raw frame memory shared by all files in flight, in MiB
+    pub memory_mb: u64,
+    /// Re-encode inputs whose output already exists
+    pub overwrite: bool,
+    pub time_ordered: bool,
+}
+
+/// Outcome of one input
+struct FileResult {
+    input: PathBuf,
+    output: PathBuf,
+    elapsed: Duration,
+    outcome: Result<Encoded>,
+}
+
+enum Encoded {
+    Written { assets: usize, bytes: u64 },
+    /// Output already existed
+    Skipped,
+}
+
+/// Encodes every video in `inputs` (files, directories, or `@list` files
+/// with one path per line) into `output_dir`
+pub fn encode_batch(
+    inputs: Vec<PathBuf>,
+    output_dir: PathBuf,
+    config: EncoderConfig,
+    options: BatchOptions,
+) -> Result<()> {
+    let files = collect_inputs(&inputs)?;
+    if files.is_empty() {
+        bail!("No input files found");
+    }
+    let outputs: Vec<PathBuf> = files.iter().map(|input| output_path(&output_dir, input)).collect();
+    check_unique_outputs(&files, &outputs)?;
+    std::fs::create_dir_all(&output_dir).context("Failed to create output directory")?;
+
+    let cores = thread::available_parallelism().map_or(1, |n| n.get());
+    let jobs = match options.jobs {
+        0 => (cores / 4).max(1),
+        n => n,
+    }
+    .min(files.len());
+    let threads = cores.div_ceil(jobs);
+    let chunk_bytes = (options.memory_mb << 20) / jobs as u64;
+
+    println!(
+        "Encoding {} file(s) to {}: {} at a time, {} threads and {} MiB of frames each",
+        files.len(),
+        output_dir.display(),
+        jobs,
+        threads,
+        chunk_bytes >> 20
+    );
+    if config.use_ffmpeg {
+        match vai_encoder::ffmpeg_encoder::best_encoder_name() {
+            Some(name) => println!("AVIF encoder: FFmpeg ({name})"),
+            None => println!("AVIF encoder: ravif (FFmpeg AV1 not available, falling back)"),
+        }
+    }
+
+    // Shares are fixed per file (see the module docs), so memory and threads
+    // never exceed the budget even when files start and finish out of step.
+    // Files in flight would interleave their progress; each gets one line
+    // from `report` instead
+    let mut analyzer = SceneAnalyzer::new(config).with_resources(threads, chunk_bytes);
+    if jobs > 1 {
+        analyzer = analyzer.quiet();
+    }
+    let next = AtomicUsize::new(0);
+    let results = Mutex::new(Vec::with_capacity(files.len()));
+    let started = Instant::now();
+
+    thread::scope(|scope| {
+        for _ in 0..jobs {
+            scope.spawn(|| loop {
+                let index = next.fetch_add(1, Ordering::Relaxed);
+                let Some(input) = files.get(index) else {
+                    return;
+                };
+                let output = outputs[index].clone();
+                let result = encode_one(&analyzer, input, output, &options, threads);
+                report(index, files.len(), &result);
+                results.lock().unwrap().push((index, result));
+            });
+        }
+    });
+
+    crate::print_stage_times();
+    let mut results = results.into_inner().unwrap();
+    results.sort_by_key(|(index, _)| *index);
+    summarize(results.into_iter().map(|(_, r)| r).collect(), started.elapsed())
+}
+
+/// Expands directories (non-recursively, sorted) and `@list` files
+fn collect_inputs(inputs: &[PathBuf]) -> Result<Vec<PathBuf>> {
+    let mut files = Vec::new();
+    for input in inputs {
+        if let Some(list) = input.to_str().and_then(|s| s.strip_prefix('@')) {
+            let text = std::fs::read_to_string(list).with_context(|| format!("Failed to read list {list}"))?;
+            files.extend(
+                text.lines()
+                    .map(str::trim)
+                    .filter(|line| !line.is_empty() && !line.starts_with('#'))
+                    .map(PathBuf::from),
+            );
+        } else if input.is_dir() {
+            let mut entries: Vec<PathBuf> = std::fs::read_dir(input)
+                .with_context(|| format!("Failed to list {}", input.display()))?
+                .filter_map(|entry| entry.ok().map(|e| e.path()))
+                .filter(|path| path.is_file() && path.extension().is_none_or(|ext| !ext.eq_ignore_ascii_case("vai")))
+                .collect();
+            entries.sort();
+            files.extend(entries);
+        } else {
+            files.push(input.clone());
+        }
+    }
+    Ok(files)
+}
+
+/// `<output_dir>/<input stem>.vai`
+fn output_path(output_dir: &Path, input: &Path) -> PathBuf {
+    let stem = input.file_stem().unwrap_or(input.as_os_str());
+    output_dir.join(format!("{}.vai", stem.to_string_lossy()))
+}
+
+/// Fails if two inputs would be written to the same output, e.g. `a/clip.mp4`
+/// and `b/clip.mov`; one would silently overwrite (or skip) the other
+fn check_unique_outputs(files: &[PathBuf], outputs: &[PathBuf]) -> Result<()> {
+    let mut seen: HashMap<&Path, &Path> = HashMap::with_capacity(files.len());
+    for (input, output) in files.iter().zip(outputs) {
+        if let Some(first) = seen.insert(output, input) {
+            bail!(
+                "{} and {} would both be encoded to {}; rename one or encode them separately",
+                first.display(),
+                input.display(),
+                output.display()
+            );
+        }
+    }
+    Ok(())
+}
+
+fn encode_one(
+    analyzer: &SceneAnalyzer,
+    input: &Path,
+    output: PathBuf,
+    options: &BatchOptions,
+    io_threads: usize,
+) -> FileResult {
+    let started = Instant::now();
+    let outcome = if output.exists() && !options.overwrite {
+        Ok(Encoded::Skipped)
+    } else {
+        // One bad input must not take the rest of the batch down with it
+        panic::catch_unwind(AssertUnwindSafe(|| {
+            crate::encode_file(input, &output, analyzer, options.time_ordered, io_threads)
+        }))
+        .unwrap_or_else(|_| Err(anyhow!("encoder panicked")))
+        .and_then(|container| {
+            let bytes = std::fs::metadata(&output).context("Failed to stat output")?.len();
+            Ok(Encoded::Written {
+                assets: container.assets.len(),
+                bytes,
+            })
+        })
+    };
+    FileResult {
+        input: input.to_path_buf(),
+        output,
+        elapsed: started.elapsed(),
+        outcome,
+    }
+}
+
+fn report(index: usize, total: usize, result: &FileResult) {
+    let prefix = format!("[{}/{}] {}", index + 1, total, result.input.display());
+    match &result.outcome {
+        Ok(Encoded::Written { assets, bytes }) => println!(
+            "{prefix}: ok, {assets} assets, {:.1} MiB in {:.1}s -> {}",
+            *bytes as f64 / (1 << 20) as f64,
+            result.elapsed.as_secs_f64(),
+            result.output.display()
+        ),
+        Ok(Encoded::Skipped) => println!("{prefix}: skipped, {} exists", result.output.display()),
+        Err(e) => println!("{prefix}: FAILED: {e:#}"),
+    }
+}
+
+/// Prints the totals and fails if any input failed
+fn summarize(results: Vec<FileResult>, elapsed: Duration) -> Result<()> {
+    let failed: Vec<&FileResult> = results.iter().filter(|r| r.outcome.is_err()).collect();
+    let skipped = results
+        .iter()
+        .filter(|r| matches!(r.outcome, Ok(Encoded::Skipped)))
+        .count();
+    let written = results.len() - failed.len() - skipped;
+
+    println!(
+        "\nBatch finished in {:.1}s: {} encoded, {} skipped, {} failed",
+        elapsed.as_secs_f64(),
+        written,
+        skipped,
+        failed.len()
+    );
+    for result in &failed {
+        if let Err(e) = &result.outcome {
+            println!("  {}: {e:#}", result.input.display());
+        }
+    }
+
+    if !failed.is_empty() {
+        bail!("{} of {} file(s) failed", failed.len(), results.len());
+    }
+    Ok(())
+}
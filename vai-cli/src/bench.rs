@@ -0,0 +1,442 @@
+//! `vai bench`: end-to-end throughput of one file
+//!
+//! For a `.vai` file, plays it back twice on fresh compositors: once
+//! sequentially, as a player does, and once as a series of random seeks,
+//! each warming the caches and rendering the target frame as a player does
+//! after a seek.  Both report frames per second, per-frame latency
+//! percentiles, the asset cache hit rate and peak RSS.
+//!
+//! For a source video, runs each encoder stage on its own (FFmpeg decode,
+//! scene detection, scene analysis and AVIF encoding, container
+//! serialisation) and reports the throughput of each.
+//!
+//! Results are printed as a table and can also be written as JSON, so runs
+//! over a corpus can be compared between machines and releases.  With JSON
+//! on stdout, the table and all progress go to stderr.
+
+use anyhow::{Context, Result};
+use serde::Serialize;
+use std::fs::File;
+use std::io::{BufReader, Read, Write};
+use std::path::{Path, PathBuf};
+use std::time::{Duration, Instant};
+use vai_decoder::{DecoderConfig, FrameCompositor};
+use vai_encoder::scene_detector::{self, SceneDetectorConfig};
+use vai_encoder::{EncoderConfig, SceneAnalyzer, VideoReader};
+
+/// What to measure and where the JSON report goes
+pub struct BenchOptions {
+    /// Frames played back sequentially (0 = the whole file)
+    pub frames: u64,
+    /// Random seeks
+    pub seeks: usize,
+    /// Seeds the seek pattern
+    pub seed: u64,
+    /// Render in I420 instead of RGBA
+    pub i420: bool,
+    /// Write the report as JSON to this path (`-` = stdout)
+    pub json: Option<PathBuf>,
+    /// Encoder settings for source videos
+    pub encoder: EncoderConfig,
+}
+
+#[derive(Serialize)]
+struct Report {
+    input: String,
+    /// "decode" for VAI files, "encode" for source videos
+    kind: &'static str,
+    width: u32,
+    height: u32,
+    fps: f64,
+    #[serde(skip_serializing_if = "Vec::is_empty")]
+    playback: Vec<PlaybackReport>,
+    #[serde(skip_serializing_if = "Vec::is_empty")]
+    stages: Vec<StageReport>,
+    /// Peak resident set size of the whole run
+    peak_rss_bytes: Option<u64>,
+}
+
+#[derive(Serialize)]
+struct PlaybackReport {
+    /// "sequential" or "random_seek"
+    pattern: &'static str,
+    frames: u64,
+    seconds: f64,
+    fps: f64,
+    latency_ms: Latency,
+    cache_hits: u64,
+    cache_misses: u64,
+    cache_hit_rate: f64,
+    /// Peak resident set size during this pattern
+    peak_rss_bytes: Option<u64>,
+}
+
+#[derive(Serialize)]
+struct Latency {
+    mean: f64,
+    p50: f64,
+    p90: f64,
+    p99: f64,
+    max: f64,
+}
+
+#[derive(Serialize)]
+struct StageReport {
+    stage: &'static str,
+    frames: u64,
+    seconds: f64,
+    fps: f64,
+    megapixels_per_sec: f64,
+    /// Stage output, where it has a size
+    #[serde(skip_serializing_if = "Option::is_none")]
+    output_bytes: Option<u64>,
+    peak_rss_bytes: Option<u64>,
+}
+
+impl BenchOptions {
+    /// Whether the JSON report goes to stdout, which must then carry nothing else
+    fn json_on_stdout(&self) -> bool {
+        self.json.as_deref() == Some(Path::new("-"))
+    }
+}
+
+pub fn bench(input: PathBuf, options: BenchOptions) -> Result<()> {
+    let report = if is_vai(&input)? {
+        bench_decode(&input, &options)?
+    } else {
+        bench_encode(&input, &options)?
+    };
+
+    if options.json_on_stdout() {
+        print_report(&mut std::io::stderr().lock(), &report)?;
+    } else {
+        print_report(&mut std::io::stdout().lock(), &report)?;
+    }
+    match options.json.as_deref() {
+        Some(path) if path == Path::new("-") => {
+            let mut out = std::io::stdout().lock();
+            serde_json::to_writer_pretty(&mut out, &report)?;
+            writeln!(out)?;
+        }
+        Some(path) => {
+            let file = File::create(path).with_context(|| format!("Failed to create {}", path.display()))?;
+            serde_json::to_writer_pretty(file, &report)?;
+            println!("\nWrote JSON report to {}", path.display());
+        }
+        None => {}
+    }
+    Ok(())
+}
+
+/// Whether `path` starts with the VAI magic
+fn is_vai(path: &Path) -> Result<bool> {
+    let mut magic = [0u8; 4];
+    let mut file = File::open(path).with_context(|| format!("Failed to open {}", path.display()))?;
+    Ok(file.read_exact(&mut magic).is_ok() && magic == *b"VAI\0")
+}
+
+fn open_compositor(path: &Path) -> Result<FrameCompositor> {
+    let file = File::open(path).context("Failed to open input")?;
+    FrameCompositor::open_lazy(BufReader::new(file), DecoderConfig::default()).context("Failed to read VAI index")
+}
+
+fn bench_decode(input: &Path, options: &BenchOptions) -> Result<Report> {
+    let compositor = open_compositor(input)?;
+    let container = compositor.container();
+    let header = &container.header;
+    let total = container.frame_count();
+    let mut report = Report {
+        input: input.display().to_string(),
+        kind: "decode",
+        width: header.width,
+        height: header.height,
+        fps: container.fps(),
+        playback: Vec::new(),
+        stages: Vec::new(),
+        peak_rss_bytes: None,
+    };
+    drop(compositor);
+
+    // Sequential playback
+    let frames = match options.frames {
+        0 => total,
+        n => n.min(total),
+    };
+    eprintln!("Sequential playback of {frames} frames …");
+    let mut compositor = open_compositor(input)?;
+    reset_peak_rss();
+    let mut latencies = Vec::with_capacity(frames as usize);
+    let started = Instant::now();
+    if options.i420 {
+        let mut iter = compositor.frames_i420(0..frames);
+        for _ in 0..frames {
+            timed(&mut latencies, || iter.next().map(|f| f.map(|_| ())))
+                .context("Frames ended early")?
+                .context("Failed to render frame")?;
+        }
+    } else {
+        let mut iter = compositor.frames(0..frames);
+        for _ in 0..frames {
+            timed(&mut latencies, || iter.next().map(|f| f.map(|_| ())))
+                .context("Frames ended early")?
+                .context("Failed to render frame")?;
+        }
+    }
+    report
+        .playback
+        .push(playback_report("sequential", started.elapsed(), latencies, &compositor));
+
+    // Random seeks: warm the caches for the target, then render it
+    eprintln!("Random playback of {} seeks …", options.seeks);
+    let mut compositor = open_compositor(input)?;
+    reset_peak_rss();
+    let mut rng = options.seed.wrapping_mul(0x9E37_79B9_7F4A_7C15) | 1;
+    let mut latencies = Vec::with_capacity(options.seeks);
+    let started = Instant::now();
+    for _ in 0..options.seeks {
+        // xorshift64
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        let ts = compositor.container().frame_timestamp_ms(rng % total);
+        timed(&mut latencies, || -> Result<()> {
+            compositor.warm(ts, 1, options.i420)?;
+            if options.i420 {
+                compositor.render_frame_i420(ts)?;
+            } else {
+                compositor.render_frame(ts)?;
+            }
+            Ok(())
+        })
+        .with_context(|| format!("Failed to render frame at {ts} ms"))?;
+    }
+    report
+        .playback
+        .push(playback_report("random_seek", started.elapsed(), latencies, &compositor));
+
+    report.peak_rss_bytes = report.playback.iter().filter_map(|p| p.peak_rss_bytes).max();
+    Ok(report)
+}
+
+/// Runs `f`, appending its duration to `latencies`
+fn timed<T>(latencies: &mut Vec<Duration>, f: impl FnOnce() -> T) -> T {
+    let started = Instant::now();
+    let result = f();
+    latencies.push(started.elapsed());
+    result
+}
+
+fn playback_report(
+    pattern: &'static str,
+    elapsed: Duration,
+    latencies: Vec<Duration>,
+    compositor: &FrameCompositor,
+) -> PlaybackReport {
+    let frames = latencies.len() as u64;
+    let stats = compositor.cache_stats();
+    PlaybackReport {
+        pattern,
+        frames,
+        seconds: elapsed.as_secs_f64(),
+        fps: frames as f64 / elapsed.as_secs_f64().max(f64::EPSILON),
+        latency_ms: latency(latencies),
+        cache_hits: stats.hits,
+        cache_misses: stats.misses,
+        cache_hit_rate: stats.hit_rate(),
+        peak_rss_bytes: peak_rss(),
+    }
+}
+
+fn latency(mut samples: Vec<Duration>) -> Latency {
+    if samples.is_empty() {
+        return Latency {
+            mean: 0.0,
+            p50: 0.0,
+            p90: 0.0,
+            p99: 0.0,
+            max: 0.0,
+        };
+    }
+    samples.sort();
+    let ms = |d: Duration| d.as_secs_f64() * 1000.0;
+    // Nearest-rank percentile
+    let rank = |p: f64| ms(samples[((p * samples.len() as f64).ceil() as usize).clamp(1, samples.len()) - 1]);
+    Latency {
+        mean: ms(samples.iter().sum::<Duration>()) / samples.len() as f64,
+        p50: rank(0.50),
+        p90: rank(0.90),
+        p99: rank(0.99),
+        max: ms(*samples.last().unwrap()),
+    }
+}
+
+fn bench_encode(input: &Path, options: &BenchOptions) -> Result<Report> {
+    let input_str = input.to_str().context("Invalid input path")?;
+    let open = || VideoReader::open(input_str).context("Failed to open video file");
+    let reader = open()?;
+    let (width, height) = (reader.width(), reader.height());
+    let (fps_num, fps_den) = reader.frame_rate();
+    let duration_ms = reader.duration_ms();
+    drop(reader);
+
+    let mut report = Report {
+        input: input.display().to_string(),
+        kind: "encode",
+        width,
+        height,
+        fps: fps_num as f64 / fps_den.max(1) as f64,
+        playback: Vec::new(),
+        stages: Vec::new(),
+        peak_rss_bytes: None,
+    };
+    let pixels = width as f64 * height as f64;
+    let stage = |name: &'static str, frames: u64, elapsed: Duration, output_bytes| StageReport {
+        stage: name,
+        frames,
+        seconds: elapsed.as_secs_f64(),
+        fps: frames as f64 / elapsed.as_secs_f64().max(f64::EPSILON),
+        megapixels_per_sec: frames as f64 * pixels / 1e6 / elapsed.as_secs_f64().max(f64::EPSILON),
+        output_bytes,
+        peak_rss_bytes: peak_rss(),
+    };
+
+    // Decode only: the floor under every pass
+    eprintln!("Stage 1/4: decoding …");
+    let mut reader = open()?;
+    reset_peak_rss();
+    let started = Instant::now();
+    let mut frames = 0u64;
+    reader.read_frames_streaming(|_, _| {
+        frames += 1;
+        Ok(())
+    })?;
+    report.stages.push(stage("decode", frames, started.elapsed(), None));
+
+    eprintln!("Stage 2/4: scene detection …");
+    let mut reader = open()?;
+    reset_peak_rss();
+    let started = Instant::now();
+    let detector = SceneDetectorConfig {
+        verbose: !options.json_on_stdout(),
+        ..SceneDetectorConfig::default()
+    };
+    let mut segments = scene_detector::detect_scenes(&mut reader, &detector).context("Failed to detect scenes")?;
+    report.stages.push(stage("scene_detect", frames, started.elapsed(), None));
+    if let Some(last) = segments.last_mut() {
+        if last.end_frame == usize::MAX {
+            last.end_frame = frames as usize;
+        }
+    }
+
+    eprintln!("Stage 3/4: analysis and encoding ({} scenes) …", segments.len());
+    let mut reader = open()?;
+    let mut analyzer = SceneAnalyzer::new(options.encoder.clone());
+    if options.json_on_stdout() {
+        analyzer = analyzer.quiet();
+    }
+    reset_peak_rss();
+    let started = Instant::now();
+    let container = analyzer
+        .analyze_parallel(&mut reader, segments, width, height, fps_num, fps_den, duration_ms)
+        .context("Failed to encode video")?;
+    report.stages.push(stage("encode", frames, started.elapsed(), None));
+
+    eprintln!("Stage 4/4: serialising …");
+    reset_peak_rss();
+    let started = Instant::now();
+    let mut counter = ByteCounter(0);
+    container.write(&mut counter).context("Failed to serialise container")?;
+    report.stages.push(stage("write", frames, started.elapsed(), Some(counter.0)));
+
+    report.peak_rss_bytes = report.stages.iter().filter_map(|s| s.peak_rss_bytes).max();
+    Ok(report)
+}
+
+/// Discards what is written, counting the bytes
+struct ByteCounter(u64);
+
+impl Write for ByteCounter {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        self.0 += buf.len() as u64;
+        Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        Ok(())
+    }
+}
+
+fn print_report(out: &mut impl Write, report: &Report) -> std::io::Result<()> {
+    writeln!(
+        out,
+        "\n{} ({}x{} @ {:.3} fps)",
+        report.input, report.width, report.height, report.fps
+    )?;
+    let mib = |bytes: Option<u64>| bytes.map_or("n/a".to_string(), |b| format!("{:.1} MiB", b as f64 / (1 << 20) as f64));
+
+    if !report.playback.is_empty() {
+        writeln!(
+            out,
+            "\n{:<12} {:>7} {:>9} {:>9} {:>9} {:>9} {:>9} {:>8} {:>11}",
+            "pattern", "frames", "fps", "mean ms", "p50 ms", "p90 ms", "p99 ms", "cache", "peak rss"
+        )?;
+        for p in &report.playback {
+            writeln!(
+                out,
+                "{:<12} {:>7} {:>9.1} {:>9.2} {:>9.2} {:>9.2} {:>9.2} {:>7.1}% {:>11}",
+                p.pattern,
+                p.frames,
+                p.fps,
+                p.latency_ms.mean,
+                p.latency_ms.p50,
+                p.latency_ms.p90,
+                p.latency_ms.p99,
+                p.cache_hit_rate * 100.0,
+                mib(p.peak_rss_bytes)
+            )?;
+        }
+    }
+
+    if !report.stages.is_empty() {
+        writeln!(
+            out,
+            "\n{:<13} {:>7} {:>9} {:>9} {:>9} {:>11}",
+            "stage", "frames", "seconds", "fps", "MP/s", "peak rss"
+        )?;
+        for s in &report.stages {
+            writeln!(
+                out,
+                "{:<13} {:>7} {:>9.2} {:>9.1} {:>9.1} {:>11}",
+                s.stage,
+                s.frames,
+                s.seconds,
+                s.fps,
+                s.megapixels_per_sec,
+                mib(s.peak_rss_bytes)
+            )?;
+        }
+    }
+    Ok(())
+}
+
+/// Peak resident set size of this process, where the platform reports it
+fn peak_rss() -> Option<u64> {
+    #[cfg(target_os = "linux")]
+    {
+        let status = std::fs::read_to_string("/proc/self/status").ok()?;
+        let line = status.lines().find(|line| line.starts_with("VmHWM:"))?;
+        let kib: u64 = line.split_whitespace().nth(1)?.parse().ok()?;
+        Some(kib * 1024)
+    }
+    #[cfg(not(target_os = "linux"))]
+    {
+        None
+    }
+}
+
+/// Restarts peak RSS tracking so each pattern or stage reports its own
+/// peak.  Best effort: where this is unsupported, peaks accumulate.
+fn reset_peak_rss() {
+    #[cfg(target_os = "linux")]
+    let _ = std::fs::write("/proc/self/clear_refs", "5");
+}
@@ -0,0 +1,504 @@
+//! `vai serve-frames`: one decoder shared by every local consumer
+//!
+//! The server owns a single [`FrameCompositor`] (and so a single decoded
+//! asset cache) and publishes rendered frames into a ring of slots in a
+//! shared-memory file, which clients map read-only.  Requests travel over a
+//! Unix socket as text lines, so any language can be a client:
+//!
+//! ```text
+//! server: VAI-FRAMES 1 <shm path> <rgba|i420> <width> <height> <fps_num> <fps_den> <duration_ms> <slots>
+//! client: FRAME <timestamp_ms>
+//! server: OK <slot> <sequence> <frame> <offset> <len>      (or ERR <message>)
+//! client: RELEASE <slot>
+//! server: OK
+//! ```
+//!
+//! A slot handed out by `FRAME` is pinned until its client sends `RELEASE`
+//! or disconnects; unpinned slots are reused least recently used first.
+//! Requests for a frame that is already in the ring are answered without
+//! rendering.
+//!
+//! The shared-memory file starts with a 64-byte header (magic `VAIFRAME`,
+//! then little-endian u32 version, format, width, height, slot count,
+//! reserved, and u64 slot size and data offset) followed by one 32-byte
+//! descriptor per slot: u64 sequence, frame, timestamp_ms, reserved.  The
+//! sequence is odd while a slot is being written; a client whose pinned
+//! slot's sequence no longer matches the `OK` reply is looking at a reused
+//! slot.
+//!
+//! SIGINT and SIGTERM stop the server, which then removes the shared-memory
+//! file and the socket.
+
+use anyhow::{bail, Context, Result};
+use clap::ValueEnum;
+use std::fs::{self, File, OpenOptions};
+use std::io::{self, BufRead, BufReader, Write};
+use std::os::unix::fs::{FileExt, FileTypeExt};
+use std::os::unix::net::{UnixListener, UnixStream};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread;
+use std::time::Duration;
+use vai_decoder::yuv::{self, I420Frame};
+use vai_decoder::{DecoderConfig, FrameCompositor};
+
+const MAGIC: &[u8; 8] = b"VAIFRAME";
+const PROTOCOL_VERSION: u32 = 1;
+const HEADER_SIZE: u64 = 64;
+const DESCRIPTOR_SIZE: u64 = 32;
+/// Slots start on page boundaries so clients can map them individually
+const PAGE: u64 = 4096;
+/// How often the accept loop looks for a stop signal
+const STOP_POLL: Duration = Duration::from_millis(100);
+
+/// Set by SIGINT/SIGTERM
+static STOP: AtomicBool = AtomicBool::new(false);
+
+extern "C" fn request_stop(_signal: libc::c_int) {
+    STOP.store(true, Ordering::SeqCst);
+}
+
+/// Removes the files the server created when it stops, however it stops
+struct Cleanup {
+    paths: Vec<PathBuf>,
+}
+
+impl Drop for Cleanup {
+    fn drop(&mut self) {
+        for path in &self.paths {
+            let _ = fs::remove_file(path);
+        }
+    }
+}
+
+/// Pixel formats published by `vai serve-frames`
+#[derive(Clone, Copy, Debug, PartialEq, Eq, ValueEnum)]
+pub enum ServeFormat {
+    /// Packed RGBA, width × 4 bytes per row
+    Rgba,
+    /// Planar I420 (Y, then U, then V, tightly packed)
+    I420,
+}
+
+impl ServeFormat {
+    fn name(self) -> &'static str {
+        match self {
+            ServeFormat::Rgba => "rgba",
+            ServeFormat::I420 => "i420",
+        }
+    }
+}
+
+/// One ring slot as tracked by the server
+#[derive(Debug, Default, Clone)]
+struct Slot {
+    /// Frame number held, if the slot holds a complete frame
+    frame: Option<u64>,
+    sequence: u64,
+    /// Clients currently holding the slot
+    pins: u32,
+    /// Tick of the last request that returned this slot
+    last_used: u64,
+}
+
+/// Which frame each slot holds, who pins it, and how recently it was used
+struct Ring {
+    slots: Vec<Slot>,
+    tick: u64,
+}
+
+impl Ring {
+    fn new(slots: usize) -> Self {
+        Ring { slots: vec![Slot::default(); slots], tick: 0 }
+    }
+
+    /// Picks the slot for `frame`: the one already holding it, else the
+    /// least recently used unpinned slot.  The flag is true when the slot
+    /// already holds the frame; otherwise the caller must publish it.
+    fn find(&mut self, frame: u64) -> Result<(usize, bool)> {
+        self.tick += 1;
+        if let Some(index) = self.slots.iter().position(|s| s.frame == Some(frame)) {
+            return Ok((index, true));
+        }
+        let index = self
+            .slots
+            .iter()
+            .enumerate()
+            .filter(|(_, s)| s.pins == 0)
+            .min_by_key(|(_, s)| s.last_used)
+            .map(|(i, _)| i)
+            .context("all slots are pinned")?;
+        Ok((index, false))
+    }
+
+    fn pin(&mut self, index: usize) {
+        let slot = &mut self.slots[index];
+        slot.pins += 1;
+        slot.last_used = self.tick;
+    }
+
+    fn release(&mut self, index: usize) -> Result<()> {
+        match self.slots.get_mut(index) {
+            Some(slot) if slot.pins > 0 => {
+                slot.pins -= 1;
+                Ok(())
+            }
+            _ => bail!("slot {index} is not pinned"),
+        }
+    }
+}
+
+struct Server {
+    compositor: FrameCompositor,
+    shm: File,
+    format: ServeFormat,
+    width: u32,
+    height: u32,
+    frame_size: usize,
+    slot_size: u64,
+    data_offset: u64,
+    ring: Ring,
+    /// Reused I420 render target
+    i420: Option<I420Frame>,
+}
+
+impl Server {
+    /// Returns a pinned slot holding the frame shown at `timestamp_ms`,
+    /// rendering it into the ring if no slot has it yet.  Times past the
+    /// end get the last frame.
+    fn acquire(&mut self, timestamp_ms: u64) -> Result<usize> {
+        let container = self.compositor.container();
+        let frame = container.frame_at_ms(timestamp_ms).min(container.frame_count() - 1);
+        let (index, cached) = self.ring.find(frame)?;
+        if !cached {
+            self.publish(index, frame)?;
+        }
+        self.ring.pin(index);
+        Ok(index)
+    }
+
+    fn release(&mut self, index: usize) -> Result<()> {
+        self.ring.release(index)
+    }
+
+    /// Renders `frame` into slot `index`, bracketing the write with an odd
+    /// sequence number
+    fn publish(&mut self, index: usize, frame: u64) -> Result<()> {
+        let timestamp_ms = self.compositor.container().frame_timestamp_ms(frame);
+        let slot = &mut self.ring.slots[index];
+        slot.frame = None;
+        slot.sequence += 1;
+        self.write_descriptor(index, 0, timestamp_ms)?;
+
+        let rendered = self.render_into(index, timestamp_ms);
+
+        // Even again either way; a failed slot just holds no frame
+        let slot = &mut self.ring.slots[index];
+        slot.frame = rendered.is_ok().then_some(frame);
+        slot.sequence += 1;
+        self.write_descriptor(index, frame, timestamp_ms)?;
+        rendered
+    }
+
+    fn render_into(&mut self, index: usize, timestamp_ms: u64) -> Result<()> {
+        let offset = self.data_offset + index as u64 * self.slot_size;
+        match self.format {
+            ServeFormat::Rgba => {
+                let image = self.compositor.render_frame(timestamp_ms)?;
+                self.shm.write_all_at(image.as_raw(), offset)?;
+            }
+            ServeFormat::I420 => {
+                let (width, height) = (self.width, self.height);
+                let target = self.i420.get_or_insert_with(|| I420Frame::new(width, height));
+                self.compositor.render_frame_i420_into(timestamp_ms, target)?;
+                self.shm.write_all_at(target.as_raw(), offset)?;
+            }
+        }
+        Ok(())
+    }
+
+    fn write_descriptor(&self, index: usize, frame: u64, timestamp_ms: u64) -> Result<()> {
+        let mut descriptor = [0u8; DESCRIPTOR_SIZE as usize];
+        descriptor[0..8].copy_from_slice(&self.ring.slots[index].sequence.to_le_bytes());
+        descriptor[8..16].copy_from_slice(&frame.to_le_bytes());
+        descriptor[16..24].copy_from_slice(&timestamp_ms.to_le_bytes());
+        self.shm
+            .write_all_at(&descriptor, HEADER_SIZE + index as u64 * DESCRIPTOR_SIZE)?;
+        Ok(())
+    }
+
+    /// Reply line for a freshly acquired slot
+    fn describe(&self, index: usize) -> String {
+        let slot = &self.ring.slots[index];
+        format!(
+            "OK {index} {} {} {} {}",
+            slot.sequence,
+            slot.frame.unwrap_or(0),
+            self.data_offset + index as u64 * self.slot_size,
+            self.frame_size
+        )
+    }
+}
+
+/// Runs the frame server until SIGINT or SIGTERM
+pub fn serve_frames(
+    input: PathBuf,
+    socket: PathBuf,
+    shm: Option<PathBuf>,
+    slots: usize,
+    format: ServeFormat,
+) -> Result<()> {
+    if slots == 0 {
+        bail!("--slots must be at least 1");
+    }
+
+    let file = File::open(&input).with_context(|| format!("Failed to open {}", input.display()))?;
+    let compositor = FrameCompositor::open_lazy(BufReader::new(file), DecoderConfig::default())
+        .context("Failed to read VAI container")?;
+    let header = compositor.container().header.clone();
+
+    let frame_size = match format {
+        ServeFormat::Rgba => header.width as usize * header.height as usize * 4,
+        ServeFormat::I420 => yuv::i420_frame_size(header.width, header.height),
+    };
+    let slot_size = (frame_size as u64).next_multiple_of(PAGE);
+    let data_offset = (HEADER_SIZE + slots as u64 * DESCRIPTOR_SIZE).next_multiple_of(PAGE);
+
+    let shm_path = shm.unwrap_or_else(default_shm_path);
+    let shm_file = OpenOptions::new()
+        .read(true)
+        .write(true)
+        .create(true)
+        .truncate(true)
+        .open(&shm_path)
+        .with_context(|| format!("Failed to create {}", shm_path.display()))?;
+    let mut cleanup = Cleanup { paths: vec![shm_path.clone()] };
+    shm_file.set_len(data_offset + slots as u64 * slot_size)?;
+
+    let mut file_header = [0u8; HEADER_SIZE as usize];
+    file_header[0..8].copy_from_slice(MAGIC);
+    let fields = [
+        PROTOCOL_VERSION,
+        format as u32,
+        header.width,
+        header.height,
+        slots as u32,
+        0,
+    ];
+    for (i, field) in fields.iter().enumerate() {
+        file_header[8 + i * 4..12 + i * 4].copy_from_slice(&field.to_le_bytes());
+    }
+    file_header[32..40].copy_from_slice(&slot_size.to_le_bytes());
+    file_header[40..48].copy_from_slice(&data_offset.to_le_bytes());
+    shm_file.write_all_at(&file_header, 0)?;
+
+    let hello = format!(
+        "VAI-FRAMES {PROTOCOL_VERSION} {} {} {} {} {} {} {} {slots}",
+        shm_path.display(),
+        format.name(),
+        header.width,
+        header.height,
+        header.fps_num,
+        header.fps_den,
+        header.duration_ms,
+    );
+
+    let server = Arc::new(Mutex::new(Server {
+        compositor,
+        shm: shm_file,
+        format,
+        width: header.width,
+        height: header.height,
+        frame_size,
+        slot_size,
+        data_offset,
+        ring: Ring::new(slots),
+        i420: None,
+    }));
+
+    remove_stale_socket(&socket)?;
+    let listener = UnixListener::bind(&socket)
+        .with_context(|| format!("Failed to bind {}", socket.display()))?;
+    cleanup.paths.push(socket.clone());
+    // Polled rather than blocking so a stop signal is noticed between clients
+    listener.set_nonblocking(true)?;
+    let handler = request_stop as extern "C" fn(libc::c_int) as libc::sighandler_t;
+    // The handler only stores to an atomic, which is async-signal-safe
+    unsafe {
+        libc::signal(libc::SIGINT, handler);
+        libc::signal(libc::SIGTERM, handler);
+    }
+    eprintln!(
+        "Serving {} on {} ({} {}x{}, {} slots in {})",
+        input.display(),
+        socket.display(),
+        format.name(),
+        header.width,
+        header.height,
+        slots,
+        shm_path.display()
+    );
+
+    while !STOP.load(Ordering::SeqCst) {
+        let stream = match listener.accept().and_then(|(stream, _)| {
+            stream.set_nonblocking(false)?;
+            Ok(stream)
+        }) {
+            Ok(stream) => stream,
+            Err(e) if e.kind() == io::ErrorKind::WouldBlock => {
+                thread::sleep(STOP_POLL);
+                continue;
+            }
+            Err(e) => {
+                eprintln!("accept failed: {e}");
+                continue;
+            }
+        };
+        let server = Arc::clone(&server);
+        let hello = hello.clone();
+        thread::spawn(move || {
+            if let Err(e) = handle_client(stream, &server, &hello) {
+                eprintln!("client error: {e:#}");
+            }
+        });
+    }
+    eprintln!("Stopping; removing {} and {}", shm_path.display(), socket.display());
+    Ok(())
+}
+
+/// Serves one connection; its pins are dropped when it goes away
+fn handle_client(stream: UnixStream, server: &Mutex<Server>, hello: &str) -> Result<()> {
+    let mut writer = stream.try_clone()?;
+    writeln!(writer, "{hello}")?;
+
+    let mut pinned: Vec<usize> = Vec::new();
+    let result = (|| -> Result<()> {
+        for line in BufReader::new(stream).lines() {
+            let line = line?;
+            let mut words = line.split_whitespace();
+            let reply = match (words.next(), words.next().map(str::parse::<u64>)) {
+                (Some("FRAME"), Some(Ok(timestamp_ms))) => {
+                    let mut server = server.lock().unwrap_or_else(|e| e.into_inner());
+                    match server.acquire(timestamp_ms) {
+                        Ok(index) => {
+                            pinned.push(index);
+                            server.describe(index)
+                        }
+                        Err(e) => format!("ERR {e:#}"),
+                    }
+                }
+                (Some("RELEASE"), Some(Ok(slot))) => match pinned.iter().position(|&s| s as u64 == slot) {
+                    Some(i) => {
+                        pinned.swap_remove(i);
+                        let mut server = server.lock().unwrap_or_else(|e| e.into_inner());
+                        match server.release(slot as usize) {
+                            Ok(()) => "OK".to_string(),
+                            Err(e) => format!("ERR {e:#}"),
+                        }
+                    }
+                    None => format!("ERR slot {slot} is not pinned by this client"),
+                },
+                _ => format!("ERR unknown request: {line}"),
+            };
+            writeln!(writer, "{reply}")?;
+        }
+        Ok(())
+    })();
+
+    let mut server = server.lock().unwrap_or_else(|e| e.into_inner());
+    for slot in pinned {
+        let _ = server.release(slot);
+    }
+    result
+}
+
+/// `/dev/shm` where it exists (Linux), else the temporary directory
+fn default_shm_path() -> PathBuf {
+    let dir = Path::new("/dev/shm");
+    let dir = if dir.is_dir() { dir.to_path_buf() } else { std::env::temp_dir() };
+    dir.join(format!("vai-frames-{}", std::process::id()))
+}
+
+/// Removes a socket left behind by an earlier server, but nothing else
+fn remove_stale_socket(path: &Path) -> Result<()> {
+    match fs::symlink_metadata(path) {
+        Ok(meta) if meta.file_type().is_socket() => {
+            fs::remove_file(path).with_context(|| format!("Failed to remove {}", path.display()))
+        }
+        Ok(_) => bail!("{} exists and is not a socket", path.display()),
+        Err(_) => Ok(()),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Acquires `frame` the way `Server::acquire` does, filling the slot
+    /// on a miss
+    fn acquire(ring: &mut Ring, frame: u64) -> Result<(usize, bool)> {
+        let (index, cached) = ring.find(frame)?;
+        if !cached {
+            ring.slots[index].frame = Some(frame);
+        }
+        ring.pin(index);
+        Ok((index, cached))
+    }
+
+    #[test]
+    fn test_cached_frame_reuses_its_slot() {
+        let mut ring = Ring::new(2);
+        let (first, cached) = acquire(&mut ring, 7).unwrap();
+        assert!(!cached);
+        let (second, cached) = acquire(&mut ring, 7).unwrap();
+        assert!(cached);
+        assert_eq!(first, second);
+        assert_eq!(ring.slots[first].pins, 2);
+    }
+
+    #[test]
+    fn test_eviction_skips_pinned_slots() {
+        let mut ring = Ring::new(3);
+        let (a, _) = acquire(&mut ring, 0).unwrap();
+        let (b, _) = acquire(&mut ring, 1).unwrap();
+        let (c, _) = acquire(&mut ring, 2).unwrap();
+        ring.release(b).unwrap();
+        ring.release(c).unwrap();
+
+        // Slot `a` is the oldest but still pinned, so `b` goes next, then `c`
+        let (index, cached) = acquire(&mut ring, 3).unwrap();
+        assert!(!cached);
+        assert_eq!(index, b);
+        ring.release(index).unwrap();
+        let (index, _) = acquire(&mut ring, 4).unwrap();
+        assert_eq!(index, c);
+        assert_eq!(ring.slots[a].frame, Some(0));
+    }
+
+    #[test]
+    fn test_all_slots_pinned() {
+        let mut ring = Ring::new(2);
+        acquire(&mut ring, 0).unwrap();
+        acquire(&mut ring, 1).unwrap();
+        let err = acquire(&mut ring, 2).unwrap_err();
+        assert!(err.to_string().contains("all slots are pinned"));
+
+        // A pinned frame can still be shared, and a release frees a slot
+        assert!(acquire(&mut ring, 1).unwrap().1);
+        ring.release(0).unwrap();
+        assert_eq!(acquire(&mut ring, 2).unwrap(), (0, false));
+    }
+
+    #[test]
+    fn test_release_unknown_slot() {
+        let mut ring = Ring::new(2);
+        assert!(ring.release(5).is_err());
+        assert!(ring.release(0).is_err());
+
+        let (index, _) = acquire(&mut ring, 0).unwrap();
+        ring.release(index).unwrap();
+        assert!(ring.release(index).is_err());
+        assert_eq!(ring.slots[index].pins, 0);
+    }
+}
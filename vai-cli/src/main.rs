@@ -2,14 +2,24 @@
 //!
 //! Command-line interface for encoding and decoding VAI video files.
 
+mod batch;
+mod bench;
+#[cfg(unix)]
+mod frame_server;
+mod synth;
+mod transcode;
+
 use anyhow::{Context, Result};
-use clap::{Parser, Subcommand};
-use std::fs::File;
-use std::io::BufWriter;
-use std::path::PathBuf;
-use vai_core::VaiContainer;
+use clap::{Args, Parser, Subcommand, ValueEnum};
+use std::io::{BufWriter, Write};
+use std::path::{Path, PathBuf};
+use std::sync::mpsc;
+use std::thread;
+use vai_core::{AssetCodec, VaiContainer};
+use vai_decoder::yuv::I420Frame;
 use vai_decoder::FrameCompositor;
-use vai_encoder::{EncoderConfig, SceneAnalyzer, SceneDetectorConfig, VideoReader};
+use vai_encoder::synthetic::SyntheticConfig;
+use vai_encoder::{EncoderConfig, FrameSource, SceneAnalyzer, SceneDetectorConfig, VideoReader};
 
 #[derive(Parser)]
 #[command(name = "vai")]
@@ -18,6 +28,16 @@ use vai_encoder::{EncoderConfig, SceneAnalyzer, SceneDetectorConfig, VideoReader
 struct Cli {
     #[command(subcommand)]
     command: Commands,
+
+    /// Write per-stage encoder metrics as JSON to this file when the
+    /// command finishes
+    #[arg(long, global = true)]
+    metrics_json: Option<PathBuf>,
+
+    /// Write per-stage encoder metrics in the Prometheus text format to
+    /// this file (for the node_exporter textfile collector)
+    #[arg(long, global = true)]
+    metrics_prometheus: Option<PathBuf>,
 }
 
 #[derive(Subcommand)]
@@ -31,26 +51,40 @@ enum Commands {
         #[arg(short, long)]
         output: PathBuf,
 
-        /// AVIF encoding quality (0-100)
-        #[arg(long, default_value = "80")]
-        quality: u8,
-
         /// Override output frame rate
         #[arg(long)]
         fps: Option<f64>,
 
-        /// Motion detection threshold (0-255)
-        #[arg(long, default_value = "30")]
-        threshold: u8,
+        #[command(flatten)]
+        encoder: EncoderArgs,
+    },
+
+    /// Encode many videos with one shared set of workers
+    EncodeBatch {
+        /// Input videos, directories of videos, or @file lists with one
+        /// path per line
+        #[arg(required = true)]
+        inputs: Vec<PathBuf>,
 
-        /// Minimum region size in pixels
-        #[arg(long, default_value = "64")]
-        min_region: u32,
+        /// Directory the .vai files are written to (named after the inputs)
+        #[arg(short, long)]
+        output_dir: PathBuf,
+
+        /// Files encoded at once; the CPU threads and memory budget are
+        /// split between them (0 = one per four cores)
+        #[arg(long, default_value = "0")]
+        jobs: usize,
+
+        /// Raw frames buffered across all files in flight, in MiB
+        #[arg(long, default_value = "4096")]
+        memory_mb: u64,
 
-        /// Use FFmpeg AV1 encoder (libsvtav1) for faster encoding.
-        /// Falls back to the built-in ravif encoder if unavailable.
+        /// Re-encode inputs whose output already exists
         #[arg(long)]
-        ffmpeg: bool,
+        overwrite: bool,
+
+        #[command(flatten)]
+        encoder: EncoderArgs,
     },
 
     /// Decode a VAI file to frames
@@ -69,83 +103,580 @@ enum Commands {
         /// Extract a single frame by frame number
         #[arg(long)]
         frame: Option<u64>,
+
+        /// Write the embedded preview thumbnails to the output directory
+        /// instead of decoding full frames
+        #[arg(long, conflicts_with = "frame")]
+        previews: bool,
+
+        /// Stream every frame to stdout instead of writing PNG files
+        /// (e.g. `vai decode in.vai --pipe | ffmpeg -i - out.mp4`)
+        #[arg(long, conflicts_with_all = ["output", "info", "frame"])]
+        pipe: bool,
+
+        /// Frame format written by --pipe
+        #[arg(long, value_enum, default_value = "y4m")]
+        pipe_format: PipeFormat,
+    },
+
+    /// Rewrite a VAI file with asset payloads in order of first use
+    Repack {
+        /// Input VAI file path
+        input: PathBuf,
+
+        /// Output VAI file path
+        output: PathBuf,
+    },
+
+    /// Re-encode the assets of a VAI file at a new quality or codec,
+    /// keeping its timeline
+    Transcode {
+        /// Input VAI file path
+        input: PathBuf,
+
+        /// Output VAI file path
+        #[arg(short, long)]
+        output: PathBuf,
+
+        /// Re-encode AVIF assets at this quality (0-100); without it AVIF
+        /// assets that stay AVIF are copied
+        #[arg(long)]
+        quality: Option<u8>,
+
+        /// Move sprites up to --sprite-area pixels to this codec and larger
+        /// assets to AVIF; without it every asset keeps its codec
+        #[arg(long, value_enum)]
+        sprite_codec: Option<SpriteCodec>,
+
+        /// Largest sprite area, in pixels, stored with --sprite-codec
+        #[arg(long, default_value = "4096")]
+        sprite_area: u32,
+
+        /// Use FFmpeg AV1 encoder (libsvtav1) for AVIF assets
+        #[arg(long)]
+        ffmpeg: bool,
+
+        /// Worker threads (0 = one per CPU)
+        #[arg(long, default_value = "0")]
+        threads: usize,
+    },
+
+    /// Measure end-to-end throughput: playback of a VAI file, or each
+    /// encoder stage for a source video
+    Bench {
+        /// VAI file or source video
+        input: PathBuf,
+
+        /// Frames played back sequentially (0 = the whole file)
+        #[arg(long, default_value = "0")]
+        frames: u64,
+
+        /// Random seeks, each warming the caches and rendering one frame
+        #[arg(long, default_value = "200")]
+        seeks: usize,
+
+        /// Seed for the seek pattern
+        #[arg(long, default_value = "1")]
+        seed: u64,
+
+        /// Render I420 frames instead of RGBA
+        #[arg(long)]
+        i420: bool,
+
+        /// Also write the report as JSON to this file (- for stdout)
+        #[arg(long)]
+        json: Option<PathBuf>,
+
+        /// AVIF encoding quality (0-100) for source videos
+        #[arg(long, default_value = "80")]
+        quality: u8,
+
+        /// Codec for small sprites for source videos
+        #[arg(long, value_enum, default_value = "qoi")]
+        sprite_codec: SpriteCodec,
+
+        /// Use FFmpeg AV1 encoder (libsvtav1) for source videos
+        #[arg(long)]
+        ffmpeg: bool,
+    },
+
+    /// Generate deterministic synthetic video for tests and benchmarks,
+    /// as lossless frames, an encoded VAI file, or both
+    Synth {
+        /// Content to generate
+        #[arg(long, value_enum, default_value = "sprites")]
+        preset: synth::SynthPreset,
+
+        /// Number of frames
+        #[arg(long, default_value = "150")]
+        frames: u32,
+
+        /// Frame width in pixels
+        #[arg(long, default_value = "640")]
+        width: u32,
+
+        /// Frame height in pixels
+        #[arg(long, default_value = "360")]
+        height: u32,
+
+        /// Frames per second
+        #[arg(long, default_value = "30")]
+        fps: u32,
+
+        /// Seed for the background, sprite paths and noise
+        #[arg(long, default_value = "1")]
+        seed: u64,
+
+        /// Override the preset's number of moving sprites
+        #[arg(long)]
+        sprites: Option<u32>,
+
+        /// Override the preset's hard-cut interval, in frames
+        #[arg(long)]
+        cut_every: Option<u32>,
+
+        /// Override the preset's peak sensor noise (0-255)
+        #[arg(long)]
+        noise: Option<u8>,
+
+        /// Write the frames to this directory
+        #[arg(long)]
+        frames_dir: Option<PathBuf>,
+
+        /// Layout of frames written with --frames-dir
+        #[arg(long, value_enum, default_value = "png")]
+        format: synth::SynthFormat,
+
+        /// Encode the frames to this VAI file
+        #[arg(long)]
+        encode: Option<PathBuf>,
+
+        /// AVIF encoding quality (0-100) for --encode
+        #[arg(long, default_value = "80")]
+        quality: u8,
+
+        /// Codec for small sprites with --encode
+        #[arg(long, value_enum, default_value = "qoi")]
+        sprite_codec: SpriteCodec,
+
+        /// Use FFmpeg AV1 encoder (libsvtav1) for --encode
+        #[arg(long)]
+        ffmpeg: bool,
+
+        /// Write asset payloads in order of first use
+        #[arg(long)]
+        time_ordered: bool,
+    },
+
+    /// Serve rendered frames to local processes over a Unix socket and a
+    /// shared-memory ring, decoding each frame once for all of them
+    #[cfg(unix)]
+    ServeFrames {
+        /// Input VAI file path
+        input: PathBuf,
+
+        /// Unix socket to accept frame requests on
+        #[arg(long)]
+        socket: PathBuf,
+
+        /// Shared-memory file frames are published into
+        /// (default: /dev/shm/vai-frames-<pid>)
+        #[arg(long)]
+        shm: Option<PathBuf>,
+
+        /// Frames kept in the ring
+        #[arg(long, default_value = "16")]
+        slots: usize,
+
+        /// Pixel format of published frames
+        #[arg(long, value_enum, default_value = "rgba")]
+        format: frame_server::ServeFormat,
     },
 }
 
+/// Encoder options shared by `encode` and `encode-batch`
+#[derive(Args)]
+struct EncoderArgs {
+    /// AVIF encoding quality (0-100)
+    #[arg(long, default_value = "80")]
+    quality: u8,
+
+    /// Motion detection threshold (0-255)
+    #[arg(long, default_value = "30")]
+    threshold: u8,
+
+    /// Minimum region size in pixels
+    #[arg(long, default_value = "64")]
+    min_region: u32,
+
+    /// Use FFmpeg AV1 encoder (libsvtav1) for faster encoding.
+    /// Falls back to the built-in ravif encoder if unavailable.
+    #[arg(long)]
+    ffmpeg: bool,
+
+    /// Codec for small sprites (avif stores every sprite as AVIF)
+    #[arg(long, value_enum, default_value = "qoi")]
+    sprite_codec: SpriteCodec,
+
+    /// Largest sprite area, in pixels, stored with --sprite-codec
+    /// (or packed into an atlas with --atlas)
+    #[arg(long, default_value = "4096")]
+    sprite_area: u32,
+
+    /// Pack small sprites into shared atlas images, encoded once per chunk
+    #[arg(long)]
+    atlas: bool,
+
+    /// Store regions that move across consecutive frames as AV1
+    /// sequences with inter prediction (requires --ffmpeg)
+    #[arg(long, requires = "ffmpeg")]
+    tracks: bool,
+
+    /// Also store half-resolution copies of backgrounds and large
+    /// sprites so slow players can switch to them
+    #[arg(long)]
+    low_tier: bool,
+
+    /// Store a low-resolution preview frame every second for scrubbing
+    /// and instant display after seeks
+    #[arg(long)]
+    preview: bool,
+
+    /// Write asset payloads in order of first use so playback reads
+    /// the file sequentially
+    #[arg(long)]
+    time_ordered: bool,
+}
+
+impl EncoderArgs {
+    fn config(&self, fps: Option<f64>) -> EncoderConfig {
+        EncoderConfig {
+            quality: self.quality,
+            fps,
+            threshold: self.threshold,
+            min_region_size: self.min_region,
+            use_ffmpeg: self.ffmpeg,
+            sprite_codec: self.sprite_codec.into(),
+            sprite_max_area: self.sprite_area,
+            atlas: self.atlas,
+            tracks: self.tracks,
+            low_tier: self.low_tier,
+            preview: self.preview,
+        }
+    }
+}
+
+/// Output formats for `vai decode --pipe`
+#[derive(Clone, Copy, Debug, PartialEq, Eq, ValueEnum)]
+enum PipeFormat {
+    /// YUV4MPEG2 stream (I420), readable by `ffmpeg -i -`
+    Y4m,
+    /// Headerless RGBA frames (`-f rawvideo -pix_fmt rgba`)
+    Rgba,
+    /// Headerless I420 frames (`-f rawvideo -pix_fmt yuv420p`)
+    I420,
+}
+
+/// Sprite codecs selectable with `vai encode --sprite-codec`
+#[derive(Clone, Copy, Debug, PartialEq, Eq, ValueEnum)]
+enum SpriteCodec {
+    /// AVIF (smallest, slowest to decode)
+    Avif,
+    /// Uncompressed RGBA
+    Raw,
+    /// zstd-compressed RGBA
+    Zstd,
+    /// LZ4-compressed RGBA
+    Lz4,
+    /// QOI (lossless, fast to decode)
+    Qoi,
+}
+
+impl From<SpriteCodec> for AssetCodec {
+    fn from(codec: SpriteCodec) -> Self {
+        match codec {
+            SpriteCodec::Avif => AssetCodec::Avif,
+            SpriteCodec::Raw => AssetCodec::Raw,
+            SpriteCodec::Zstd => AssetCodec::Zstd,
+            SpriteCodec::Lz4 => AssetCodec::Lz4,
+            SpriteCodec::Qoi => AssetCodec::Qoi,
+        }
+    }
+}
+
 fn main() -> Result<()> {
     let cli = Cli::parse();
+    let result = run(cli.command);
 
-    match cli.command {
+    // Metrics are written for failed runs too; they show where time went.
+    // Failing to write them must not hide the command's own result.
+    if let Err(e) = write_metrics(cli.metrics_json.as_deref(), cli.metrics_prometheus.as_deref()) {
+        eprintln!("Warning: {e:#}");
+    }
+    result
+}
+
+fn write_metrics(json_path: Option<&Path>, prometheus_path: Option<&Path>) -> Result<()> {
+    let metrics = vai_encoder::metrics::global().snapshot();
+    if let Some(path) = json_path {
+        let json = serde_json::to_string_pretty(&metrics)?;
+        std::fs::write(path, json + "\n").with_context(|| format!("Failed to write {}", path.display()))?;
+    }
+    if let Some(path) = prometheus_path {
+        // Written aside and renamed so the collector never reads a partial file
+        let partial = path.with_extension("prom.tmp");
+        std::fs::write(&partial, metrics.to_prometheus())
+            .and_then(|_| std::fs::rename(&partial, path))
+            .with_context(|| format!("Failed to write {}", path.display()))?;
+    }
+    Ok(())
+}
+
+fn run(command: Commands) -> Result<()> {
+    match command {
         Commands::Encode {
             input,
             output,
-            quality,
             fps,
-            threshold,
-            min_region,
-            ffmpeg,
-        } => encode_video(input, output, quality, fps, threshold, min_region, ffmpeg)?,
+            encoder,
+        } => encode_video(input, output, encoder.config(fps), encoder.time_ordered)?,
+
+        Commands::EncodeBatch {
+            inputs,
+            output_dir,
+            jobs,
+            memory_mb,
+            overwrite,
+            encoder,
+        } => {
+            let options = batch::BatchOptions {
+                jobs,
+                memory_mb,
+                overwrite,
+                time_ordered: encoder.time_ordered,
+            };
+            batch::encode_batch(inputs, output_dir, encoder.config(None), options)?
+        }
 
         Commands::Decode {
             input,
             output,
             info,
             frame,
-        } => decode_video(input, output, info, frame)?,
+            previews,
+            pipe,
+            pipe_format,
+        } => {
+            if pipe {
+                pipe_video(input, pipe_format)?
+            } else {
+                decode_video(input, output, info, frame, previews)?
+            }
+        }
+
+        Commands::Repack { input, output } => repack_video(input, output)?,
+
+        Commands::Transcode {
+            input,
+            output,
+            quality,
+            sprite_codec,
+            sprite_area,
+            ffmpeg,
+            threads,
+        } => {
+            let options = transcode::TranscodeOptions {
+                quality,
+                sprite_codec: sprite_codec.map(Into::into),
+                sprite_area,
+                use_ffmpeg: ffmpeg,
+                threads,
+            };
+            transcode::transcode(input, output, options)?
+        }
+
+        Commands::Bench {
+            input,
+            frames,
+            seeks,
+            seed,
+            i420,
+            json,
+            quality,
+            sprite_codec,
+            ffmpeg,
+        } => {
+            let options = bench::BenchOptions {
+                frames,
+                seeks,
+                seed,
+                i420,
+                json,
+                encoder: EncoderConfig {
+                    quality,
+                    use_ffmpeg: ffmpeg,
+                    sprite_codec: sprite_codec.into(),
+                    ..EncoderConfig::default()
+                },
+            };
+            bench::bench(input, options)?
+        }
+
+        Commands::Synth {
+            preset,
+            frames,
+            width,
+            height,
+            fps,
+            seed,
+            sprites,
+            cut_every,
+            noise,
+            frames_dir,
+            format,
+            encode,
+            quality,
+            sprite_codec,
+            ffmpeg,
+            time_ordered,
+        } => {
+            let base = SyntheticConfig {
+                width,
+                height,
+                fps_num: fps,
+                fps_den: 1,
+                ..SyntheticConfig::default()
+            }
+            .with_preset(preset.into());
+            let config = SyntheticConfig {
+                frames,
+                seed,
+                sprites: sprites.unwrap_or(base.sprites),
+                cut_every: cut_every.or(base.cut_every),
+                noise: noise.unwrap_or(base.noise),
+                ..base
+            };
+            let encoder = EncoderConfig {
+                quality,
+                use_ffmpeg: ffmpeg,
+                sprite_codec: sprite_codec.into(),
+                ..EncoderConfig::default()
+            };
+            let outputs = synth::SynthOutputs {
+                frames_dir,
+                format,
+                encode,
+                time_ordered,
+            };
+            synth::synth(config, outputs, encoder)?
+        }
+
+        #[cfg(unix)]
+        Commands::ServeFrames {
+            input,
+            socket,
+            shm,
+            slots,
+            format,
+        } => frame_server::serve_frames(input, socket, shm, slots, format)?,
     }
 
     Ok(())
 }
 
-fn encode_video(
-    input: PathBuf,
-    output: PathBuf,
-    quality: u8,
-    fps: Option<f64>,
-    threshold: u8,
-    min_region: u32,
-    use_ffmpeg: bool,
-) -> Result<()> {
+fn encode_video(input: PathBuf, output: PathBuf, config: EncoderConfig, time_ordered: bool) -> Result<()> {
     println!("Encoding video: {}", input.display());
     println!("Output: {}", output.display());
 
+    // Report encoder backend
+    if config.use_ffmpeg {
+        match vai_encoder::ffmpeg_encoder::best_encoder_name() {
+            Some(name) => println!("AVIF encoder: FFmpeg ({name})"),
+            None => println!("AVIF encoder: ravif (FFmpeg AV1 not available, falling back)"),
+        }
+    } else {
+        println!("AVIF encoder: ravif (use --ffmpeg for faster FFmpeg-based encoding)");
+    }
+    if config.tracks {
+        println!("Sprite tracks: AV1 sequences for persistent regions");
+    }
+    if config.low_tier {
+        println!("Reduced tiers: half-resolution copies of large assets");
+    }
+    if config.preview {
+        println!("Previews: one thumbnail per second");
+    }
+    if config.atlas {
+        println!("Sprite atlases: sprites up to {} px", config.sprite_max_area);
+    } else if config.sprite_codec != AssetCodec::Avif {
+        println!(
+            "Sprite codec: {} for sprites up to {} px",
+            config.sprite_codec.name(),
+            config.sprite_max_area
+        );
+    }
+
+    let analyzer = SceneAnalyzer::new(config);
+    encode_file(&input, &output, &analyzer, time_ordered, io_threads())?;
+
+    print_stage_times();
+    println!("Successfully encoded to {}", output.display());
+
+    Ok(())
+}
+
+/// Runs both encoder passes over `input` and writes the container to
+/// `output` with `io_threads` writers
+fn encode_file(
+    input: &Path,
+    output: &Path,
+    analyzer: &SceneAnalyzer,
+    time_ordered: bool,
+    io_threads: usize,
+) -> Result<VaiContainer> {
     let input_str = input.to_str().context("Invalid input path")?;
 
     // Open video file
-    let mut reader = VideoReader::open(input_str)
+    let reader = VideoReader::open(input_str)
         .context("Failed to open video file")?;
 
+    // Re-open the video for the second pass
+    let reopen = |_| VideoReader::open(input_str).context("Failed to re-open video file for pass 2");
+    encode_source(reader, reopen, output, analyzer, time_ordered, io_threads)
+}
+
+/// Runs both encoder passes over `reader`, restarting it with `reopen`
+/// before the second, and writes the container to `output`
+fn encode_source<S: FrameSource>(
+    mut reader: S,
+    reopen: impl FnOnce(S) -> Result<S>,
+    output: &Path,
+    analyzer: &SceneAnalyzer,
+    time_ordered: bool,
+    io_threads: usize,
+) -> Result<VaiContainer> {
     let width = reader.width();
     let height = reader.height();
     let (fps_num, fps_den) = reader.frame_rate();
     let duration_ms = reader.duration_ms();
+    // Batch encodes running side by side stay quiet; their lines would interleave
+    let verbose = analyzer.is_verbose();
 
-    println!(
-        "Video info: {}x{} @ {}/{} fps, {} ms",
-        width, height, fps_num, fps_den, duration_ms
-    );
-
-    let config = EncoderConfig {
-        quality,
-        fps,
-        threshold,
-        min_region_size: min_region,
-        use_ffmpeg,
-    };
-
-    // Report encoder backend
-    if use_ffmpeg {
-        match vai_encoder::ffmpeg_encoder::best_encoder_name() {
-            Some(name) => println!("AVIF encoder: FFmpeg ({name})"),
-            None => println!("AVIF encoder: ravif (FFmpeg AV1 not available, falling back)"),
-        }
-    } else {
-        println!("AVIF encoder: ravif (use --ffmpeg for faster FFmpeg-based encoding)");
+    if verbose {
+        println!(
+            "Video info: {}x{} @ {}/{} fps, {} ms",
+            width, height, fps_num, fps_den, duration_ms
+        );
     }
 
     // === PASS 1: Scene detection ===
-    println!("\nPass 1: Detecting scene changes …");
-    let scene_config = SceneDetectorConfig::default();
+    if verbose {
+        println!("\nPass 1: Detecting scene changes …");
+    }
+    let scene_config = SceneDetectorConfig {
+        verbose,
+        ..SceneDetectorConfig::default()
+    };
     let mut segments = vai_encoder::scene_detector::detect_scenes(&mut reader, &scene_config)
         .context("Failed to detect scenes")?;
 
@@ -157,45 +688,45 @@ fn encode_video(
         }
     }
 
-    println!(
-        "  Detected {} scene(s): {}",
-        segments.len(),
-        segments
-            .iter()
-            .map(|s| format!("frames {}-{}", s.start_frame, s.end_frame))
-            .collect::<Vec<_>>()
-            .join(", ")
-    );
+    if verbose {
+        println!(
+            "  Detected {} scene(s): {}",
+            segments.len(),
+            segments
+                .iter()
+                .map(|s| format!("frames {}-{}", s.start_frame, s.end_frame))
+                .collect::<Vec<_>>()
+                .join(", ")
+        );
 
-    // === PASS 2: Parallel encoding ===
-    println!("\nPass 2: Encoding (parallel) …");
+        // === PASS 2: Parallel encoding ===
+        println!("\nPass 2: Encoding (parallel) …");
+    }
 
-    // Re-open the video for the second pass
-    let mut reader2 = VideoReader::open(input_str)
-        .context("Failed to re-open video file for pass 2")?;
+    let mut reader2 = reopen(reader)?;
 
-    let analyzer = SceneAnalyzer::new(config);
-    let container = analyzer
+    let mut container = analyzer
         .analyze_parallel(&mut reader2, segments, width, height, fps_num, fps_den, duration_ms)
         .context("Failed to encode video")?;
+    if time_ordered {
+        container.sort_assets_by_first_use();
+    }
 
-    println!(
-        "\nCreated {} assets and {} timeline entries",
-        container.assets.len(),
-        container.timeline.len()
-    );
+    if verbose {
+        println!(
+            "\nCreated {} assets and {} timeline entries",
+            container.assets.len(),
+            container.timeline.len()
+        );
 
-    // Write VAI file
-    println!("Writing VAI file...");
-    let file = File::create(&output).context("Failed to create output file")?;
-    let mut writer = BufWriter::new(file);
+        // Write VAI file
+        println!("Writing VAI file...");
+    }
     container
-        .write(&mut writer)
+        .write_file_parallel(output, io_threads)
         .context("Failed to write VAI container")?;
 
-    println!("Successfully encoded to {}", output.display());
-
-    Ok(())
+    Ok(container)
 }
 
 fn decode_video(
@@ -203,12 +734,12 @@ fn decode_video(
     output: Option<PathBuf>,
     info: bool,
     frame_num: Option<u64>,
+    previews: bool,
 ) -> Result<()> {
     println!("Decoding VAI file: {}", input.display());
 
     // Read VAI container
-    let file = File::open(&input).context("Failed to open VAI file")?;
-    let container = VaiContainer::read(file).context("Failed to read VAI container")?;
+    let container = read_container(&input)?;
 
     // Show info if requested
     if info || output.is_none() {
@@ -221,13 +752,36 @@ fn decode_video(
     // Create compositor
     let mut compositor = FrameCompositor::new(container.clone());
 
-    if let Some(frame_num) = frame_num {
+    if previews {
+        // Extract the preview thumbnails
+        let output_dir = output.context("Output directory required")?;
+        std::fs::create_dir_all(&output_dir).context("Failed to create output directory")?;
+
+        if container.previews.is_empty() {
+            println!("File has no previews (encode with --preview)");
+            return Ok(());
+        }
+
+        for preview in &container.previews {
+            let image = compositor
+                .preview(preview.timestamp_ms)
+                .context("Failed to decode preview")?
+                .context("Preview missing")?;
+            let preview_path = output_dir.join(format!("preview_{:08}ms.png", preview.timestamp_ms));
+            image.save(&preview_path).context("Failed to save preview")?;
+        }
+
+        println!(
+            "Extracted {} previews to {}",
+            container.previews.len(),
+            output_dir.display()
+        );
+    } else if let Some(frame_num) = frame_num {
         // Extract single frame
         let output_path = output.context("Output path required for frame extraction")?;
         
         // Calculate timestamp for frame number
-        let fps = container.fps();
-        let timestamp_ms = (frame_num as f64 * 1000.0 / fps) as u64;
+        let timestamp_ms = container.frame_timestamp_ms(frame_num as u64);
 
         println!("Extracting frame {} at {}ms", frame_num, timestamp_ms);
         let frame = compositor
@@ -241,19 +795,17 @@ fn decode_video(
         let output_dir = output.context("Output directory required")?;
         std::fs::create_dir_all(&output_dir).context("Failed to create output directory")?;
 
-        let fps = container.fps();
-        let frame_count = ((container.header.duration_ms as f64 * fps / 1000.0).floor() as u64).max(1);
+        let frame_count = container.frame_count();
 
         println!("Extracting {} frames to {}", frame_count, output_dir.display());
 
-        for i in 0..frame_count {
-            let timestamp_ms = (i as f64 * 1000.0 / fps) as u64;
-            let frame = compositor
-                .render_frame(timestamp_ms)
-                .context("Failed to render frame")?;
+        let mut frames = compositor.frames(0..frame_count);
+        while let Some(frame) = frames.next() {
+            let frame = frame.context("Failed to render frame")?;
+            let i = frame.index;
 
             let frame_path = output_dir.join(format!("frame_{:06}.png", i));
-            frame.save(&frame_path).context("Failed to save frame")?;
+            frame.pixels.save(&frame_path).context("Failed to save frame")?;
 
             if (i + 1) % 10 == 0 {
                 println!("Extracted {} / {} frames", i + 1, frame_count);
@@ -266,6 +818,159 @@ fn decode_video(
     Ok(())
 }
 
+/// Threads used to load and store container payloads
+fn io_threads() -> usize {
+    thread::available_parallelism().map_or(1, |n| n.get())
+}
+
+/// Prints where encoder time went, from the process-wide metrics
+fn print_stage_times() {
+    let metrics = vai_encoder::metrics::global().snapshot();
+    println!("\nStage times (summed over threads):");
+    for stage in metrics.stages.iter().filter(|s| s.count > 0) {
+        println!(
+            "  {:<14} {:>9.2}s  {:>8} calls  {:>10.1} MiB",
+            stage.stage,
+            stage.seconds,
+            stage.count,
+            stage.bytes as f64 / (1 << 20) as f64
+        );
+    }
+    println!(
+        "  worker utilisation {:.0}%, at most {} frames buffered",
+        metrics.worker_utilisation * 100.0,
+        metrics.queue_depth_max
+    );
+}
+
+/// Reads a VAI file, loading asset payloads in parallel
+fn read_container(path: &Path) -> Result<VaiContainer> {
+    VaiContainer::read_file_parallel(path, io_threads()).context("Failed to read VAI container")
+}
+
+/// Rewrites a VAI file with its asset payloads in order of first use
+fn repack_video(input: PathBuf, output: PathBuf) -> Result<()> {
+    let mut container = read_container(&input)?;
+
+    container.sort_assets_by_first_use();
+
+    container
+        .write_file_parallel(&output, io_threads())
+        .context("Failed to write VAI container")?;
+
+    println!(
+        "Repacked {} assets in first-use order to {}",
+        container.assets.len(),
+        output.display()
+    );
+    Ok(())
+}
+
+/// Streams all frames to stdout.
+///
+/// Rendering runs on its own thread and hands finished frames to the writer
+/// through a small bounded queue, so composition of frame N+1 overlaps the
+/// write of frame N.  All diagnostics go to stderr to keep stdout clean.
+fn pipe_video(input: PathBuf, format: PipeFormat) -> Result<()> {
+    /// Frames rendered ahead of the writer
+    const PIPE_DEPTH: usize = 4;
+
+    eprintln!("Decoding VAI file: {}", input.display());
+
+    let container = read_container(&input)?;
+
+    let width = container.header.width;
+    let height = container.header.height;
+    let fps_num = container.header.fps_num;
+    let fps_den = container.header.fps_den;
+    let fps = container.fps();
+    let frame_count = container.frame_count();
+
+    eprintln!(
+        "Streaming {} frames ({}x{} @ {:.2} fps, {:?}) to stdout",
+        frame_count, width, height, fps, format
+    );
+
+    let (frame_tx, frame_rx) = mpsc::sync_channel::<Vec<u8>>(PIPE_DEPTH);
+    // Written YUV buffers come back here for reuse
+    let (recycle_tx, recycle_rx) = mpsc::channel::<Vec<u8>>();
+
+    let renderer = thread::spawn(move || -> Result<()> {
+        let mut compositor = FrameCompositor::new(container);
+
+        for i in 0..frame_count {
+            let timestamp_ms = compositor.container().frame_timestamp_ms(i);
+
+            let buf = match format {
+                PipeFormat::Rgba => compositor
+                    .render_frame(timestamp_ms)
+                    .context("Failed to render frame")?
+                    .into_raw(),
+                PipeFormat::Y4m | PipeFormat::I420 => {
+                    // Composite straight into a recycled planar buffer
+                    let mut frame = recycle_rx
+                        .try_recv()
+                        .ok()
+                        .and_then(|buf| I420Frame::from_raw(width, height, buf))
+                        .unwrap_or_else(|| I420Frame::new(width, height));
+                    compositor
+                        .render_frame_i420_into(timestamp_ms, &mut frame)
+                        .context("Failed to render frame")?;
+                    frame.into_raw()
+                }
+            };
+
+            // The writer hung up (e.g. broken pipe); stop rendering
+            if frame_tx.send(buf).is_err() {
+                break;
+            }
+        }
+
+        Ok(())
+    });
+
+    let stdout = std::io::stdout();
+    let mut out = BufWriter::new(stdout.lock());
+
+    let write_result = (|| -> std::io::Result<u64> {
+        if format == PipeFormat::Y4m {
+            writeln!(
+                out,
+                "YUV4MPEG2 W{} H{} F{}:{} Ip A1:1 C420jpeg XCOLORRANGE=LIMITED",
+                width, height, fps_num, fps_den
+            )?;
+        }
+
+        let mut written = 0;
+        for buf in frame_rx.iter() {
+            if format == PipeFormat::Y4m {
+                out.write_all(b"FRAME\n")?;
+            }
+            out.write_all(&buf)?;
+            written += 1;
+            let _ = recycle_tx.send(buf);
+        }
+        out.flush()?;
+        Ok(written)
+    })();
+
+    // Unblock the renderer if we stopped early
+    drop(frame_rx);
+    renderer
+        .join()
+        .map_err(|_| anyhow::anyhow!("Render thread panicked"))??;
+
+    match write_result {
+        Ok(written) => eprintln!("Streamed {} frames", written),
+        Err(e) if e.kind() == std::io::ErrorKind::BrokenPipe => {
+            eprintln!("Output closed by reader, stopping");
+        }
+        Err(e) => return Err(e).context("Failed to write frames to stdout"),
+    }
+
+    Ok(())
+}
+
 fn print_info(container: &VaiContainer) {
     println!("\n=== VAI File Information ===");
     println!("Version: {}", container.header.version);
@@ -281,6 +986,15 @@ fn print_info(container: &VaiContainer) {
         container.header.duration_ms as f64 / 1000.0
     );
     println!("Assets: {}", container.assets.len());
+    if !container.slices.is_empty() {
+        println!("Atlas slices: {}", container.slices.len());
+    }
+    if !container.tiers.is_empty() {
+        println!("Reduced tiers: {} (down to tier {})", container.tiers.len(), container.max_tier());
+    }
+    if !container.previews.is_empty() {
+        println!("Preview frames: {}", container.previews.len());
+    }
     println!("Timeline entries: {}", container.timeline.len());
 
     // Calculate total compressed size
@@ -293,10 +1007,11 @@ fn print_info(container: &VaiContainer) {
     println!("\n=== Assets ===");
     for asset in &container.assets {
         println!(
-            "  Asset {}: {}x{}, {} bytes",
+            "  Asset {}: {}x{}, {}, {} bytes",
             asset.id,
             asset.width,
             asset.height,
+            asset.codec.name(),
             asset.data_size()
         );
     }
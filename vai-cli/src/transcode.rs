@@ -0,0 +1,195 @@
+//! `vai transcode`: re-encode the assets of an existing file
+//!
+//! Lowering the quality of a file, or moving its sprites to a faster codec,
+//! only touches asset payloads; the timeline, slices, tiers and previews
+//! carry over unchanged.  Assets are read in windows, decoded and
+//! re-encoded on every core, and appended in order through a
+//! [`VaiWriter`], so memory is bounded by one window whatever the file size.
+
+use anyhow::{bail, Context, Result};
+use std::fs::File;
+use std::io::{BufReader, BufWriter};
+use std::path::PathBuf;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::Mutex;
+use std::thread;
+use vai_core::{Asset, AssetCodec, VaiHeader, VaiWriter};
+use vai_decoder::{sprite_decoder, AvifDecoder, DecoderConfig, LazyPayloads};
+use vai_encoder::{sprite_encoder, EncoderConfig};
+
+/// Assets held in memory per worker thread
+const WINDOW_PER_THREAD: usize = 4;
+
+/// What to change
+pub struct TranscodeOptions {
+    /// Re-encode AVIF assets at this quality; `None` copies AVIF payloads
+    /// that stay AVIF
+    pub quality: Option<u8>,
+    /// Move small sprites to this codec (large ones go to AVIF); `None`
+    /// keeps every asset's codec
+    pub sprite_codec: Option<AssetCodec>,
+    pub sprite_area: u32,
+    pub use_ffmpeg: bool,
+    /// Worker threads (0 = one per CPU)
+    pub threads: usize,
+}
+
+/// Totals reported when the transcode finishes
+#[derive(Default)]
+struct Tally {
+    reencoded: usize,
+    copied: usize,
+    bytes_in: u64,
+    bytes_out: u64,
+}
+
+pub fn transcode(input: PathBuf, output: PathBuf, options: TranscodeOptions) -> Result<()> {
+    // Creating the output truncates it, which would destroy the input before it is read
+    if let (Ok(a), Ok(b)) = (input.canonicalize(), output.canonicalize()) {
+        if a == b {
+            bail!("Output {} is the input file; write to a different path", output.display());
+        }
+    }
+    println!("Transcoding {} -> {}", input.display(), output.display());
+
+    let file = File::open(&input).context("Failed to open input")?;
+    let (index, mut payloads) = LazyPayloads::open(BufReader::new(file)).context("Failed to read VAI index")?;
+
+    let threads = match options.threads {
+        0 => thread::available_parallelism().map_or(1, |n| n.get()),
+        n => n,
+    };
+    let window = threads * WINDOW_PER_THREAD;
+    let config = EncoderConfig {
+        quality: options.quality.unwrap_or(EncoderConfig::default().quality),
+        use_ffmpeg: options.use_ffmpeg,
+        sprite_codec: options.sprite_codec.unwrap_or_default(),
+        sprite_max_area: options.sprite_area,
+        ..EncoderConfig::default()
+    };
+
+    let header = &index.header;
+    let out = BufWriter::new(File::create(&output).context("Failed to create output")?);
+    let mut writer = VaiWriter::new(
+        out,
+        VaiHeader::new(header.width, header.height, header.fps_num, header.fps_den, header.duration_ms, 0, 0),
+    )?;
+
+    println!(
+        "Re-encoding {} assets on {} threads, {} at a time",
+        index.assets.len(),
+        threads,
+        window
+    );
+    let mut tally = Tally::default();
+    for records in index.assets.chunks(window) {
+        // Payloads are read in file order; only the codec work is parallel
+        let batch: Vec<Asset> = records
+            .iter()
+            .map(|record| {
+                let data = payloads.fetch(record.id)?;
+                Ok(Asset::with_codec(record.id, record.width, record.height, record.codec, data))
+            })
+            .collect::<vai_decoder::Result<_>>()
+            .context("Failed to read asset payload")?;
+
+        for (source, converted) in batch.iter().zip(transcode_all(&batch, &options, &config, threads)?) {
+            tally.bytes_in += source.data.len() as u64;
+            match converted {
+                Some(asset) => {
+                    tally.reencoded += 1;
+                    tally.bytes_out += asset.data.len() as u64;
+                    writer.write_asset(&asset)?;
+                }
+                None => {
+                    tally.copied += 1;
+                    tally.bytes_out += source.data.len() as u64;
+                    writer.write_asset(source)?;
+                }
+            }
+        }
+        println!("  {} / {} assets", writer.assets_written(), index.assets.len());
+    }
+
+    writer.finish(index).context("Failed to write VAI tables")?;
+
+    println!(
+        "Re-encoded {} assets, copied {}; payloads {:.1} MiB -> {:.1} MiB",
+        tally.reencoded,
+        tally.copied,
+        tally.bytes_in as f64 / (1 << 20) as f64,
+        tally.bytes_out as f64 / (1 << 20) as f64
+    );
+    Ok(())
+}
+
+/// Transcodes `batch` on up to `threads` workers.  `None` means the asset
+/// is copied unchanged.
+fn transcode_all(
+    batch: &[Asset],
+    options: &TranscodeOptions,
+    config: &EncoderConfig,
+    threads: usize,
+) -> Result<Vec<Option<Asset>>> {
+    let next = AtomicUsize::new(0);
+    let results: Vec<Mutex<Option<Result<Option<Asset>>>>> = batch.iter().map(|_| Mutex::new(None)).collect();
+
+    thread::scope(|scope| {
+        for _ in 0..threads.min(batch.len()) {
+            scope.spawn(|| {
+                // One single-threaded dav1d instance per worker
+                let mut decoder = None;
+                loop {
+                    let i = next.fetch_add(1, Ordering::Relaxed);
+                    let Some(asset) = batch.get(i) else {
+                        return;
+                    };
+                    let result = transcode_asset(asset, options, config, &mut decoder)
+                        .with_context(|| format!("Failed to transcode asset {}", asset.id));
+                    *results[i].lock().unwrap() = Some(result);
+                }
+            });
+        }
+    });
+
+    results
+        .into_iter()
+        .map(|slot| slot.into_inner().unwrap().expect("every asset is transcoded"))
+        .collect()
+}
+
+fn transcode_asset(
+    asset: &Asset,
+    options: &TranscodeOptions,
+    config: &EncoderConfig,
+    decoder: &mut Option<AvifDecoder>,
+) -> Result<Option<Asset>> {
+    // Track payloads are inter-predicted sequences; they carry over as is
+    if asset.codec == AssetCodec::Av1Track {
+        return Ok(None);
+    }
+
+    let codec = match options.sprite_codec {
+        Some(_) => sprite_encoder::choose_codec(asset.width, asset.height, config),
+        None => asset.codec,
+    };
+    let unchanged = codec == asset.codec && (codec != AssetCodec::Avif || options.quality.is_none());
+    if unchanged {
+        return Ok(None);
+    }
+
+    let image = match asset.codec {
+        AssetCodec::Avif => {
+            if decoder.is_none() {
+                *decoder = Some(AvifDecoder::new(&DecoderConfig {
+                    threads: 1,
+                    ..DecoderConfig::default()
+                })?);
+            }
+            decoder.as_mut().unwrap().decode_rgba(&asset.data)?
+        }
+        _ => sprite_decoder::decode_sprite(asset, &vai_decoder::BufferPool::new(0))?,
+    };
+    let data = sprite_encoder::encode_with(&image, codec, config)?;
+    Ok(Some(Asset::with_codec(asset.id, asset.width, asset.height, codec, data)))
+}
@@ -0,0 +1,64 @@
+//! Container serialisation benchmarks
+//!
+//! Run with `cargo bench -p vai-core`; inputs are generated
+//! deterministically.
+
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use std::io::Cursor;
+use vai_core::{Asset, AssetCodec, TimelineEntry, VaiContainer, VaiHeader};
+
+#[path = "../../benches/common.rs"]
+mod common;
+
+/// Timeline sizes: a long clip and a pathological one
+const ENTRY_COUNTS: [u32; 2] = [10_000, 1_000_000];
+
+/// A container with `entries` timeline entries over 256 small raw sprites
+fn container(entries: u32) -> VaiContainer {
+    let assets: Vec<Asset> = (0..256)
+        .map(|id| Asset::with_codec(id, 8, 8, AssetCodec::Raw, vec![id as u8; 8 * 8 * 4]))
+        .collect();
+    let timeline: Vec<TimelineEntry> = (0..entries)
+        .map(|i| {
+            let start = i as u64 * 33;
+            TimelineEntry::new(i % 256, start, start + 33, (i % 1920) as i32, (i % 1080) as i32, 1)
+        })
+        .collect();
+    let header = VaiHeader::new(1920, 1080, 30, 1, entries as u64 * 33, 256, entries);
+    VaiContainer::new(header, assets, timeline)
+}
+
+fn bench_container(c: &mut Criterion) {
+    let mut group = c.benchmark_group("container");
+    group.sample_size(10);
+
+    for entries in ENTRY_COUNTS {
+        let container = container(entries);
+        let mut bytes = Vec::new();
+        container.write(&mut bytes).unwrap();
+        group.throughput(Throughput::Elements(entries as u64));
+
+        group.bench_with_input(BenchmarkId::new("write", entries), &container, |b, container| {
+            let mut out = Vec::with_capacity(bytes.len());
+            b.iter(|| {
+                out.clear();
+                container.write(&mut out).unwrap();
+                black_box(out.len())
+            })
+        });
+        group.bench_with_input(BenchmarkId::new("read", entries), &bytes, |b, bytes| {
+            b.iter(|| VaiContainer::read(Cursor::new(black_box(&bytes[..]))).unwrap())
+        });
+        group.bench_with_input(BenchmarkId::new("read_index", entries), &bytes, |b, bytes| {
+            b.iter(|| VaiContainer::read_index(&mut Cursor::new(black_box(&bytes[..]))).unwrap())
+        });
+    }
+    group.finish();
+}
+
+criterion_group! {
+    name = benches;
+    config = common::config();
+    targets = bench_container
+}
+criterion_main!(benches);
@@ -1,6 +1,80 @@
 //! Asset data structures for VAI format
 
-/// Represents a single AVIF-compressed image asset
+use crate::track::TrackIndex;
+use crate::{Error, Result};
+
+/// How an asset's pixel data is stored
+///
+/// AVIF is the default and best compression ratio.  The other codecs trade
+/// size for decode speed on sprites too small for AV1 to pay off: they decode
+/// in microseconds with no decoder setup.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Default)]
+pub enum AssetCodec {
+    /// AVIF still image
+    #[default]
+    Avif,
+    /// Uncompressed RGBA8, row-major, `width * height * 4` bytes
+    Raw,
+    /// zstd-compressed RGBA8
+    Zstd,
+    /// LZ4 block (size-prepended) of RGBA8
+    Lz4,
+    /// QOI image with 4 channels
+    Qoi,
+    /// AV1 sequence with inter frames, one temporal unit per frame
+    /// (see [`crate::track`]); timeline entries pick the frame to show
+    Av1Track,
+}
+
+impl AssetCodec {
+    /// Returns the on-disk tag for this codec
+    pub fn tag(self) -> u8 {
+        match self {
+            AssetCodec::Avif => 0,
+            AssetCodec::Raw => 1,
+            AssetCodec::Zstd => 2,
+            AssetCodec::Lz4 => 3,
+            AssetCodec::Qoi => 4,
+            AssetCodec::Av1Track => 5,
+        }
+    }
+
+    /// Parses an on-disk codec tag
+    pub fn from_tag(tag: u8) -> Option<Self> {
+        match tag {
+            0 => Some(AssetCodec::Avif),
+            1 => Some(AssetCodec::Raw),
+            2 => Some(AssetCodec::Zstd),
+            3 => Some(AssetCodec::Lz4),
+            4 => Some(AssetCodec::Qoi),
+            5 => Some(AssetCodec::Av1Track),
+            _ => None,
+        }
+    }
+
+    /// Short lowercase name, as used on the command line
+    pub fn name(self) -> &'static str {
+        match self {
+            AssetCodec::Avif => "avif",
+            AssetCodec::Raw => "raw",
+            AssetCodec::Zstd => "zstd",
+            AssetCodec::Lz4 => "lz4",
+            AssetCodec::Qoi => "qoi",
+            AssetCodec::Av1Track => "av1-track",
+        }
+    }
+
+    /// Oldest container version that can store this codec
+    pub fn min_version(self) -> u16 {
+        match self {
+            AssetCodec::Avif => 1,
+            AssetCodec::Raw | AssetCodec::Zstd | AssetCodec::Lz4 | AssetCodec::Qoi => 2,
+            AssetCodec::Av1Track => 4,
+        }
+    }
+}
+
+/// Represents a single compressed image asset
 #[derive(Debug, Clone)]
 pub struct Asset {
     /// Unique identifier for this asset
@@ -9,17 +83,25 @@ pub struct Asset {
     pub width: u32,
     /// Height of the asset in pixels
     pub height: u32,
-    /// AVIF-compressed image data
+    /// Codec of `data`
+    pub codec: AssetCodec,
+    /// Compressed image data
     pub data: Vec<u8>,
 }
 
 impl Asset {
-    /// Creates a new asset
+    /// Creates a new AVIF asset
     pub fn new(id: u32, width: u32, height: u32, data: Vec<u8>) -> Self {
+        Self::with_codec(id, width, height, AssetCodec::Avif, data)
+    }
+
+    /// Creates a new asset stored with the given codec
+    pub fn with_codec(id: u32, width: u32, height: u32, codec: AssetCodec, data: Vec<u8>) -> Self {
         Self {
             id,
             width,
             height,
+            codec,
             data,
         }
     }
@@ -28,4 +110,80 @@ impl Asset {
     pub fn data_size(&self) -> usize {
         self.data.len()
     }
+
+    /// Cheap structural check of the payload.  Only codecs whose layout is
+    /// fixed by the container are checked; compressed payloads are left to
+    /// their decoders.
+    pub fn validate(&self) -> Result<()> {
+        let valid = match self.codec {
+            AssetCodec::Raw => self.data.len() as u64 == self.width as u64 * self.height as u64 * 4,
+            AssetCodec::Av1Track => TrackIndex::parse(&self.data).is_ok(),
+            _ => true,
+        };
+        if valid {
+            Ok(())
+        } else {
+            Err(Error::InvalidAssetPayload(self.id))
+        }
+    }
+}
+
+/// A sub-rectangle of an atlas asset, addressable like an asset
+///
+/// Slice IDs share the asset ID space, so timeline entries can reference
+/// either.  Decoding the atlas once yields every slice packed into it.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct AssetSlice {
+    /// Unique identifier for this slice (distinct from every asset ID)
+    pub id: u32,
+    /// ID of the atlas asset the slice is cut from
+    pub atlas_id: u32,
+    /// Left edge within the atlas
+    pub x: u32,
+    /// Top edge within the atlas
+    pub y: u32,
+    /// Slice width in pixels
+    pub width: u32,
+    /// Slice height in pixels
+    pub height: u32,
+}
+
+impl AssetSlice {
+    /// Creates a new asset slice
+    pub fn new(id: u32, atlas_id: u32, x: u32, y: u32, width: u32, height: u32) -> Self {
+        Self {
+            id,
+            atlas_id,
+            x,
+            y,
+            width,
+            height,
+        }
+    }
+}
+
+/// Links an asset to a cheaper-to-decode version of itself
+///
+/// The tier asset is a regular asset (never referenced by the timeline)
+/// holding the same picture at reduced resolution and/or quality.  Players
+/// that cannot keep up decode it instead and scale it to the original size.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct AssetTier {
+    /// Full-quality asset
+    pub asset_id: u32,
+    /// Tier level (1 = first reduced tier; higher is cheaper)
+    pub tier: u8,
+    /// Asset holding the reduced version
+    pub tier_asset_id: u32,
+}
+
+impl AssetTier {
+    /// Creates a new tier link
+    pub fn new(asset_id: u32, tier: u8, tier_asset_id: u32) -> Self {
+        Self {
+            asset_id,
+            tier,
+            tier_asset_id,
+        }
+    }
 }
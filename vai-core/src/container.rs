@@ -1,17 +1,43 @@
 //! VAI container format serialization and deserialization
 
-use crate::{Asset, Error, Result, TimelineEntry};
+use crate::{Asset, AssetCodec, AssetSlice, AssetTier, Error, PreviewFrame, Result, TimelineEntry};
 use byteorder::{LittleEndian, ReadBytesExt, WriteBytesExt};
-use std::io::{Read, Write};
+use std::collections::HashMap;
+use std::io::{Read, Seek, SeekFrom, Write};
 
 /// Magic bytes for VAI format: "VAI\0"
 const MAGIC: [u8; 4] = [b'V', b'A', b'I', 0];
 
 /// Current VAI format version
-const VERSION: u16 = 1;
+///
+/// - 1: AVIF-only assets
+/// - 2: per-asset codec tag
+/// - 3: asset slice table (atlases)
+/// - 4: AV1 track assets, per-entry track frame index
+/// - 5: asset tier table (reduced-quality alternates)
+/// - 6: preview frame table
+pub const VERSION: u16 = 6;
+
+/// Oldest format version this library can read
+pub const MIN_VERSION: u16 = 1;
+
+/// First version whose asset records carry a codec tag
+const CODEC_TAG_VERSION: u16 = 2;
+
+/// First version with an asset slice table
+const SLICE_TABLE_VERSION: u16 = 3;
+
+/// First version whose timeline entries carry a track frame index
+const FRAME_INDEX_VERSION: u16 = 4;
+
+/// First version with an asset tier table
+const TIER_TABLE_VERSION: u16 = 5;
+
+/// First version with a preview frame table
+const PREVIEW_TABLE_VERSION: u16 = 6;
 
 /// VAI file header
-#[derive(Debug, Clone)]
+#[derive(Debug, Clone, Copy)]
 pub struct VaiHeader {
     /// Format version
     pub version: u16,
@@ -65,7 +91,7 @@ impl VaiHeader {
 
         // Read version
         let version = reader.read_u16::<LittleEndian>()?;
-        if version != VERSION {
+        if !(MIN_VERSION..=VERSION).contains(&version) {
             return Err(Error::UnsupportedVersion(version));
         }
 
@@ -103,6 +129,33 @@ impl VaiHeader {
         writer.write_u32::<LittleEndian>(self.num_timeline_entries)?;
         Ok(())
     }
+
+    /// Frame rate as an exact fraction, with zero terms treated as one
+    fn rate(&self) -> (u64, u64) {
+        (self.fps_num.max(1) as u64, self.fps_den.max(1) as u64)
+    }
+
+    /// Number of frames presented over the duration (at least one)
+    pub fn frame_count(&self) -> u64 {
+        let (fps_num, fps_den) = self.rate();
+        (self.duration_ms * fps_num).div_ceil(fps_den * 1000).max(1)
+    }
+
+    /// Presentation time of frame `index`, in exact frame units rounded down
+    /// to the millisecond
+    pub fn frame_timestamp_ms(&self, index: u64) -> u64 {
+        let (fps_num, fps_den) = self.rate();
+        index * 1000 * fps_den / fps_num
+    }
+
+    /// Index of the frame on screen at `timestamp_ms`: the last frame whose
+    /// [`frame_timestamp_ms`](Self::frame_timestamp_ms) is not after it, so
+    /// `frame_at_ms(frame_timestamp_ms(i)) == i` up to 1000 fps.  Not
+    /// clamped to [`frame_count`](Self::frame_count).
+    pub fn frame_at_ms(&self, timestamp_ms: u64) -> u64 {
+        let (fps_num, fps_den) = self.rate();
+        ((timestamp_ms + 1) * fps_num - 1) / (1000 * fps_den)
+    }
 }
 
 /// Complete VAI container
@@ -114,6 +167,12 @@ pub struct VaiContainer {
     pub assets: Vec<Asset>,
     /// Timeline entries
     pub timeline: Vec<TimelineEntry>,
+    /// Sub-rectangles of atlas assets
+    pub slices: Vec<AssetSlice>,
+    /// Reduced-quality alternates of assets
+    pub tiers: Vec<AssetTier>,
+    /// Low-resolution previews, sorted by timestamp
+    pub previews: Vec<PreviewFrame>,
 }
 
 impl VaiContainer {
@@ -123,9 +182,31 @@ impl VaiContainer {
             header,
             assets,
             timeline,
+            slices: Vec::new(),
+            tiers: Vec::new(),
+            previews: Vec::new(),
         }
     }
 
+    /// Sets the asset slice table
+    pub fn with_slices(mut self, slices: Vec<AssetSlice>) -> Self {
+        self.slices = slices;
+        self
+    }
+
+    /// Sets the asset tier table
+    pub fn with_tiers(mut self, tiers: Vec<AssetTier>) -> Self {
+        self.tiers = tiers;
+        self
+    }
+
+    /// Sets the preview frames (sorted by timestamp)
+    pub fn with_previews(mut self, mut previews: Vec<PreviewFrame>) -> Self {
+        previews.sort_by_key(|p| p.timestamp_ms);
+        self.previews = previews;
+        self
+    }
+
     /// Reads a VAI container from a reader
     pub fn read<R: Read>(mut reader: R) -> Result<Self> {
         // Read header
@@ -134,17 +215,49 @@ impl VaiContainer {
         // Read assets
         let mut assets = Vec::with_capacity(header.num_assets as usize);
         for _ in 0..header.num_assets {
-            let id = reader.read_u32::<LittleEndian>()?;
-            let width = reader.read_u32::<LittleEndian>()?;
-            let height = reader.read_u32::<LittleEndian>()?;
-            let data_len = reader.read_u32::<LittleEndian>()?;
+            let record = AssetRecord::read(&mut reader, header.version)?;
 
-            let mut data = vec![0u8; data_len as usize];
+            let mut data = vec![0u8; record.data_len as usize];
             reader.read_exact(&mut data)?;
 
-            assets.push(Asset::new(id, width, height, data));
+            let asset = record.into_asset(data);
+            asset.validate()?;
+            assets.push(asset);
+        }
+
+        Self::read_tables(reader, header, assets)
+    }
+
+    /// Reads a container without its asset payloads, seeking over them.
+    ///
+    /// The returned assets have empty `data`; the locations (parallel to
+    /// `assets`) say where each payload lives, so callers can fetch them on
+    /// demand.  Only the header, record table and trailing tables are read.
+    pub fn read_index<R: Read + Seek>(mut reader: R) -> Result<(Self, Vec<PayloadLocation>)> {
+        let header = VaiHeader::read(&mut reader)?;
+        let record_size = AssetRecord::size(header.version);
+        let mut offset = reader.stream_position()?;
+
+        let mut assets = Vec::with_capacity(header.num_assets as usize);
+        let mut locations = Vec::with_capacity(header.num_assets as usize);
+        for _ in 0..header.num_assets {
+            let record = AssetRecord::read(&mut reader, header.version)?;
+            let location = PayloadLocation {
+                offset: offset + record_size,
+                len: record.data_len,
+            };
+            offset = location.offset + location.len as u64;
+            reader.seek(SeekFrom::Start(offset))?;
+
+            assets.push(record.into_asset(Vec::new()));
+            locations.push(location);
         }
 
+        Ok((Self::read_tables(reader, header, assets)?, locations))
+    }
+
+    /// Reads everything after the asset records
+    pub(crate) fn read_tables<R: Read>(mut reader: R, header: VaiHeader, assets: Vec<Asset>) -> Result<Self> {
         // Read timeline entries
         let mut timeline = Vec::with_capacity(header.num_timeline_entries as usize);
         for _ in 0..header.num_timeline_entries {
@@ -154,18 +267,70 @@ impl VaiContainer {
             let position_x = reader.read_i32::<LittleEndian>()?;
             let position_y = reader.read_i32::<LittleEndian>()?;
             let z_order = reader.read_i32::<LittleEndian>()?;
+            let frame_index = if header.version >= FRAME_INDEX_VERSION {
+                reader.read_u32::<LittleEndian>()?
+            } else {
+                0
+            };
+
+            timeline.push(
+                TimelineEntry::new(
+                    asset_id,
+                    start_time_ms,
+                    end_time_ms,
+                    position_x,
+                    position_y,
+                    z_order,
+                )
+                .with_frame_index(frame_index),
+            );
+        }
 
-            timeline.push(TimelineEntry::new(
-                asset_id,
-                start_time_ms,
-                end_time_ms,
-                position_x,
-                position_y,
-                z_order,
-            ));
+        // Read asset slices (count-prefixed, after the timeline)
+        let mut slices = Vec::new();
+        if header.version >= SLICE_TABLE_VERSION {
+            let num_slices = reader.read_u32::<LittleEndian>()?;
+            slices.reserve(num_slices as usize);
+            for _ in 0..num_slices {
+                let id = reader.read_u32::<LittleEndian>()?;
+                let atlas_id = reader.read_u32::<LittleEndian>()?;
+                let x = reader.read_u32::<LittleEndian>()?;
+                let y = reader.read_u32::<LittleEndian>()?;
+                let width = reader.read_u32::<LittleEndian>()?;
+                let height = reader.read_u32::<LittleEndian>()?;
+                slices.push(AssetSlice::new(id, atlas_id, x, y, width, height));
+            }
         }
 
-        Ok(Self::new(header, assets, timeline))
+        // Read asset tiers (count-prefixed, after the slices)
+        let mut tiers = Vec::new();
+        if header.version >= TIER_TABLE_VERSION {
+            let num_tiers = reader.read_u32::<LittleEndian>()?;
+            tiers.reserve(num_tiers as usize);
+            for _ in 0..num_tiers {
+                let asset_id = reader.read_u32::<LittleEndian>()?;
+                let tier = reader.read_u8()?;
+                let tier_asset_id = reader.read_u32::<LittleEndian>()?;
+                tiers.push(AssetTier::new(asset_id, tier, tier_asset_id));
+            }
+        }
+
+        // Read preview frames (count-prefixed, after the tiers)
+        let mut previews = Vec::new();
+        if header.version >= PREVIEW_TABLE_VERSION {
+            let num_previews = reader.read_u32::<LittleEndian>()?;
+            previews.reserve(num_previews as usize);
+            for _ in 0..num_previews {
+                let timestamp_ms = reader.read_u64::<LittleEndian>()?;
+                let asset_id = reader.read_u32::<LittleEndian>()?;
+                previews.push(PreviewFrame::new(timestamp_ms, asset_id));
+            }
+        }
+
+        Ok(Self::new(header, assets, timeline)
+            .with_slices(slices)
+            .with_tiers(tiers)
+            .with_previews(previews))
     }
 
     /// Writes the VAI container to a writer
@@ -175,13 +340,17 @@ impl VaiContainer {
 
         // Write assets
         for asset in &self.assets {
-            writer.write_u32::<LittleEndian>(asset.id)?;
-            writer.write_u32::<LittleEndian>(asset.width)?;
-            writer.write_u32::<LittleEndian>(asset.height)?;
-            writer.write_u32::<LittleEndian>(asset.data.len() as u32)?;
+            AssetRecord::write(&mut writer, asset, self.header.version)?;
             writer.write_all(&asset.data)?;
         }
 
+        self.write_tables(writer)
+    }
+
+    /// Writes everything after the asset records
+    pub(crate) fn write_tables<W: Write>(&self, mut writer: W) -> Result<()> {
+        let version = self.header.version;
+
         // Write timeline entries
         for entry in &self.timeline {
             writer.write_u32::<LittleEndian>(entry.asset_id)?;
@@ -190,16 +359,130 @@ impl VaiContainer {
             writer.write_i32::<LittleEndian>(entry.position_x)?;
             writer.write_i32::<LittleEndian>(entry.position_y)?;
             writer.write_i32::<LittleEndian>(entry.z_order)?;
+            if version >= FRAME_INDEX_VERSION {
+                writer.write_u32::<LittleEndian>(entry.frame_index)?;
+            } else if entry.frame_index != 0 {
+                return Err(Error::InvalidTimelineEntry);
+            }
+        }
+
+        // Write asset slices
+        if version >= SLICE_TABLE_VERSION {
+            writer.write_u32::<LittleEndian>(self.slices.len() as u32)?;
+            for slice in &self.slices {
+                writer.write_u32::<LittleEndian>(slice.id)?;
+                writer.write_u32::<LittleEndian>(slice.atlas_id)?;
+                writer.write_u32::<LittleEndian>(slice.x)?;
+                writer.write_u32::<LittleEndian>(slice.y)?;
+                writer.write_u32::<LittleEndian>(slice.width)?;
+                writer.write_u32::<LittleEndian>(slice.height)?;
+            }
+        } else if !self.slices.is_empty() {
+            return Err(Error::SlicesNotInVersion(version));
+        }
+
+        // Write asset tiers
+        if version >= TIER_TABLE_VERSION {
+            writer.write_u32::<LittleEndian>(self.tiers.len() as u32)?;
+            for tier in &self.tiers {
+                writer.write_u32::<LittleEndian>(tier.asset_id)?;
+                writer.write_u8(tier.tier)?;
+                writer.write_u32::<LittleEndian>(tier.tier_asset_id)?;
+            }
+        } else if !self.tiers.is_empty() {
+            return Err(Error::TiersNotInVersion(version));
+        }
+
+        // Write preview frames
+        if version >= PREVIEW_TABLE_VERSION {
+            writer.write_u32::<LittleEndian>(self.previews.len() as u32)?;
+            for preview in &self.previews {
+                writer.write_u64::<LittleEndian>(preview.timestamp_ms)?;
+                writer.write_u32::<LittleEndian>(preview.asset_id)?;
+            }
+        } else if !self.previews.is_empty() {
+            return Err(Error::PreviewsNotInVersion(version));
         }
 
         Ok(())
     }
 
+    /// Reorders the asset payloads by the time each is first shown, so
+    /// sequential playback reads the file front to back.
+    ///
+    /// Each background sorts just ahead of the sprites of its segment, a
+    /// reduced tier follows its full-quality asset, and atlases take the
+    /// first use of any of their slices.  Unreferenced assets go last.
+    pub fn sort_assets_by_first_use(&mut self) {
+        // (first use ms, z-order, is a tier) per asset or slice ID
+        let mut first_use: HashMap<u32, (u64, i32, bool)> = HashMap::new();
+        for entry in &self.timeline {
+            note_use(&mut first_use, entry.asset_id, (entry.start_time_ms, entry.z_order, false));
+        }
+        for preview in &self.previews {
+            note_use(&mut first_use, preview.asset_id, (preview.timestamp_ms, 0, false));
+        }
+        for slice in &self.slices {
+            if let Some(&key) = first_use.get(&slice.id) {
+                note_use(&mut first_use, slice.atlas_id, key);
+            }
+        }
+        for tier in &self.tiers {
+            if let Some(&(ms, z, _)) = first_use.get(&tier.asset_id) {
+                note_use(&mut first_use, tier.tier_asset_id, (ms, z, true));
+            }
+        }
+
+        // Stable, so ties keep their current order
+        self.assets.sort_by_key(|asset| {
+            first_use
+                .get(&asset.id)
+                .copied()
+                .unwrap_or((u64::MAX, i32::MAX, true))
+        });
+    }
+
     /// Gets an asset by ID
     pub fn get_asset(&self, id: u32) -> Option<&Asset> {
         self.assets.iter().find(|a| a.id == id)
     }
 
+    /// Gets an asset slice by ID
+    pub fn get_slice(&self, id: u32) -> Option<&AssetSlice> {
+        self.slices.iter().find(|s| s.id == id)
+    }
+
+    /// Gets all slices cut from the given atlas asset
+    pub fn slices_of(&self, atlas_id: u32) -> impl Iterator<Item = &AssetSlice> {
+        self.slices.iter().filter(move |s| s.atlas_id == atlas_id)
+    }
+
+    /// Gets the reduced version of an asset at `tier`, falling back to the
+    /// closest lower tier that exists
+    pub fn get_tier(&self, asset_id: u32, tier: u8) -> Option<&AssetTier> {
+        self.tiers
+            .iter()
+            .filter(|t| t.asset_id == asset_id && t.tier <= tier)
+            .max_by_key(|t| t.tier)
+    }
+
+    /// If `tier_asset_id` is a reduced tier, returns the tier link pointing to it
+    pub fn tier_parent(&self, tier_asset_id: u32) -> Option<&AssetTier> {
+        self.tiers.iter().find(|t| t.tier_asset_id == tier_asset_id)
+    }
+
+    /// Highest tier level present in the file (0 = no tiers)
+    pub fn max_tier(&self) -> u8 {
+        self.tiers.iter().map(|t| t.tier).max().unwrap_or(0)
+    }
+
+    /// Gets the latest preview taken at or before `timestamp_ms` (the first
+    /// one for earlier times)
+    pub fn preview_at(&self, timestamp_ms: u64) -> Option<&PreviewFrame> {
+        let after = self.previews.partition_point(|p| p.timestamp_ms <= timestamp_ms);
+        self.previews.get(after.saturating_sub(1))
+    }
+
     /// Gets all timeline entries active at a given timestamp
     pub fn get_active_entries(&self, timestamp_ms: u64) -> Vec<&TimelineEntry> {
         let mut entries: Vec<&TimelineEntry> = self
@@ -217,6 +500,105 @@ impl VaiContainer {
     pub fn fps(&self) -> f64 {
         self.header.fps_num as f64 / self.header.fps_den as f64
     }
+
+    /// Number of frames presented over the duration (at least one)
+    pub fn frame_count(&self) -> u64 {
+        self.header.frame_count()
+    }
+
+    /// Presentation time of frame `index`; see [`VaiHeader::frame_timestamp_ms`]
+    pub fn frame_timestamp_ms(&self, index: u64) -> u64 {
+        self.header.frame_timestamp_ms(index)
+    }
+
+    /// Frame on screen at `timestamp_ms`; see [`VaiHeader::frame_at_ms`]
+    pub fn frame_at_ms(&self, timestamp_ms: u64) -> u64 {
+        self.header.frame_at_ms(timestamp_ms)
+    }
+}
+
+/// Where an asset payload lives within a container file
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct PayloadLocation {
+    /// Byte offset from the start of the file
+    pub offset: u64,
+    /// Payload length in bytes
+    pub len: u32,
+}
+
+/// Fixed-size part of an asset record, preceding its payload
+#[derive(Debug, Clone, Copy)]
+pub(crate) struct AssetRecord {
+    pub id: u32,
+    pub width: u32,
+    pub height: u32,
+    pub codec: AssetCodec,
+    pub data_len: u32,
+}
+
+impl AssetRecord {
+    /// Encoded size of a record header in format `version`
+    pub fn size(version: u16) -> u64 {
+        if version >= CODEC_TAG_VERSION {
+            17
+        } else {
+            16
+        }
+    }
+
+    /// Reads a record header; the payload follows it
+    pub fn read<R: Read>(reader: &mut R, version: u16) -> Result<Self> {
+        let id = reader.read_u32::<LittleEndian>()?;
+        let width = reader.read_u32::<LittleEndian>()?;
+        let height = reader.read_u32::<LittleEndian>()?;
+        let codec = if version >= CODEC_TAG_VERSION {
+            let tag = reader.read_u8()?;
+            AssetCodec::from_tag(tag).ok_or(Error::UnknownAssetCodec(tag))?
+        } else {
+            AssetCodec::Avif
+        };
+        let data_len = reader.read_u32::<LittleEndian>()?;
+
+        Ok(Self {
+            id,
+            width,
+            height,
+            codec,
+            data_len,
+        })
+    }
+
+    /// Writes the record header of `asset` (without its payload)
+    pub fn write<W: Write>(writer: &mut W, asset: &Asset, version: u16) -> Result<()> {
+        writer.write_u32::<LittleEndian>(asset.id)?;
+        writer.write_u32::<LittleEndian>(asset.width)?;
+        writer.write_u32::<LittleEndian>(asset.height)?;
+        if asset.codec.min_version() > version {
+            return Err(Error::CodecNotInVersion {
+                id: asset.id,
+                codec: asset.codec.name(),
+                version,
+            });
+        }
+        if version >= CODEC_TAG_VERSION {
+            writer.write_u8(asset.codec.tag())?;
+        }
+        writer.write_u32::<LittleEndian>(asset.data.len() as u32)?;
+        Ok(())
+    }
+
+    /// Attaches the payload
+    pub fn into_asset(self, data: Vec<u8>) -> Asset {
+        Asset::with_codec(self.id, self.width, self.height, self.codec, data)
+    }
+}
+
+/// Records a use of `id`, keeping the earliest
+fn note_use(first_use: &mut HashMap<u32, (u64, i32, bool)>, id: u32, key: (u64, i32, bool)) {
+    first_use
+        .entry(id)
+        .and_modify(|k| *k = (*k).min(key))
+        .or_insert(key);
 }
 
 #[cfg(test)]
@@ -261,4 +643,143 @@ mod tests {
         assert_eq!(container.assets.len(), read_container.assets.len());
         assert_eq!(container.timeline.len(), read_container.timeline.len());
     }
+
+    #[test]
+    fn test_asset_codec_versions() {
+        let assets = vec![
+            Asset::new(0, 4, 4, vec![1, 2, 3]),
+            Asset::with_codec(1, 2, 2, AssetCodec::Qoi, vec![4, 5]),
+        ];
+        let timeline = vec![TimelineEntry::new(0, 0, 1000, 0, 0, 0)];
+        let mut container = VaiContainer::new(VaiHeader::new(4, 4, 30, 1, 1000, 2, 1), assets, timeline);
+
+        let mut buffer = Vec::new();
+        container.write(&mut buffer).unwrap();
+        let read_container = VaiContainer::read(Cursor::new(buffer)).unwrap();
+        assert_eq!(read_container.assets[0].codec, AssetCodec::Avif);
+        assert_eq!(read_container.assets[1].codec, AssetCodec::Qoi);
+        assert_eq!(read_container.assets[1].data, vec![4, 5]);
+
+        // Version 1 has no codec tag, so only AVIF assets can be written
+        container.header.version = 1;
+        assert!(matches!(
+            container.write(&mut Vec::new()),
+            Err(Error::CodecNotInVersion { id: 1, .. })
+        ));
+
+        container.assets.truncate(1);
+        container.header.num_assets = 1;
+        let mut buffer = Vec::new();
+        container.write(&mut buffer).unwrap();
+        let read_container = VaiContainer::read(Cursor::new(buffer)).unwrap();
+        assert_eq!(read_container.header.version, 1);
+        assert_eq!(read_container.assets[0].codec, AssetCodec::Avif);
+    }
+
+    #[test]
+    fn test_frame_at_ms_inverts_frame_timestamps() {
+        for (fps_num, fps_den) in [(30, 1), (30000, 1001), (24, 1), (7, 3)] {
+            let header = VaiHeader::new(4, 4, fps_num, fps_den, 10_000, 0, 0);
+            for index in 0..header.frame_count() {
+                let timestamp_ms = header.frame_timestamp_ms(index);
+                assert_eq!(header.frame_at_ms(timestamp_ms), index, "{fps_num}/{fps_den} frame {index}");
+                let next_ms = header.frame_timestamp_ms(index + 1);
+                if next_ms > timestamp_ms + 1 {
+                    assert_eq!(header.frame_at_ms(next_ms - 1), index);
+                }
+            }
+        }
+
+        let header = VaiHeader::new(4, 4, 30, 1, 1000, 0, 0);
+        assert_eq!((header.frame_at_ms(32), header.frame_at_ms(33)), (0, 1));
+    }
+
+    #[test]
+    fn test_slice_roundtrip() {
+        let assets = vec![Asset::new(0, 64, 32, vec![1, 2, 3])];
+        let timeline = vec![TimelineEntry::new(1, 0, 1000, 5, 6, 1)];
+        let slices = vec![AssetSlice::new(1, 0, 2, 2, 10, 12), AssetSlice::new(2, 0, 16, 2, 8, 8)];
+        let container = VaiContainer::new(VaiHeader::new(64, 32, 30, 1, 1000, 1, 1), assets, timeline)
+            .with_slices(slices.clone());
+
+        let mut buffer = Vec::new();
+        container.write(&mut buffer).unwrap();
+        let read_container = VaiContainer::read(Cursor::new(buffer)).unwrap();
+        assert_eq!(read_container.slices, slices);
+        assert_eq!(read_container.get_slice(2), Some(&slices[1]));
+        assert_eq!(read_container.slices_of(0).count(), 2);
+    }
+
+    #[test]
+    fn test_tier_roundtrip() {
+        let assets = vec![Asset::new(0, 64, 32, vec![1]), Asset::new(1, 32, 16, vec![2])];
+        let timeline = vec![TimelineEntry::new(0, 0, 1000, 0, 0, 0)];
+        let container = VaiContainer::new(VaiHeader::new(64, 32, 30, 1, 1000, 2, 1), assets, timeline)
+            .with_tiers(vec![AssetTier::new(0, 1, 1)]);
+
+        let mut buffer = Vec::new();
+        container.write(&mut buffer).unwrap();
+        let read_container = VaiContainer::read(Cursor::new(buffer)).unwrap();
+        assert_eq!(read_container.max_tier(), 1);
+        assert_eq!(read_container.get_tier(0, 2).map(|t| t.tier_asset_id), Some(1));
+        assert!(read_container.get_tier(0, 0).is_none());
+        assert_eq!(read_container.tier_parent(1).map(|t| t.asset_id), Some(0));
+    }
+
+    #[test]
+    fn test_read_index_locates_payloads() {
+        let assets = vec![Asset::new(0, 64, 32, vec![1, 2, 3]), Asset::new(1, 32, 16, vec![4, 5])];
+        let timeline = vec![TimelineEntry::new(1, 0, 1000, 0, 0, 0)];
+        let container = VaiContainer::new(VaiHeader::new(64, 32, 30, 1, 1000, 2, 1), assets, timeline);
+
+        let mut buffer = Vec::new();
+        container.write(&mut buffer).unwrap();
+        let (index, locations) = VaiContainer::read_index(Cursor::new(&buffer)).unwrap();
+        assert!(index.assets.iter().all(|a| a.data.is_empty()));
+        assert_eq!(index.timeline.len(), 1);
+        for (asset, location) in container.assets.iter().zip(&locations) {
+            let start = location.offset as usize;
+            assert_eq!(&buffer[start..start + location.len as usize], &asset.data[..]);
+        }
+    }
+
+    #[test]
+    fn test_sort_assets_by_first_use() {
+        let assets = vec![
+            Asset::new(0, 8, 8, vec![0]),   // unused
+            Asset::new(1, 8, 8, vec![1]),   // sprite at 500
+            Asset::new(2, 64, 64, vec![2]), // atlas, slice 5 used at 100
+            Asset::new(3, 64, 64, vec![3]), // background from 0
+            Asset::new(4, 32, 32, vec![4]), // tier of the background
+        ];
+        let timeline = vec![
+            TimelineEntry::new(1, 500, 600, 0, 0, 1),
+            TimelineEntry::new(5, 100, 200, 0, 0, 1),
+            TimelineEntry::new(3, 0, 1000, 0, 0, 0),
+        ];
+        let mut container = VaiContainer::new(VaiHeader::new(64, 64, 30, 1, 1000, 5, 3), assets, timeline)
+            .with_slices(vec![AssetSlice::new(5, 2, 0, 0, 8, 8)])
+            .with_tiers(vec![AssetTier::new(3, 1, 4)]);
+
+        container.sort_assets_by_first_use();
+        let order: Vec<u32> = container.assets.iter().map(|a| a.id).collect();
+        assert_eq!(order, vec![3, 4, 2, 1, 0]);
+    }
+
+    #[test]
+    fn test_preview_roundtrip() {
+        let assets = vec![Asset::new(0, 64, 32, vec![1])];
+        let container = VaiContainer::new(VaiHeader::new(64, 32, 30, 1, 3000, 1, 0), assets, Vec::new())
+            .with_previews(vec![PreviewFrame::new(2000, 3), PreviewFrame::new(0, 1), PreviewFrame::new(1000, 2)]);
+
+        let mut buffer = Vec::new();
+        container.write(&mut buffer).unwrap();
+        let read_container = VaiContainer::read(Cursor::new(buffer)).unwrap();
+        assert_eq!(read_container.preview_at(0).map(|p| p.asset_id), Some(1));
+        assert_eq!(read_container.preview_at(1999).map(|p| p.asset_id), Some(2));
+        assert_eq!(read_container.preview_at(9000).map(|p| p.asset_id), Some(3));
+        assert!(VaiContainer::new(read_container.header.clone(), Vec::new(), Vec::new())
+            .preview_at(0)
+            .is_none());
+    }
 }
@@ -5,11 +5,15 @@
 
 pub mod asset;
 pub mod container;
+pub mod parallel_io;
 pub mod timeline;
+pub mod track;
+pub mod writer;
 
-pub use asset::Asset;
-pub use container::{VaiContainer, VaiHeader};
-pub use timeline::TimelineEntry;
+pub use asset::{Asset, AssetCodec, AssetSlice, AssetTier};
+pub use container::{PayloadLocation, VaiContainer, VaiHeader};
+pub use timeline::{ActiveCursor, PreviewFrame, TimelineEntry};
+pub use writer::VaiWriter;
 
 /// Result type for vai-core operations
 pub type Result<T> = std::result::Result<T, Error>;
@@ -34,4 +38,29 @@ pub enum Error {
 
     #[error("Asset not found: {0}")]
     AssetNotFound(u32),
+
+    #[error("Unknown asset codec tag: {0}")]
+    UnknownAssetCodec(u8),
+
+    #[error("Malformed track payload")]
+    InvalidTrack,
+
+    #[error("Malformed payload in asset {0}")]
+    InvalidAssetPayload(u32),
+
+    #[error("Format version {0} cannot store asset slices")]
+    SlicesNotInVersion(u16),
+
+    #[error("Format version {0} cannot store asset tiers")]
+    TiersNotInVersion(u16),
+
+    #[error("Format version {0} cannot store preview frames")]
+    PreviewsNotInVersion(u16),
+
+    #[error("Asset {id} uses codec '{codec}', which format version {version} cannot store")]
+    CodecNotInVersion {
+        id: u32,
+        codec: &'static str,
+        version: u16,
+    },
 }
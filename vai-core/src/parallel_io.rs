@@ -0,0 +1,256 @@
+//! Parallel container file I/O
+//!
+//! Asset payloads make up nearly all of a container, and their offsets
+//! follow from the record lengths alone.  The writer lays out every record
+//! first and then fills the payloads in with positional writes from several
+//! threads; the reader walks the record table, skipping the payloads, then
+//! loads and validates them concurrently.
+//!
+//! Unix and Windows have positional file I/O, so the threads share the file
+//! directly.  Elsewhere they share it behind a mutex and seek before each
+//! access, which is correct but serialises the I/O itself.
+
+use crate::container::AssetRecord;
+use crate::{Asset, Result, VaiContainer, VaiHeader};
+use std::fs::File;
+use std::io::{self, BufReader, Seek};
+use std::ops::Range;
+use std::path::Path;
+#[cfg(not(any(unix, windows)))]
+use std::sync::Mutex;
+use std::thread;
+
+/// The file as shared by the I/O threads
+#[cfg(any(unix, windows))]
+type SharedFile = File;
+#[cfg(not(any(unix, windows)))]
+type SharedFile = Mutex<File>;
+
+impl VaiContainer {
+    /// Writes the container to `path`, writing asset payloads from up to
+    /// `n_threads` threads.  The file is identical to what [`write`](Self::write)
+    /// produces.
+    pub fn write_file_parallel<P: AsRef<Path>>(&self, path: P, n_threads: usize) -> Result<()> {
+        let version = self.header.version;
+        let mut head = Vec::new();
+        self.header.write(&mut head)?;
+
+        // Lay out every record: (offset, record header, payload)
+        let mut records = Vec::with_capacity(self.assets.len());
+        let mut offset = head.len() as u64;
+        for asset in &self.assets {
+            let mut record = Vec::with_capacity(AssetRecord::size(version) as usize);
+            AssetRecord::write(&mut record, asset, version)?;
+            let record_len = record.len() as u64;
+            records.push((offset, record, &asset.data[..]));
+            offset += record_len + asset.data.len() as u64;
+        }
+
+        let mut tail = Vec::new();
+        self.write_tables(&mut tail)?;
+
+        let file = File::create(path)?;
+        file.set_len(offset + tail.len() as u64)?;
+        let file = share(file);
+        write_all_at(&file, &head, 0)?;
+        write_all_at(&file, &tail, offset)?;
+
+        let sizes: Vec<u64> = records
+            .iter()
+            .map(|(_, record, data)| (record.len() + data.len()) as u64)
+            .collect();
+        thread::scope(|scope| {
+            let workers: Vec<_> = balanced_runs(&sizes, n_threads)
+                .into_iter()
+                .map(|run| {
+                    let (file, records) = (&file, &records[run]);
+                    scope.spawn(move || -> io::Result<()> {
+                        for (offset, record, data) in records {
+                            write_all_at(file, record, *offset)?;
+                            write_all_at(file, data, offset + record.len() as u64)?;
+                        }
+                        Ok(())
+                    })
+                })
+                .collect();
+            workers
+                .into_iter()
+                .try_for_each(|worker| worker.join().expect("container writer thread panicked"))
+        })?;
+
+        Ok(())
+    }
+
+    /// Reads a container from `path`, loading and validating asset payloads
+    /// on up to `n_threads` threads
+    pub fn read_file_parallel<P: AsRef<Path>>(path: P, n_threads: usize) -> Result<Self> {
+        let file = File::open(path)?;
+        let file_len = file.metadata()?.len();
+        let mut reader = BufReader::new(&file);
+        let header = VaiHeader::read(&mut reader)?;
+
+        // Walk the record table, skipping over the payloads
+        let record_size = AssetRecord::size(header.version);
+        let mut offset = reader.stream_position()?;
+        let mut records = Vec::with_capacity(header.num_assets as usize);
+        for _ in 0..header.num_assets {
+            let record = AssetRecord::read(&mut reader, header.version)?;
+            let data_offset = offset + record_size;
+            if data_offset + record.data_len as u64 > file_len {
+                return Err(io::Error::from(io::ErrorKind::UnexpectedEof).into());
+            }
+            reader.seek_relative(record.data_len as i64)?;
+            records.push((record, data_offset));
+            offset = data_offset + record.data_len as u64;
+        }
+
+        // The remaining tables are small; parse them while still positioned
+        let mut container = Self::read_tables(&mut reader, header, Vec::new())?;
+        let file = share(file);
+
+        let sizes: Vec<u64> = records.iter().map(|(record, _)| record.data_len as u64).collect();
+        let loaded = thread::scope(|scope| {
+            let workers: Vec<_> = balanced_runs(&sizes, n_threads)
+                .into_iter()
+                .map(|run| {
+                    let (file, records) = (&file, &records[run]);
+                    scope.spawn(move || -> Result<Vec<Asset>> {
+                        records
+                            .iter()
+                            .map(|&(record, data_offset)| {
+                                let mut data = vec![0u8; record.data_len as usize];
+                                read_exact_at(file, &mut data, data_offset)?;
+                                let asset = record.into_asset(data);
+                                asset.validate()?;
+                                Ok(asset)
+                            })
+                            .collect()
+                    })
+                })
+                .collect();
+            workers
+                .into_iter()
+                .map(|worker| worker.join().expect("container reader thread panicked"))
+                .collect::<Result<Vec<_>>>()
+        })?;
+
+        container.assets = loaded.into_iter().flatten().collect();
+        Ok(container)
+    }
+}
+
+/// Splits `sizes` into at most `n` contiguous runs of roughly equal total
+/// size, so each thread works on one linear region of the file
+fn balanced_runs(sizes: &[u64], n: usize) -> Vec<Range<usize>> {
+    let total: u64 = sizes.iter().sum();
+    let n = n.max(1) as u64;
+    let mut runs = Vec::new();
+    let (mut start, mut acc) = (0, 0u64);
+    for (i, &size) in sizes.iter().enumerate() {
+        acc += size;
+        // Close the run once it reaches its share of the total
+        if acc * n >= total * (runs.len() as u64 + 1) && runs.len() as u64 + 1 < n {
+            runs.push(start..i + 1);
+            start = i + 1;
+        }
+    }
+    if start < sizes.len() {
+        runs.push(start..sizes.len());
+    }
+    runs
+}
+
+#[cfg(any(unix, windows))]
+fn share(file: File) -> SharedFile {
+    file
+}
+
+#[cfg(not(any(unix, windows)))]
+fn share(file: File) -> SharedFile {
+    Mutex::new(file)
+}
+
+#[cfg(unix)]
+fn write_all_at(file: &File, buf: &[u8], offset: u64) -> io::Result<()> {
+    std::os::unix::fs::FileExt::write_all_at(file, buf, offset)
+}
+
+#[cfg(unix)]
+fn read_exact_at(file: &File, buf: &mut [u8], offset: u64) -> io::Result<()> {
+    std::os::unix::fs::FileExt::read_exact_at(file, buf, offset)
+}
+
+#[cfg(windows)]
+fn write_all_at(file: &File, mut buf: &[u8], mut offset: u64) -> io::Result<()> {
+    use std::os::windows::fs::FileExt;
+    while !buf.is_empty() {
+        match file.seek_write(buf, offset)? {
+            0 => return Err(io::ErrorKind::WriteZero.into()),
+            n => {
+                buf = &buf[n..];
+                offset += n as u64;
+            }
+        }
+    }
+    Ok(())
+}
+
+#[cfg(windows)]
+fn read_exact_at(file: &File, mut buf: &mut [u8], mut offset: u64) -> io::Result<()> {
+    use std::os::windows::fs::FileExt;
+    while !buf.is_empty() {
+        match file.seek_read(buf, offset)? {
+            0 => return Err(io::ErrorKind::UnexpectedEof.into()),
+            n => {
+                buf = &mut buf[n..];
+                offset += n as u64;
+            }
+        }
+    }
+    Ok(())
+}
+
+#[cfg(not(any(unix, windows)))]
+fn write_all_at(file: &SharedFile, buf: &[u8], offset: u64) -> io::Result<()> {
+    use std::io::{SeekFrom, Write};
+    let mut file = file.lock().unwrap_or_else(|e| e.into_inner());
+    file.seek(SeekFrom::Start(offset))?;
+    file.write_all(buf)
+}
+
+#[cfg(not(any(unix, windows)))]
+fn read_exact_at(file: &SharedFile, buf: &mut [u8], offset: u64) -> io::Result<()> {
+    use std::io::{Read, SeekFrom};
+    let mut file = file.lock().unwrap_or_else(|e| e.into_inner());
+    file.seek(SeekFrom::Start(offset))?;
+    file.read_exact(buf)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{AssetCodec, TimelineEntry};
+
+    #[test]
+    fn test_parallel_roundtrip_matches_sequential() {
+        let assets: Vec<Asset> = (0..20)
+            .map(|i| Asset::with_codec(i, 2, 2, AssetCodec::Raw, vec![i as u8; 16]))
+            .collect();
+        let timeline = vec![TimelineEntry::new(0, 0, 1000, 0, 0, 0)];
+        let container = VaiContainer::new(VaiHeader::new(2, 2, 30, 1, 1000, 20, 1), assets, timeline);
+
+        let path = std::env::temp_dir().join(format!("vai-parallel-{}.vai", std::process::id()));
+        container.write_file_parallel(&path, 3).unwrap();
+
+        let mut sequential = Vec::new();
+        container.write(&mut sequential).unwrap();
+        assert_eq!(std::fs::read(&path).unwrap(), sequential);
+
+        let read_container = VaiContainer::read_file_parallel(&path, 4).unwrap();
+        std::fs::remove_file(&path).unwrap();
+        let ids: Vec<u32> = read_container.assets.iter().map(|a| a.id).collect();
+        assert_eq!(ids, (0..20).collect::<Vec<_>>());
+        assert_eq!(read_container.assets[7].data, vec![7; 16]);
+        assert_eq!(read_container.timeline.len(), 1);
+    }
+}
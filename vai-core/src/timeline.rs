@@ -15,6 +15,8 @@ pub struct TimelineEntry {
     pub position_y: i32,
     /// Layering order (lower = further back; background = 0)
     pub z_order: i32,
+    /// Frame of a track asset to display (0 for still assets)
+    pub frame_index: u32,
 }
 
 impl TimelineEntry {
@@ -34,9 +36,16 @@ impl TimelineEntry {
             position_x,
             position_y,
             z_order,
+            frame_index: 0,
         }
     }
 
+    /// Sets the track frame this entry displays
+    pub fn with_frame_index(mut self, frame_index: u32) -> Self {
+        self.frame_index = frame_index;
+        self
+    }
+
     /// Checks if this entry is active at the given timestamp
     pub fn is_active(&self, timestamp_ms: u64) -> bool {
         timestamp_ms >= self.start_time_ms && timestamp_ms < self.end_time_ms
@@ -47,3 +56,118 @@ impl TimelineEntry {
         self.end_time_ms.saturating_sub(self.start_time_ms)
     }
 }
+
+/// A low-resolution still of the composited video, for scrubbing and for
+/// showing something immediately after a seek
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct PreviewFrame {
+    /// Time the preview was taken
+    pub timestamp_ms: u64,
+    /// Asset (usually an atlas slice) holding the thumbnail
+    pub asset_id: u32,
+}
+
+impl PreviewFrame {
+    /// Creates a new preview frame
+    pub fn new(timestamp_ms: u64, asset_id: u32) -> Self {
+        Self {
+            timestamp_ms,
+            asset_id,
+        }
+    }
+}
+
+/// Incrementally maintained set of the timeline entries active at a time.
+///
+/// [`VaiContainer::get_active_entries`](crate::VaiContainer::get_active_entries)
+/// scans the whole timeline for every frame.  Walking forward in time, the
+/// cursor only admits entries that have started since the last call and
+/// drops those that have ended; stepping backwards restarts it.
+#[derive(Debug, Clone)]
+pub struct ActiveCursor {
+    /// Timeline indices ordered by start time
+    by_start: Vec<usize>,
+    /// Next position in `by_start` not yet admitted
+    next: usize,
+    /// Active timeline indices in z-order, ties in timeline order
+    active: Vec<usize>,
+    last_ms: Option<u64>,
+}
+
+impl ActiveCursor {
+    /// Creates a cursor over `timeline`
+    pub fn new(timeline: &[TimelineEntry]) -> Self {
+        let mut by_start: Vec<usize> = (0..timeline.len()).collect();
+        by_start.sort_by_key(|&i| timeline[i].start_time_ms);
+        Self {
+            by_start,
+            next: 0,
+            active: Vec::new(),
+            last_ms: None,
+        }
+    }
+
+    /// Moves to `timestamp_ms` and returns the indices of the entries active
+    /// there, lowest z-order first (the order `get_active_entries` uses).
+    /// `timeline` must be the one the cursor was created for.
+    pub fn advance(&mut self, timeline: &[TimelineEntry], timestamp_ms: u64) -> &[usize] {
+        if self.last_ms.is_some_and(|last| timestamp_ms < last) {
+            self.next = 0;
+            self.active.clear();
+        }
+        self.last_ms = Some(timestamp_ms);
+
+        self.active.retain(|&i| timeline[i].end_time_ms > timestamp_ms);
+
+        let mut admitted = false;
+        while let Some(&i) = self.by_start.get(self.next) {
+            if timeline[i].start_time_ms > timestamp_ms {
+                break;
+            }
+            self.next += 1;
+            // Entries that ended before this time are skipped for good
+            if timeline[i].is_active(timestamp_ms) {
+                self.active.push(i);
+                admitted = true;
+            }
+        }
+        if admitted {
+            self.active.sort_by_key(|&i| (timeline[i].z_order, i));
+        }
+
+        &self.active
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_active_cursor_matches_full_scan() {
+        let timeline: Vec<TimelineEntry> = (0..40u64)
+            .map(|i| {
+                let start = (i * 37) % 500;
+                TimelineEntry::new(i as u32, start, start + 20 + (i * 13) % 200, 0, 0, (i % 5) as i32)
+            })
+            .collect();
+        let container = crate::VaiContainer::new(
+            crate::VaiHeader::new(2, 2, 30, 1, 1000, 0, timeline.len() as u32),
+            Vec::new(),
+            timeline.clone(),
+        );
+
+        let mut cursor = ActiveCursor::new(&timeline);
+        // Forward in frame steps, then a backwards jump
+        for timestamp_ms in (0..800).step_by(33).chain([120, 121, 400]) {
+            let expected: Vec<*const TimelineEntry> =
+                container.get_active_entries(timestamp_ms).into_iter().map(|e| e as *const _).collect();
+            let actual: Vec<*const TimelineEntry> = cursor
+                .advance(&container.timeline, timestamp_ms)
+                .iter()
+                .map(|&i| &container.timeline[i] as *const _)
+                .collect();
+            assert_eq!(actual, expected, "at {timestamp_ms} ms");
+        }
+    }
+}
@@ -0,0 +1,100 @@
+//! Payload layout of AV1 track assets
+//!
+//! A track asset (`AssetCodec::Av1Track`) holds one AV1 sequence in which
+//! every displayed frame is exactly one temporal unit:
+//!
+//! | Field | Type | Description |
+//! |-------|------|-------------|
+//! | Frame count | `u32` | Number of temporal units |
+//! | Lengths | `u32[count]` | Byte length of each temporal unit |
+//! | Data | `u8[]` | Temporal units, back to back |
+//!
+//! Frame 0 is a key frame; later frames may predict from earlier ones, so
+//! they must be decoded in order.
+
+use crate::{Error, Result};
+use byteorder::{LittleEndian, ReadBytesExt, WriteBytesExt};
+use std::io::Cursor;
+use std::ops::Range;
+
+/// Serializes temporal units into a track payload
+pub fn write_track(temporal_units: &[Vec<u8>]) -> Vec<u8> {
+    let data_len: usize = temporal_units.iter().map(Vec::len).sum();
+    let mut out = Vec::with_capacity(4 + 4 * temporal_units.len() + data_len);
+
+    // Writing to a Vec cannot fail
+    out.write_u32::<LittleEndian>(temporal_units.len() as u32).unwrap();
+    for unit in temporal_units {
+        out.write_u32::<LittleEndian>(unit.len() as u32).unwrap();
+    }
+    for unit in temporal_units {
+        out.extend_from_slice(unit);
+    }
+    out
+}
+
+/// Byte ranges of each temporal unit within a track payload
+#[derive(Debug, Clone)]
+pub struct TrackIndex {
+    ranges: Vec<Range<usize>>,
+}
+
+impl TrackIndex {
+    /// Parses the frame table of a track payload
+    pub fn parse(payload: &[u8]) -> Result<Self> {
+        let mut reader = Cursor::new(payload);
+        let count = reader.read_u32::<LittleEndian>()? as usize;
+
+        // Each frame needs at least its 4-byte length
+        if count > payload.len() / 4 {
+            return Err(Error::InvalidTrack);
+        }
+
+        let mut lengths = Vec::with_capacity(count);
+        for _ in 0..count {
+            lengths.push(reader.read_u32::<LittleEndian>()? as usize);
+        }
+
+        let mut offset = reader.position() as usize;
+        let mut ranges = Vec::with_capacity(count);
+        for len in lengths {
+            let end = offset.checked_add(len).filter(|&end| end <= payload.len());
+            let end = end.ok_or(Error::InvalidTrack)?;
+            ranges.push(offset..end);
+            offset = end;
+        }
+
+        Ok(Self { ranges })
+    }
+
+    /// Number of frames in the track
+    pub fn frame_count(&self) -> u32 {
+        self.ranges.len() as u32
+    }
+
+    /// Temporal unit of `frame` within `payload`
+    pub fn temporal_unit<'a>(&self, payload: &'a [u8], frame: u32) -> Option<&'a [u8]> {
+        let range = self.ranges.get(frame as usize)?;
+        payload.get(range.clone())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_track_roundtrip() {
+        let units = vec![vec![1, 2, 3], vec![], vec![4]];
+        let payload = write_track(&units);
+
+        let index = TrackIndex::parse(&payload).unwrap();
+        assert_eq!(index.frame_count(), 3);
+        assert_eq!(index.temporal_unit(&payload, 0), Some(&[1u8, 2, 3][..]));
+        assert_eq!(index.temporal_unit(&payload, 1), Some(&[][..]));
+        assert_eq!(index.temporal_unit(&payload, 2), Some(&[4u8][..]));
+        assert_eq!(index.temporal_unit(&payload, 3), None);
+
+        assert!(TrackIndex::parse(&payload[..payload.len() - 1]).is_err());
+    }
+}
@@ -0,0 +1,99 @@
+//! Streaming container writer
+//!
+//! [`VaiContainer::write`] needs every payload in memory at once.  Asset
+//! records come before the tables, though, so a container can also be
+//! written one asset at a time: `VaiWriter` appends each asset as soon as it
+//! is ready, writes the tables at the end and then patches the asset count
+//! into the header.  Memory stays bounded by the assets in flight.
+
+use crate::container::AssetRecord;
+use crate::{Asset, Result, VaiContainer, VaiHeader};
+use std::io::{Seek, SeekFrom, Write};
+
+/// Writes a container asset by asset
+pub struct VaiWriter<W: Write + Seek> {
+    writer: W,
+    header: VaiHeader,
+    /// Offset of the header within `writer`
+    start: u64,
+    assets_written: u32,
+}
+
+impl<W: Write + Seek> VaiWriter<W> {
+    /// Starts a container at the current position of `writer`.  The asset
+    /// and timeline counts of `header` are filled in by [`finish`](Self::finish).
+    pub fn new(mut writer: W, header: VaiHeader) -> Result<Self> {
+        let start = writer.stream_position()?;
+        header.write(&mut writer)?;
+        Ok(Self {
+            writer,
+            header,
+            start,
+            assets_written: 0,
+        })
+    }
+
+    /// Appends one asset record and its payload
+    pub fn write_asset(&mut self, asset: &Asset) -> Result<()> {
+        AssetRecord::write(&mut self.writer, asset, self.header.version)?;
+        self.writer.write_all(&asset.data)?;
+        self.assets_written += 1;
+        Ok(())
+    }
+
+    /// Assets appended so far
+    pub fn assets_written(&self) -> u32 {
+        self.assets_written
+    }
+
+    /// Writes the timeline, slice, tier and preview tables of `index` (its
+    /// assets are ignored), patches the header and returns the writer,
+    /// positioned at the end of the container
+    pub fn finish(mut self, index: VaiContainer) -> Result<W> {
+        let mut header = self.header;
+        header.num_assets = self.assets_written;
+        header.num_timeline_entries = index.timeline.len() as u32;
+
+        let tables = VaiContainer {
+            header: header.clone(),
+            assets: Vec::new(),
+            ..index
+        };
+        tables.write_tables(&mut self.writer)?;
+
+        let end = self.writer.stream_position()?;
+        self.writer.seek(SeekFrom::Start(self.start))?;
+        header.write(&mut self.writer)?;
+        self.writer.seek(SeekFrom::Start(end))?;
+        self.writer.flush()?;
+        Ok(self.writer)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{AssetCodec, TimelineEntry};
+    use std::io::Cursor;
+
+    #[test]
+    fn test_streamed_container_matches_write() {
+        let assets: Vec<Asset> = (0..5)
+            .map(|i| Asset::with_codec(i, 2, 2, AssetCodec::Raw, vec![i as u8; 16]))
+            .collect();
+        let timeline = vec![TimelineEntry::new(0, 0, 1000, 0, 0, 0), TimelineEntry::new(3, 200, 400, 1, 1, 1)];
+        let container = VaiContainer::new(VaiHeader::new(2, 2, 30, 1, 1000, 5, 2), assets, timeline);
+
+        let mut expected = Vec::new();
+        container.write(&mut expected).unwrap();
+
+        let mut writer = VaiWriter::new(Cursor::new(Vec::new()), VaiHeader::new(2, 2, 30, 1, 1000, 0, 0)).unwrap();
+        for asset in &container.assets {
+            writer.write_asset(asset).unwrap();
+        }
+        let index = VaiContainer::new(container.header.clone(), Vec::new(), container.timeline.clone());
+        let streamed = writer.finish(index).unwrap().into_inner();
+
+        assert_eq!(streamed, expected);
+    }
+}
@@ -0,0 +1,164 @@
+//! Decoder hot-path benchmarks
+//!
+//! Run with `cargo bench -p vai-decoder`.  Inputs are generated from fixed
+//! seeds and encoded once with ravif and QOI directly, so the benchmarks
+//! build without the encoder crate and its FFmpeg dependency.
+
+use criterion::{black_box, criterion_group, criterion_main, BatchSize, BenchmarkId, Criterion, Throughput};
+use image::{Rgba, RgbaImage};
+use vai_core::{Asset, AssetCodec, TimelineEntry, VaiContainer, VaiHeader};
+use vai_decoder::frame_compositor::overlay_image;
+use vai_decoder::{avif_decoder, AvifDecoder, DecoderConfig, FrameCompositor};
+
+#[path = "../../benches/common.rs"]
+mod common;
+
+/// Sprite edge lengths for decoding and blending
+const SPRITE_SIZES: [u32; 3] = [64, 128, 256];
+
+/// Frames per rendered timeline
+const TIMELINE_FRAMES: u64 = 90;
+
+/// Smooth gradient with seeded noise and a soft alpha edge
+fn textured(width: u32, height: u32, seed: u32) -> RgbaImage {
+    let mut state = seed.wrapping_mul(0x9E37_79B9) | 1;
+    RgbaImage::from_fn(width, height, |x, y| {
+        // xorshift32
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        let noise = (state & 0x0F) as u8;
+        let edge = x.min(y).min(width - 1 - x).min(height - 1 - y);
+        Rgba([
+            (x * 255 / width.max(1)) as u8 ^ noise,
+            (y * 255 / height.max(1)) as u8 ^ noise,
+            ((x + y) & 0xFF) as u8,
+            (edge * 64).min(255) as u8,
+        ])
+    })
+}
+
+/// Encodes `image` to AVIF at quality 80, as the encoder's ravif path does
+fn encode_avif(image: &RgbaImage) -> Vec<u8> {
+    let pixels: Vec<ravif::RGBA8> =
+        image.pixels().map(|&Rgba([r, g, b, a])| ravif::RGBA8 { r, g, b, a }).collect();
+    let img = ravif::Img::new(&pixels[..], image.width() as usize, image.height() as usize);
+    ravif::Encoder::new()
+        .with_quality(80.0)
+        .with_alpha_quality(80.0)
+        .with_speed(4)
+        .encode_rgba(img)
+        .unwrap()
+        .avif_file
+}
+
+fn bench_decode_avif(c: &mut Criterion) {
+    let mut group = c.benchmark_group("decode_avif");
+    let mut decoder = AvifDecoder::new(&DecoderConfig {
+        threads: 1,
+        ..DecoderConfig::default()
+    })
+    .unwrap();
+
+    for size in SPRITE_SIZES {
+        let data = encode_avif(&textured(size, size, size));
+        group.throughput(Throughput::Elements(size as u64 * size as u64));
+        group.bench_with_input(BenchmarkId::new("libavif", size), &data, |b, data| {
+            b.iter(|| avif_decoder::decode_avif(black_box(data)).unwrap())
+        });
+        group.bench_with_input(BenchmarkId::new("dav1d", size), &data, |b, data| {
+            b.iter(|| {
+                let image = decoder.decode_rgba(black_box(data)).unwrap();
+                decoder.recycle(image);
+            })
+        });
+    }
+    group.finish();
+}
+
+fn bench_overlay(c: &mut Criterion) {
+    let mut group = c.benchmark_group("overlay_image");
+    let base = textured(1280, 720, 1);
+    for size in SPRITE_SIZES {
+        let sprite = textured(size, size, size);
+        group.throughput(Throughput::Elements(size as u64 * size as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(size), &sprite, |b, sprite| {
+            b.iter_batched_ref(
+                || base.clone(),
+                |frame| overlay_image(frame, black_box(sprite), 101, 57),
+                BatchSize::LargeInput,
+            )
+        });
+    }
+    group.finish();
+}
+
+/// An AVIF background with `sprites` QOI sprites; `churn` gives every
+/// sprite a three-frame lifetime instead of the whole clip
+fn synthetic_container(sprites: u32, churn: bool) -> VaiContainer {
+    let duration_ms = TIMELINE_FRAMES * 1000 / 30;
+    let background = encode_avif(&textured(1280, 720, 7));
+    let mut assets = vec![Asset::new(0, 1280, 720, background)];
+    let mut timeline = vec![TimelineEntry::new(0, 0, duration_ms, 0, 0, 0)];
+
+    for i in 1..=sprites {
+        let sprite = textured(48, 48, i);
+        let data = qoi::encode_to_vec(sprite.as_raw(), 48, 48).unwrap();
+        assets.push(Asset::with_codec(i, 48, 48, AssetCodec::Qoi, data));
+
+        let (x, y) = ((i * 197 % 1200) as i32, (i * 113 % 640) as i32);
+        if churn {
+            for start in (0..TIMELINE_FRAMES).skip(i as usize % 3).step_by(3) {
+                let (start_ms, end_ms) = (start * 1000 / 30, (start + 3) * 1000 / 30);
+                timeline.push(TimelineEntry::new(i, start_ms, end_ms, x, y, i as i32));
+            }
+        } else {
+            timeline.push(TimelineEntry::new(i, 0, duration_ms, x, y, i as i32));
+        }
+    }
+
+    let header = VaiHeader::new(1280, 720, 30, 1, duration_ms, assets.len() as u32, timeline.len() as u32);
+    VaiContainer::new(header, assets, timeline)
+}
+
+fn bench_render(c: &mut Criterion) {
+    let mut group = c.benchmark_group("render_frame");
+    group.sample_size(10);
+    group.throughput(Throughput::Elements(TIMELINE_FRAMES));
+
+    for (name, sprites, churn) in [("static_16", 16, false), ("static_64", 64, false), ("churn_64", 64, true)] {
+        let container = synthetic_container(sprites, churn);
+        group.bench_with_input(BenchmarkId::new("rgba", name), &container, |b, container| {
+            b.iter_batched_ref(
+                || FrameCompositor::new(container.clone()),
+                |compositor| {
+                    for frame in 0..TIMELINE_FRAMES {
+                        let timestamp_ms = compositor.container().frame_timestamp_ms(frame);
+                        black_box(compositor.render_frame(timestamp_ms).unwrap());
+                    }
+                },
+                BatchSize::LargeInput,
+            )
+        });
+        group.bench_with_input(BenchmarkId::new("frames_i420", name), &container, |b, container| {
+            b.iter_batched_ref(
+                || FrameCompositor::new(container.clone()),
+                |compositor| {
+                    let mut frames = compositor.frames_i420(0..TIMELINE_FRAMES);
+                    while let Some(frame) = frames.next() {
+                        black_box(frame.unwrap().pixels);
+                    }
+                },
+                BatchSize::LargeInput,
+            )
+        });
+    }
+    group.finish();
+}
+
+criterion_group! {
+    name = benches;
+    config = common::config();
+    targets = bench_decode_avif, bench_overlay, bench_render
+}
+criterion_main!(benches);
@@ -3,7 +3,10 @@
 use crate::{Error, Result};
 use image::{ImageBuffer, Rgba};
 
-/// Decodes AVIF data into an RGBA image buffer
+/// Decodes AVIF data into an RGBA image buffer through libavif.
+///
+/// This is the general-purpose path; `AvifDecoder` is faster and falls back
+/// to it for files it cannot handle directly.
 pub fn decode_avif(data: &[u8]) -> Result<ImageBuffer<Rgba<u8>, Vec<u8>>> {
     let img = libavif_image::read(data)
         .map_err(|e| Error::AvifDecode(format!("{:?}", e)))?;
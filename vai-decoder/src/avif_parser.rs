@@ -0,0 +1,564 @@
+//! Minimal AVIF (ISOBMFF/HEIF) item parser
+//!
+//! Extracts just what the direct dav1d path needs from a still AVIF: the AV1
+//! payload of the primary item, the payload of its alpha auxiliary item (if
+//! any), and the `nclx` colour information.  Anything outside that subset
+//! (grid/derived images, premultiplied alpha, external data references)
+//! yields `Error::AvifUnsupported` so the caller can fall back to libavif.
+
+use crate::{Error, Result};
+use std::borrow::Cow;
+
+/// AUX type URNs that identify an alpha plane
+const ALPHA_URNS: &[&[u8]] = &[
+    b"urn:mpeg:mpegB:cicp:systems:auxiliary:alpha",
+    b"urn:mpeg:hevc:2015:auxid:1",
+];
+
+/// `nclx` colour information from a `colr` property
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Nclx {
+    /// CICP matrix coefficients (1 = BT.709, 5/6 = BT.601, 9 = BT.2020 NCL, …)
+    pub matrix_coefficients: u16,
+    /// True for full-range samples
+    pub full_range: bool,
+}
+
+/// The parts of an AVIF file needed to decode it
+#[derive(Debug)]
+pub struct AvifItems<'a> {
+    /// AV1 OBUs of the primary (colour) item
+    pub color: Cow<'a, [u8]>,
+    /// AV1 OBUs of the alpha auxiliary item
+    pub alpha: Option<Cow<'a, [u8]>>,
+    /// Image extents from `ispe`, if present
+    pub extents: Option<(u32, u32)>,
+    /// Colour information of the primary item, if present
+    pub nclx: Option<Nclx>,
+}
+
+#[derive(Debug, Default, Clone)]
+struct ItemLocation {
+    construction_method: u8,
+    base_offset: u64,
+    extents: Vec<(u64, u64)>,
+}
+
+#[derive(Debug)]
+enum Property<'a> {
+    Ispe(u32, u32),
+    Colr(Nclx),
+    AuxC(&'a [u8]),
+    Other,
+}
+
+/// Parses an AVIF file and locates the primary and alpha AV1 payloads
+pub fn parse_avif(data: &[u8]) -> Result<AvifItems<'_>> {
+    let mut meta = None;
+    for (box_type, body) in BoxIter::new(data) {
+        if &box_type == b"meta" {
+            meta = Some(body);
+            break;
+        }
+    }
+    let meta = meta.ok_or_else(|| unsupported("missing meta box"))?;
+    // meta is a FullBox: skip version + flags
+    let meta = meta.get(4..).ok_or_else(|| malformed("meta"))?;
+
+    let mut primary_id = None;
+    let mut locations: Vec<(u32, ItemLocation)> = Vec::new();
+    let mut item_types: Vec<(u32, [u8; 4])> = Vec::new();
+    let mut references: Vec<([u8; 4], u32, Vec<u32>)> = Vec::new();
+    let mut properties: Vec<Property> = Vec::new();
+    let mut associations: Vec<(u32, Vec<u16>)> = Vec::new();
+    let mut idat: &[u8] = &[];
+
+    for (box_type, body) in BoxIter::new(meta) {
+        match &box_type {
+            b"pitm" => {
+                let mut r = Reader::new(body);
+                let version = r.u8()?;
+                r.skip(3)?;
+                primary_id = Some(if version == 0 { r.u16()? as u32 } else { r.u32()? });
+            }
+            b"iloc" => locations = parse_iloc(body)?,
+            b"iinf" => item_types = parse_iinf(body)?,
+            b"iref" => references = parse_iref(body)?,
+            b"iprp" => {
+                for (child_type, child) in BoxIter::new(body) {
+                    match &child_type {
+                        b"ipco" => properties = parse_ipco(child),
+                        b"ipma" => associations.extend(parse_ipma(child)?),
+                        _ => {}
+                    }
+                }
+            }
+            b"idat" => idat = body,
+            _ => {}
+        }
+    }
+
+    let primary_id = primary_id.ok_or_else(|| unsupported("missing pitm"))?;
+    let item_type = |id: u32| item_types.iter().find(|(i, _)| *i == id).map(|(_, t)| *t);
+    match item_type(primary_id) {
+        Some(t) if &t == b"av01" => {}
+        Some(t) => {
+            return Err(unsupported(&format!(
+                "primary item type '{}'",
+                String::from_utf8_lossy(&t)
+            )))
+        }
+        None => return Err(unsupported("primary item has no infe")),
+    }
+
+    let props_of = |id: u32| -> Vec<&Property> {
+        associations
+            .iter()
+            .filter(|(item, _)| *item == id)
+            .flat_map(|(_, idx)| idx.iter())
+            .filter_map(|&i| properties.get((i as usize).checked_sub(1)?))
+            .collect()
+    };
+
+    let mut extents = None;
+    let mut nclx = None;
+    for prop in props_of(primary_id) {
+        match prop {
+            Property::Ispe(w, h) => extents = Some((*w, *h)),
+            Property::Colr(c) => nclx = Some(*c),
+            _ => {}
+        }
+    }
+
+    // Alpha: an av01 item with an `auxl` reference to the primary and an
+    // alpha `auxC` property
+    let alpha_id = references
+        .iter()
+        .filter(|(t, _, to)| t == b"auxl" && to.contains(&primary_id))
+        .map(|(_, from, _)| *from)
+        .find(|&id| {
+            item_type(id).map_or(false, |t| &t == b"av01")
+                && props_of(id).iter().any(|p| match p {
+                    Property::AuxC(urn) => ALPHA_URNS.iter().any(|u| urn.starts_with(u)),
+                    _ => false,
+                })
+        });
+
+    // `prem` points from the colour item to the alpha it was multiplied by
+    if let Some(alpha_id) = alpha_id {
+        if references
+            .iter()
+            .any(|(t, from, to)| t == b"prem" && *from == primary_id && to.contains(&alpha_id))
+        {
+            return Err(unsupported("premultiplied alpha"));
+        }
+    }
+
+    let item_data = |id: u32| -> Result<Cow<'_, [u8]>> {
+        let loc = locations
+            .iter()
+            .find(|(i, _)| *i == id)
+            .map(|(_, l)| l)
+            .ok_or_else(|| malformed("item without iloc entry"))?;
+        let source = match loc.construction_method {
+            0 => data,
+            1 => idat,
+            _ => return Err(unsupported("iloc construction method")),
+        };
+        let extent = |&(offset, len): &(u64, u64)| -> Result<&[u8]> {
+            let start = loc.base_offset.checked_add(offset).ok_or_else(|| malformed("iloc"))? as usize;
+            // A zero length means "to the end of the source"
+            let end = if len == 0 { source.len() } else { start.saturating_add(len as usize) };
+            source.get(start..end).ok_or_else(|| malformed("iloc extent out of range"))
+        };
+        match loc.extents.as_slice() {
+            [single] => Ok(Cow::Borrowed(extent(single)?)),
+            many => {
+                let mut joined = Vec::new();
+                for e in many {
+                    joined.extend_from_slice(extent(e)?);
+                }
+                Ok(Cow::Owned(joined))
+            }
+        }
+    };
+
+    Ok(AvifItems {
+        color: item_data(primary_id)?,
+        alpha: alpha_id.map(item_data).transpose()?,
+        extents,
+        nclx,
+    })
+}
+
+fn parse_iloc(body: &[u8]) -> Result<Vec<(u32, ItemLocation)>> {
+    let mut r = Reader::new(body);
+    let version = r.u8()?;
+    r.skip(3)?;
+    if version > 2 {
+        return Err(unsupported("iloc version"));
+    }
+
+    let sizes = r.u8()?;
+    let offset_size = sizes >> 4;
+    let length_size = sizes & 0x0F;
+    let sizes = r.u8()?;
+    let base_offset_size = sizes >> 4;
+    let index_size = if version >= 1 { sizes & 0x0F } else { 0 };
+    let item_count = if version < 2 { r.u16()? as u32 } else { r.u32()? };
+
+    let mut items = Vec::with_capacity(item_count.min(64) as usize);
+    for _ in 0..item_count {
+        let item_id = if version < 2 { r.u16()? as u32 } else { r.u32()? };
+        let construction_method = if version >= 1 { (r.u16()? & 0x0F) as u8 } else { 0 };
+        let data_reference_index = r.u16()?;
+        if data_reference_index != 0 {
+            return Err(unsupported("external data reference"));
+        }
+        let base_offset = r.uint(base_offset_size)?;
+        let extent_count = r.u16()?;
+        let mut extents = Vec::with_capacity(extent_count as usize);
+        for _ in 0..extent_count {
+            r.uint(index_size)?;
+            let offset = r.uint(offset_size)?;
+            let length = r.uint(length_size)?;
+            extents.push((offset, length));
+        }
+        items.push((
+            item_id,
+            ItemLocation {
+                construction_method,
+                base_offset,
+                extents,
+            },
+        ));
+    }
+    Ok(items)
+}
+
+fn parse_iinf(body: &[u8]) -> Result<Vec<(u32, [u8; 4])>> {
+    let mut r = Reader::new(body);
+    let version = r.u8()?;
+    r.skip(3)?;
+    let count = if version == 0 { r.u16()? as u32 } else { r.u32()? };
+    let rest = r.rest();
+
+    let mut types = Vec::with_capacity(count.min(64) as usize);
+    for (box_type, infe) in BoxIter::new(rest) {
+        if &box_type != b"infe" {
+            continue;
+        }
+        let mut r = Reader::new(infe);
+        let version = r.u8()?;
+        r.skip(3)?;
+        if version < 2 {
+            continue; // Pre-HEIF entries carry no item type
+        }
+        let id = if version == 2 { r.u16()? as u32 } else { r.u32()? };
+        r.skip(2)?; // item_protection_index
+        types.push((id, r.fourcc()?));
+    }
+    Ok(types)
+}
+
+fn parse_iref(body: &[u8]) -> Result<Vec<([u8; 4], u32, Vec<u32>)>> {
+    let mut r = Reader::new(body);
+    let version = r.u8()?;
+    r.skip(3)?;
+    let rest = r.rest();
+
+    let mut refs = Vec::new();
+    for (ref_type, child) in BoxIter::new(rest) {
+        let mut r = Reader::new(child);
+        let id = |r: &mut Reader| -> Result<u32> {
+            if version == 0 {
+                Ok(r.u16()? as u32)
+            } else {
+                r.u32()
+            }
+        };
+        let from = id(&mut r)?;
+        let count = r.u16()?;
+        let mut to = Vec::with_capacity(count as usize);
+        for _ in 0..count {
+            to.push(id(&mut r)?);
+        }
+        refs.push((ref_type, from, to));
+    }
+    Ok(refs)
+}
+
+fn parse_ipco(body: &[u8]) -> Vec<Property<'_>> {
+    BoxIter::new(body)
+        .map(|(box_type, prop)| match &box_type {
+            b"ispe" if prop.len() >= 12 => Property::Ispe(
+                u32::from_be_bytes([prop[4], prop[5], prop[6], prop[7]]),
+                u32::from_be_bytes([prop[8], prop[9], prop[10], prop[11]]),
+            ),
+            b"colr" if prop.len() >= 11 && &prop[0..4] == b"nclx" => Property::Colr(Nclx {
+                matrix_coefficients: u16::from_be_bytes([prop[8], prop[9]]),
+                full_range: prop[10] & 0x80 != 0,
+            }),
+            b"auxC" if prop.len() >= 4 => Property::AuxC(&prop[4..]),
+            _ => Property::Other,
+        })
+        .collect()
+}
+
+fn parse_ipma(body: &[u8]) -> Result<Vec<(u32, Vec<u16>)>> {
+    let mut r = Reader::new(body);
+    let version = r.u8()?;
+    r.skip(2)?;
+    let flags = r.u8()?;
+    let entry_count = r.u32()?;
+
+    let mut entries = Vec::with_capacity(entry_count.min(64) as usize);
+    for _ in 0..entry_count {
+        let item_id = if version < 1 { r.u16()? as u32 } else { r.u32()? };
+        let count = r.u8()?;
+        let mut indices = Vec::with_capacity(count as usize);
+        for _ in 0..count {
+            // High bit is the `essential` flag
+            let index = if flags & 1 != 0 { r.u16()? & 0x7FFF } else { (r.u8()? & 0x7F) as u16 };
+            indices.push(index);
+        }
+        entries.push((item_id, indices));
+    }
+    Ok(entries)
+}
+
+fn unsupported(what: &str) -> Error {
+    Error::AvifUnsupported(what.to_string())
+}
+
+fn malformed(what: &str) -> Error {
+    Error::AvifDecode(format!("malformed AVIF: {what}"))
+}
+
+/// Iterates the boxes directly inside `data`, yielding (type, body)
+struct BoxIter<'a> {
+    data: &'a [u8],
+}
+
+impl<'a> BoxIter<'a> {
+    fn new(data: &'a [u8]) -> Self {
+        Self { data }
+    }
+}
+
+impl<'a> Iterator for BoxIter<'a> {
+    type Item = ([u8; 4], &'a [u8]);
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.data.len() < 8 {
+            return None;
+        }
+        let size = u32::from_be_bytes(self.data[0..4].try_into().ok()?) as u64;
+        let box_type: [u8; 4] = self.data[4..8].try_into().ok()?;
+        let (header_len, size) = match size {
+            0 => (8, self.data.len() as u64),
+            1 => (16, u64::from_be_bytes(self.data.get(8..16)?.try_into().ok()?)),
+            n => (8, n),
+        };
+        if size < header_len || size > self.data.len() as u64 {
+            self.data = &[];
+            return None;
+        }
+        let body = &self.data[header_len as usize..size as usize];
+        self.data = &self.data[size as usize..];
+        Some((box_type, body))
+    }
+}
+
+/// Big-endian cursor over a box body
+struct Reader<'a> {
+    data: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> Reader<'a> {
+    fn new(data: &'a [u8]) -> Self {
+        Self { data, pos: 0 }
+    }
+
+    fn take(&mut self, n: usize) -> Result<&'a [u8]> {
+        let end = self.pos.checked_add(n).filter(|&e| e <= self.data.len());
+        let end = end.ok_or_else(|| malformed("truncated box"))?;
+        let bytes = &self.data[self.pos..end];
+        self.pos = end;
+        Ok(bytes)
+    }
+
+    fn skip(&mut self, n: usize) -> Result<()> {
+        self.take(n).map(|_| ())
+    }
+
+    fn u8(&mut self) -> Result<u8> {
+        Ok(self.take(1)?[0])
+    }
+
+    fn u16(&mut self) -> Result<u16> {
+        Ok(u16::from_be_bytes(self.take(2)?.try_into().unwrap()))
+    }
+
+    fn u32(&mut self) -> Result<u32> {
+        Ok(u32::from_be_bytes(self.take(4)?.try_into().unwrap()))
+    }
+
+    fn fourcc(&mut self) -> Result<[u8; 4]> {
+        Ok(self.take(4)?.try_into().unwrap())
+    }
+
+    /// Reads an unsigned integer of 0, 4 or 8 bytes
+    fn uint(&mut self, size: u8) -> Result<u64> {
+        match size {
+            0 => Ok(0),
+            4 => Ok(self.u32()? as u64),
+            8 => Ok(u64::from_be_bytes(self.take(8)?.try_into().unwrap())),
+            _ => Err(malformed("iloc field size")),
+        }
+    }
+
+    fn rest(&self) -> &'a [u8] {
+        &self.data[self.pos..]
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn boxed(box_type: &[u8; 4], body: &[u8]) -> Vec<u8> {
+        let mut out = ((8 + body.len()) as u32).to_be_bytes().to_vec();
+        out.extend_from_slice(box_type);
+        out.extend_from_slice(body);
+        out
+    }
+
+    fn full(box_type: &[u8; 4], version: u8, body: &[u8]) -> Vec<u8> {
+        let mut inner = vec![version, 0, 0, 0];
+        inner.extend_from_slice(body);
+        boxed(box_type, &inner)
+    }
+
+    #[test]
+    fn test_parse_single_item_avif() {
+        let payload = [0x12u8, 0x00, 0x0A, 0x0B, 0xAA, 0xBB];
+
+        let mut infe = 1u16.to_be_bytes().to_vec();
+        infe.extend_from_slice(&[0, 0]);
+        infe.extend_from_slice(b"av01\0");
+        let mut iinf = 1u16.to_be_bytes().to_vec();
+        iinf.extend(full(b"infe", 2, &infe));
+
+        let mut ispe = 7u32.to_be_bytes().to_vec();
+        ispe.extend_from_slice(&5u32.to_be_bytes());
+        let ipco = boxed(b"ipco", &full(b"ispe", 0, &ispe));
+        let mut ipma = 1u32.to_be_bytes().to_vec();
+        ipma.extend_from_slice(&[0, 1, 1, 0x81]);
+        let mut iprp = ipco;
+        iprp.extend(full(b"ipma", 0, &ipma));
+
+        let build = |offset: u32| {
+            let mut iloc = vec![0x44, 0x00];
+            iloc.extend_from_slice(&1u16.to_be_bytes()); // item_count
+            iloc.extend_from_slice(&1u16.to_be_bytes()); // item_ID
+            iloc.extend_from_slice(&0u16.to_be_bytes()); // data_reference_index
+            iloc.extend_from_slice(&1u16.to_be_bytes()); // extent_count
+            iloc.extend_from_slice(&offset.to_be_bytes());
+            iloc.extend_from_slice(&(payload.len() as u32).to_be_bytes());
+
+            let mut meta = full(b"pitm", 0, &1u16.to_be_bytes());
+            meta.extend(full(b"iinf", 0, &iinf));
+            meta.extend(boxed(b"iprp", &iprp));
+            meta.extend(full(b"iloc", 0, &iloc));
+
+            let mut file = boxed(b"ftyp", b"avif\0\0\0\0avifmif1");
+            file.extend(full(b"meta", 0, &meta));
+            let mdat_offset = file.len() as u32 + 8;
+            file.extend(boxed(b"mdat", &payload));
+            (file, mdat_offset)
+        };
+
+        let (_, offset) = build(0);
+        let (file, _) = build(offset);
+
+        let items = parse_avif(&file).unwrap();
+        assert_eq!(&items.color[..], &payload);
+        assert!(items.alpha.is_none());
+        assert_eq!(items.extents, Some((7, 5)));
+    }
+
+    /// Colour item 1 with alpha item 2, plus any extra `iref` children
+    fn alpha_avif(extra_refs: &[u8]) -> Vec<u8> {
+        let color = [0x12u8, 0x00, 0x0A, 0x0B];
+        let alpha = [0x12u8, 0x00, 0x0A, 0x0C];
+
+        let mut iinf = 2u16.to_be_bytes().to_vec();
+        for id in [1u16, 2] {
+            let mut infe = id.to_be_bytes().to_vec();
+            infe.extend_from_slice(&[0, 0]);
+            infe.extend_from_slice(b"av01\0");
+            iinf.extend(full(b"infe", 2, &infe));
+        }
+
+        let mut iref = vec![0, 0, 0, 0];
+        let mut auxl = 2u16.to_be_bytes().to_vec();
+        auxl.extend_from_slice(&1u16.to_be_bytes());
+        auxl.extend_from_slice(&1u16.to_be_bytes());
+        iref.extend(boxed(b"auxl", &auxl));
+        iref.extend_from_slice(extra_refs);
+
+        let ipco = boxed(b"ipco", &full(b"auxC", 0, b"urn:mpeg:mpegB:cicp:systems:auxiliary:alpha\0"));
+        let mut ipma = 1u32.to_be_bytes().to_vec();
+        ipma.extend_from_slice(&[0, 2, 1, 0x81]);
+        let mut iprp = ipco;
+        iprp.extend(full(b"ipma", 0, &ipma));
+
+        let build = |offset: u32| {
+            let mut iloc = vec![0x44, 0x00];
+            iloc.extend_from_slice(&2u16.to_be_bytes()); // item_count
+            for (id, start, len) in [(1u16, 0, color.len()), (2, color.len(), alpha.len())] {
+                iloc.extend_from_slice(&id.to_be_bytes());
+                iloc.extend_from_slice(&0u16.to_be_bytes()); // data_reference_index
+                iloc.extend_from_slice(&1u16.to_be_bytes()); // extent_count
+                iloc.extend_from_slice(&(offset + start as u32).to_be_bytes());
+                iloc.extend_from_slice(&(len as u32).to_be_bytes());
+            }
+
+            let mut meta = full(b"pitm", 0, &1u16.to_be_bytes());
+            meta.extend(full(b"iinf", 0, &iinf));
+            meta.extend(boxed(b"iref", &iref));
+            meta.extend(boxed(b"iprp", &iprp));
+            meta.extend(full(b"iloc", 0, &iloc));
+
+            let mut file = boxed(b"ftyp", b"avif\0\0\0\0avifmif1");
+            file.extend(full(b"meta", 0, &meta));
+            let mdat_offset = file.len() as u32 + 8;
+            file.extend(boxed(b"mdat", &[&color[..], &alpha[..]].concat()));
+            (file, mdat_offset)
+        };
+
+        let (_, offset) = build(0);
+        build(offset).0
+    }
+
+    #[test]
+    fn test_prem_reference_from_primary_is_rejected() {
+        let reference = |from: u16, to: u16| {
+            let mut body = from.to_be_bytes().to_vec();
+            body.extend_from_slice(&1u16.to_be_bytes());
+            body.extend_from_slice(&to.to_be_bytes());
+            boxed(b"prem", &body)
+        };
+
+        let file = alpha_avif(&[]);
+        let items = parse_avif(&file).unwrap();
+        assert_eq!(items.alpha.as_deref(), Some(&[0x12u8, 0x00, 0x0A, 0x0C][..]));
+
+        // The colour item was premultiplied by the alpha item
+        assert!(parse_avif(&alpha_avif(&reference(1, 2))).is_err());
+        // The reverse direction is not a premultiplication signal
+        assert!(parse_avif(&alpha_avif(&reference(2, 1))).is_ok());
+    }
+}
@@ -0,0 +1,68 @@
+//! Reusable pixel buffer pool
+//!
+//! Decoded assets and scratch planes are large and short-lived; recycling
+//! their allocations avoids hammering the allocator on every decode.
+
+use std::sync::{Arc, Mutex};
+
+/// Thread-safe pool of byte buffers.  Cloning shares the same pool.
+#[derive(Debug, Clone)]
+pub struct BufferPool {
+    free: Arc<Mutex<Vec<Vec<u8>>>>,
+    max_buffers: usize,
+}
+
+impl BufferPool {
+    /// Creates a pool that keeps at most `max_buffers` idle buffers
+    pub fn new(max_buffers: usize) -> Self {
+        Self {
+            free: Arc::new(Mutex::new(Vec::with_capacity(max_buffers))),
+            max_buffers,
+        }
+    }
+
+    /// Takes a buffer of exactly `len` bytes.  Contents are unspecified.
+    ///
+    /// Prefers the smallest idle buffer whose capacity already fits, so large
+    /// background-sized buffers are not burned on small sprites.
+    pub fn take(&self, len: usize) -> Vec<u8> {
+        let reused = {
+            let mut free = self.free.lock().unwrap();
+            let best = free
+                .iter()
+                .enumerate()
+                .filter(|(_, b)| b.capacity() >= len)
+                .min_by_key(|(_, b)| b.capacity())
+                .map(|(i, _)| i);
+            best.map(|i| free.swap_remove(i))
+        };
+
+        // Old contents are kept; only growth beyond the previous length is zeroed
+        let mut buf = reused.unwrap_or_default();
+        buf.truncate(len);
+        buf.resize(len, 0);
+        buf
+    }
+
+    /// Returns a buffer to the pool (dropped if the pool is full)
+    pub fn give(&self, buf: Vec<u8>) {
+        if buf.capacity() == 0 {
+            return;
+        }
+        let mut free = self.free.lock().unwrap();
+        if free.len() < self.max_buffers {
+            free.push(buf);
+        }
+    }
+
+    /// Number of idle buffers currently held
+    pub fn idle(&self) -> usize {
+        self.free.lock().unwrap().len()
+    }
+}
+
+impl Default for BufferPool {
+    fn default() -> Self {
+        Self::new(16)
+    }
+}
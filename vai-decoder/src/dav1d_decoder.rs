@@ -0,0 +1,341 @@
+//! Direct AVIF decoding through dav1d
+//!
+//! `avif_decoder::decode_avif` goes through libavif and `image`, which
+//! allocates a `DynamicImage` and then copies it again in `to_rgba8()`, with
+//! no say over decoder threading.  `AvifDecoder` instead parses the AVIF items
+//! itself, keeps one dav1d instance alive with a configurable thread setup,
+//! and converts YUV straight into pooled RGBA (or planar YUVA) buffers.
+//! Payloads passed as [`Bytes`] reach dav1d as views, without copying the
+//! OBUs out.
+//! Anything outside the supported subset (high bit depth, grids,
+//! premultiplied alpha, …) transparently falls back to libavif.
+
+use crate::avif_parser::{self, Nclx};
+use crate::buffer_pool::BufferPool;
+use crate::yuv::{self, YuvMatrix, YuvPlanes, YuvToRgb, YuvaImage};
+use crate::{avif_decoder, Error, Result};
+use bytes::Bytes;
+use dav1d::pixel::{MatrixCoefficients, YUVRange};
+use dav1d::{PixelLayout, PlanarImageComponent};
+use image::RgbaImage;
+use std::borrow::Cow;
+
+/// Upper bound on `get_picture` retries while dav1d drains
+const MAX_DRAIN_ATTEMPTS: usize = 64;
+
+/// dav1d threading and buffer pool configuration
+#[derive(Debug, Clone)]
+pub struct DecoderConfig {
+    /// dav1d worker threads (0 = one per CPU)
+    pub threads: u32,
+    /// Maximum frames dav1d keeps in flight (0 = automatic).  Stills gain
+    /// nothing from frame threading, so 1 gives the lowest latency.
+    pub max_frame_delay: u32,
+    /// Idle output buffers kept for reuse
+    pub pool_size: usize,
+}
+
+impl Default for DecoderConfig {
+    fn default() -> Self {
+        Self {
+            threads: 0,
+            max_frame_delay: 1,
+            pool_size: 16,
+        }
+    }
+}
+
+/// Reusable AVIF decoder backed by a single dav1d instance
+pub struct AvifDecoder {
+    decoder: dav1d::Decoder,
+    pool: BufferPool,
+}
+
+impl AvifDecoder {
+    /// Creates a decoder with the given configuration
+    pub fn new(config: &DecoderConfig) -> Result<Self> {
+        let mut settings = dav1d::Settings::new();
+        settings.set_n_threads(config.threads);
+        settings.set_max_frame_delay(config.max_frame_delay);
+
+        let decoder = dav1d::Decoder::with_settings(&settings)
+            .map_err(|e| Error::AvifDecode(format!("dav1d init failed: {e:?}")))?;
+
+        Ok(Self {
+            decoder,
+            pool: BufferPool::new(config.pool_size),
+        })
+    }
+
+    /// The pool output buffers are drawn from
+    pub fn pool(&self) -> &BufferPool {
+        &self.pool
+    }
+
+    /// Hands a decoded image's buffer back to the pool
+    pub fn recycle(&self, image: RgbaImage) {
+        self.pool.give(image.into_raw());
+    }
+
+    /// Decodes AVIF data into an RGBA image backed by a pooled buffer.
+    /// dav1d needs owned input, so `data` is copied once; see
+    /// [`Self::decode_rgba_shared`].
+    pub fn decode_rgba(&mut self, data: &[u8]) -> Result<RgbaImage> {
+        self.decode_rgba_shared(&Bytes::copy_from_slice(data))
+    }
+
+    /// [`Self::decode_rgba`] for shared data, which dav1d reads in place
+    pub fn decode_rgba_shared(&mut self, data: &Bytes) -> Result<RgbaImage> {
+        match self.decode_rgba_direct(data) {
+            Err(Error::AvifUnsupported(_)) => avif_decoder::decode_avif(data),
+            other => other,
+        }
+    }
+
+    /// Decodes AVIF data into planar YUVA for the I420 compositing target.
+    ///
+    /// 8-bit 4:2:0 BT.601 limited-range pictures (what the encoders produce)
+    /// are copied plane by plane with no RGB round trip.
+    pub fn decode_yuva(&mut self, data: &[u8]) -> Result<YuvaImage> {
+        self.decode_yuva_shared(&Bytes::copy_from_slice(data))
+    }
+
+    /// [`Self::decode_yuva`] for shared data, which dav1d reads in place
+    pub fn decode_yuva_shared(&mut self, data: &Bytes) -> Result<YuvaImage> {
+        match self.decode_yuva_direct(data) {
+            Err(Error::AvifUnsupported(_)) => {
+                let rgba = self.decode_rgba_shared(data)?;
+                let sprite = YuvaImage::from_rgba(&rgba);
+                self.recycle(rgba);
+                Ok(sprite)
+            }
+            other => other,
+        }
+    }
+
+    fn decode_rgba_direct(&mut self, data: &Bytes) -> Result<RgbaImage> {
+        let items = avif_parser::parse_avif(data)?;
+
+        let color = self.decode_picture(obu_bytes(data, items.color))?;
+        let (width, height) = visible_size(&color, items.extents);
+        let mut buf = picture_to_rgba(&color, items.extents, items.nclx, &self.pool)?.into_raw();
+        drop(color);
+
+        if let Some(alpha_obus) = items.alpha {
+            let alpha = self.decode_picture(obu_bytes(data, alpha_obus))?;
+            apply_alpha(&alpha, width, height, &mut buf)?;
+        }
+
+        RgbaImage::from_raw(width, height, buf)
+            .ok_or_else(|| Error::AvifDecode("decoded buffer size mismatch".into()))
+    }
+
+    fn decode_yuva_direct(&mut self, data: &Bytes) -> Result<YuvaImage> {
+        let items = avif_parser::parse_avif(data)?;
+
+        let color = self.decode_picture(obu_bytes(data, items.color))?;
+        let (width, height) = visible_size(&color, items.extents);
+        let packed = picture_to_i420(&color, items.extents, items.nclx)?;
+        drop(color);
+
+        let alpha = match items.alpha {
+            Some(alpha_obus) => {
+                let alpha = self.decode_picture(obu_bytes(data, alpha_obus))?;
+                let mut plane = self.pool.take(width as usize * height as usize);
+                copy_alpha_plane(&alpha, width, height, &mut plane)?;
+                plane
+            }
+            None => Vec::new(),
+        };
+
+        Ok(YuvaImage::from_planes(width, height, packed, alpha))
+    }
+
+    /// Runs one still image through dav1d
+    fn decode_picture(&mut self, obus: Bytes) -> Result<dav1d::Picture> {
+        // Each asset is an independent key frame; drop any previous state
+        self.decoder.flush();
+
+        match self.decoder.send_data(obus, None, None, None) {
+            Ok(()) | Err(dav1d::Error::Again) => {}
+            Err(e) => return Err(Error::AvifDecode(format!("dav1d: {e:?}"))),
+        }
+
+        for _ in 0..MAX_DRAIN_ATTEMPTS {
+            match self.decoder.get_picture() {
+                Ok(picture) => return Ok(picture),
+                Err(dav1d::Error::Again) => match self.decoder.send_pending_data() {
+                    Ok(()) | Err(dav1d::Error::Again) => {}
+                    Err(e) => return Err(Error::AvifDecode(format!("dav1d: {e:?}"))),
+                },
+                Err(e) => return Err(Error::AvifDecode(format!("dav1d: {e:?}"))),
+            }
+        }
+
+        Err(Error::AvifDecode("dav1d produced no picture".into()))
+    }
+}
+
+/// An item's OBUs as owned input for dav1d: a view into `data` when they
+/// are stored in one piece, else the pieces the parser joined
+fn obu_bytes(data: &Bytes, obus: Cow<'_, [u8]>) -> Bytes {
+    match obus {
+        Cow::Borrowed(obus) => data.slice_ref(obus),
+        Cow::Owned(joined) => Bytes::from(joined),
+    }
+}
+
+/// Converts a decoded picture to opaque RGBA in a pooled buffer, cropped to
+/// `extents`
+pub(crate) fn picture_to_rgba(
+    picture: &dav1d::Picture,
+    extents: Option<(u32, u32)>,
+    nclx: Option<Nclx>,
+    pool: &BufferPool,
+) -> Result<RgbaImage> {
+    let (width, height) = visible_size(picture, extents);
+    let conv = converter(picture, nclx)?;
+
+    let mut buf = pool.take(width as usize * height as usize * 4);
+    with_planes(picture, |planes| yuv::yuv_to_rgba(planes, width, height, &conv, &mut buf));
+
+    RgbaImage::from_raw(width, height, buf)
+        .ok_or_else(|| Error::AvifDecode("decoded buffer size mismatch".into()))
+}
+
+/// Copies the visible part of an 8-bit 4:2:0 BT.601 limited-range picture
+/// into a packed I420 buffer.  Any other format needs colour conversion and
+/// yields `Error::AvifUnsupported`.
+pub(crate) fn picture_to_i420(
+    picture: &dav1d::Picture,
+    extents: Option<(u32, u32)>,
+    nclx: Option<Nclx>,
+) -> Result<Vec<u8>> {
+    let (width, height) = visible_size(picture, extents);
+
+    let full_range = nclx.map_or(picture.color_range() == YUVRange::Full, |n| n.full_range);
+    let matrix = matrix_of(picture, nclx);
+    if picture.bit_depth() != 8
+        || picture.pixel_layout() != PixelLayout::I420
+        || full_range
+        || matrix != Some(YuvMatrix::Bt601)
+    {
+        return Err(Error::AvifUnsupported("needs colour conversion".into()));
+    }
+
+    let (cw, ch) = yuv::chroma_dimensions(width, height);
+    let mut packed = Vec::with_capacity(yuv::i420_frame_size(width, height));
+    for (component, w, h) in [
+        (PlanarImageComponent::Y, width, height),
+        (PlanarImageComponent::U, cw, ch),
+        (PlanarImageComponent::V, cw, ch),
+    ] {
+        let plane = picture.plane(component);
+        let stride = picture.stride(component) as usize;
+        for row in plane.chunks(stride).take(h as usize) {
+            packed.extend_from_slice(&row[..w as usize]);
+        }
+    }
+    Ok(packed)
+}
+
+/// Picture size cropped to the `ispe` extents (the FFmpeg encoder pads odd
+/// sizes up to even ones)
+fn visible_size(picture: &dav1d::Picture, extents: Option<(u32, u32)>) -> (u32, u32) {
+    let (w, h) = (picture.width(), picture.height());
+    match extents {
+        Some((ew, eh)) if ew > 0 && eh > 0 => (w.min(ew), h.min(eh)),
+        _ => (w, h),
+    }
+}
+
+/// Container `nclx` wins over the AV1 sequence header, as in libavif
+fn matrix_of(picture: &dav1d::Picture, nclx: Option<Nclx>) -> Option<YuvMatrix> {
+    match nclx {
+        Some(n) => YuvMatrix::from_cicp(n.matrix_coefficients),
+        None => match picture.matrix_coefficients() {
+            MatrixCoefficients::Identity | MatrixCoefficients::YCgCo | MatrixCoefficients::ICtCp => None,
+            MatrixCoefficients::BT709 => Some(YuvMatrix::Bt709),
+            MatrixCoefficients::BT2020NonConstantLuminance
+            | MatrixCoefficients::BT2020ConstantLuminance => Some(YuvMatrix::Bt2020),
+            _ => Some(YuvMatrix::Bt601),
+        },
+    }
+}
+
+fn converter(picture: &dav1d::Picture, nclx: Option<Nclx>) -> Result<YuvToRgb> {
+    if picture.bit_depth() != 8 {
+        return Err(Error::AvifUnsupported(format!("{}-bit picture", picture.bit_depth())));
+    }
+    let matrix = matrix_of(picture, nclx)
+        .ok_or_else(|| Error::AvifUnsupported("non-YCbCr matrix".into()))?;
+    let full_range = nclx.map_or(picture.color_range() == YUVRange::Full, |n| n.full_range);
+    Ok(YuvToRgb::new(matrix, full_range))
+}
+
+/// Calls `f` with borrowed views of the picture's planes
+fn with_planes<T>(picture: &dav1d::Picture, f: impl FnOnce(&YuvPlanes) -> T) -> T {
+    let layout = picture.pixel_layout();
+    let (ss_x, ss_y) = match layout {
+        PixelLayout::I420 => (1, 1),
+        PixelLayout::I422 => (1, 0),
+        PixelLayout::I400 | PixelLayout::I444 => (0, 0),
+    };
+
+    let y = picture.plane(PlanarImageComponent::Y);
+    let chroma = (layout != PixelLayout::I400).then(|| {
+        (
+            picture.plane(PlanarImageComponent::U),
+            picture.plane(PlanarImageComponent::V),
+        )
+    });
+
+    f(&YuvPlanes {
+        y: &y,
+        y_stride: picture.stride(PlanarImageComponent::Y) as usize,
+        uv: chroma.as_ref().map(|(u, v)| (&u[..], &v[..])),
+        uv_stride: picture.stride(PlanarImageComponent::U) as usize,
+        ss_x,
+        ss_y,
+    })
+}
+
+/// Writes the luma of an alpha picture into a packed alpha plane
+fn copy_alpha_plane(alpha: &dav1d::Picture, width: u32, height: u32, out: &mut [u8]) -> Result<()> {
+    if alpha.bit_depth() != 8 || alpha.width() < width || alpha.height() < height {
+        return Err(Error::AvifUnsupported("alpha plane layout".into()));
+    }
+    let limited = alpha.color_range() == YUVRange::Limited;
+    let plane = alpha.plane(PlanarImageComponent::Y);
+    let stride = alpha.stride(PlanarImageComponent::Y) as usize;
+
+    for (row, out_row) in out.chunks_exact_mut(width as usize).take(height as usize).enumerate() {
+        let src = &plane[row * stride..][..width as usize];
+        if limited {
+            for (o, &a) in out_row.iter_mut().zip(src) {
+                *o = yuv::expand_limited(a);
+            }
+        } else {
+            out_row.copy_from_slice(src);
+        }
+    }
+    Ok(())
+}
+
+/// Writes an alpha picture into the A channel of a packed RGBA buffer
+fn apply_alpha(alpha: &dav1d::Picture, width: u32, height: u32, rgba: &mut [u8]) -> Result<()> {
+    if alpha.bit_depth() != 8 || alpha.width() < width || alpha.height() < height {
+        return Err(Error::AvifUnsupported("alpha plane layout".into()));
+    }
+    let limited = alpha.color_range() == YUVRange::Limited;
+    let plane = alpha.plane(PlanarImageComponent::Y);
+    let stride = alpha.stride(PlanarImageComponent::Y) as usize;
+
+    for (row, out_row) in rgba.chunks_exact_mut(width as usize * 4).take(height as usize).enumerate() {
+        let src = &plane[row * stride..][..width as usize];
+        for (px, &a) in out_row.chunks_exact_mut(4).zip(src) {
+            px[3] = if limited { yuv::expand_limited(a) } else { a };
+        }
+    }
+    Ok(())
+}
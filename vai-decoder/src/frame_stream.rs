@@ -0,0 +1,380 @@
+//! Asynchronous frame streams
+//!
+//! Async services cannot call [`FrameCompositor::render_frame`] on their
+//! executor threads, and wrapping every frame in `spawn_blocking` costs a
+//! hand-off per frame on a pool shared with unrelated work.  A
+//! [`RenderPool`] instead owns a fixed set of render threads, and
+//! [`RenderPool::stream`] turns a compositor and a frame range into a
+//! [`FrameStream`] (a `futures_core::Stream`, so it works with any runtime).
+//!
+//! Frames of one stream render in order on its own compositor, since they
+//! share its caches and track decoders.  The pool serves many streams at
+//! once: a stream renders one frame per turn and then goes to the back of
+//! the queue, so a long export cannot starve interactive streams.  Each
+//! stream renders at most [`StreamOptions::ahead`] frames before the
+//! consumer takes them (backpressure), and dropping it cancels whatever is
+//! still queued.
+
+use crate::yuv::I420Frame;
+use crate::{Error, FrameCompositor, Result};
+use futures_core::Stream;
+use image::RgbaImage;
+use std::collections::VecDeque;
+use std::ops::Range;
+use std::panic::{self, AssertUnwindSafe};
+use std::pin::Pin;
+use std::sync::{Arc, Condvar, Mutex};
+use std::task::{Context, Poll, Waker};
+use std::thread::{self, JoinHandle};
+
+/// Pixel layout of streamed frames
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum StreamFormat {
+    Rgba,
+    I420,
+}
+
+/// Per-stream settings
+#[derive(Debug, Clone, Copy)]
+pub struct StreamOptions {
+    /// Frames rendered ahead of the consumer before the stream pauses
+    pub ahead: usize,
+    pub format: StreamFormat,
+}
+
+impl Default for StreamOptions {
+    fn default() -> Self {
+        Self {
+            ahead: 4,
+            format: StreamFormat::Rgba,
+        }
+    }
+}
+
+/// Pixels of one streamed frame
+pub enum FramePixels {
+    Rgba(RgbaImage),
+    I420(I420Frame),
+}
+
+/// One frame yielded by a [`FrameStream`]
+pub struct StreamFrame {
+    /// Frame number within the file
+    pub index: u64,
+    pub timestamp_ms: u64,
+    pub pixels: FramePixels,
+}
+
+/// Fixed set of threads that render frames for any number of streams.
+/// Cloning shares the same threads; they exit once the last handle and
+/// every stream created from it are dropped.
+#[derive(Clone)]
+pub struct RenderPool {
+    handle: Arc<PoolHandle>,
+}
+
+/// Owns the worker threads; joins them on drop
+struct PoolHandle {
+    shared: Arc<PoolShared>,
+    workers: Vec<JoinHandle<()>>,
+}
+
+struct PoolShared {
+    queue: Mutex<PoolQueue>,
+    /// Signalled when a stream is queued and on shutdown
+    available: Condvar,
+}
+
+struct PoolQueue {
+    /// Streams waiting for their next turn
+    streams: VecDeque<Arc<StreamTask>>,
+    shutdown: bool,
+}
+
+impl RenderPool {
+    /// Starts a pool with `threads` render threads (0 = one per CPU)
+    pub fn new(threads: usize) -> Self {
+        let threads = match threads {
+            0 => thread::available_parallelism().map_or(1, |n| n.get()),
+            n => n,
+        };
+        let shared = Arc::new(PoolShared {
+            queue: Mutex::new(PoolQueue {
+                streams: VecDeque::new(),
+                shutdown: false,
+            }),
+            available: Condvar::new(),
+        });
+
+        let workers = (0..threads)
+            .map(|i| {
+                let shared = Arc::clone(&shared);
+                thread::Builder::new()
+                    .name(format!("vai-render-{i}"))
+                    .spawn(move || shared.work())
+                    .expect("failed to spawn VAI render thread")
+            })
+            .collect();
+
+        Self {
+            handle: Arc::new(PoolHandle { shared, workers }),
+        }
+    }
+
+    /// Streams `frames` of the file behind `compositor`, clamped to the
+    /// file's frame count
+    pub fn stream(&self, compositor: FrameCompositor, frames: Range<u64>, options: StreamOptions) -> FrameStream {
+        let total_frames = compositor.container().frame_count();
+
+        let task = Arc::new(StreamTask {
+            compositor: Mutex::new(compositor),
+            options: StreamOptions {
+                ahead: options.ahead.max(1),
+                ..options
+            },
+            state: Mutex::new(StreamState {
+                ready: VecDeque::new(),
+                next_frame: frames.start,
+                end_frame: frames.end.min(total_frames),
+                rendering: 0,
+                scheduled: false,
+                cancelled: false,
+                waker: None,
+            }),
+        });
+
+        FrameStream {
+            task,
+            pool: self.clone(),
+        }
+    }
+}
+
+impl Default for RenderPool {
+    fn default() -> Self {
+        Self::new(0)
+    }
+}
+
+impl Drop for PoolHandle {
+    fn drop(&mut self) {
+        self.shared.queue.lock().unwrap().shutdown = true;
+        self.shared.available.notify_all();
+        for worker in self.workers.drain(..) {
+            let _ = worker.join();
+        }
+    }
+}
+
+impl PoolShared {
+    /// Queues a stream for its next turn
+    fn submit(&self, task: Arc<StreamTask>) {
+        self.queue.lock().unwrap().streams.push_back(task);
+        self.available.notify_one();
+    }
+
+    /// Render thread body
+    fn work(&self) {
+        let mut queue = self.queue.lock().unwrap();
+        loop {
+            if queue.shutdown {
+                return;
+            }
+            let Some(task) = queue.streams.pop_front() else {
+                queue = self.available.wait(queue).unwrap();
+                continue;
+            };
+            drop(queue);
+
+            if task.render_next() {
+                self.submit(task);
+            }
+            queue = self.queue.lock().unwrap();
+        }
+    }
+}
+
+/// A stream's compositor and delivery state, shared with the pool
+struct StreamTask {
+    compositor: Mutex<FrameCompositor>,
+    options: StreamOptions,
+    state: Mutex<StreamState>,
+}
+
+struct StreamState {
+    /// Rendered frames not yet taken by the consumer
+    ready: VecDeque<Result<StreamFrame>>,
+    /// Next frame to render
+    next_frame: u64,
+    end_frame: u64,
+    /// Frames taken from `next_frame` but not in `ready` yet
+    rendering: usize,
+    /// Queued on the pool or rendering right now
+    scheduled: bool,
+    cancelled: bool,
+    /// Consumer waiting for `ready` to fill
+    waker: Option<Waker>,
+}
+
+impl StreamState {
+    /// Whether the stream should get another turn on the pool
+    fn wants_turn(&self, ahead: usize) -> bool {
+        !self.cancelled && self.next_frame < self.end_frame && self.ready.len() < ahead
+    }
+}
+
+impl StreamTask {
+    /// Renders the next frame.  Returns whether the stream wants another
+    /// turn right away.
+    fn render_next(&self) -> bool {
+        let index = {
+            let mut state = self.state.lock().unwrap();
+            if !state.wants_turn(self.options.ahead) {
+                state.scheduled = false;
+                return false;
+            }
+            state.next_frame += 1;
+            state.rendering += 1;
+            state.next_frame - 1
+        };
+
+        let mut compositor = self.compositor.lock().unwrap_or_else(|e| e.into_inner());
+        let timestamp_ms = compositor.container().frame_timestamp_ms(index);
+
+        // A panic must not take down a render thread shared by other streams
+        let rendered = panic::catch_unwind(AssertUnwindSafe(|| {
+            match self.options.format {
+                StreamFormat::Rgba => compositor.render_frame(timestamp_ms).map(FramePixels::Rgba),
+                StreamFormat::I420 => compositor.render_frame_i420(timestamp_ms).map(FramePixels::I420),
+            }
+        }))
+        .unwrap_or(Err(Error::RenderPanicked(timestamp_ms)));
+        drop(compositor);
+        let frame = rendered.map(|pixels| StreamFrame {
+            index,
+            timestamp_ms,
+            pixels,
+        });
+
+        let mut state = self.state.lock().unwrap();
+        state.rendering -= 1;
+        state.ready.push_back(frame);
+        if let Some(waker) = state.waker.take() {
+            waker.wake();
+        }
+        state.scheduled = state.wants_turn(self.options.ahead);
+        state.scheduled
+    }
+}
+
+/// Frames of a range, rendered on a [`RenderPool`].  A frame that fails to
+/// render yields an error and the stream carries on with the next one.
+pub struct FrameStream {
+    task: Arc<StreamTask>,
+    pool: RenderPool,
+}
+
+impl FrameStream {
+    /// Puts the stream back on the pool if it has room to render ahead
+    fn schedule(&self, state: &mut StreamState) -> bool {
+        let resume = !state.scheduled && state.wants_turn(self.task.options.ahead);
+        state.scheduled |= resume;
+        resume
+    }
+}
+
+impl Stream for FrameStream {
+    type Item = Result<StreamFrame>;
+
+    fn poll_next(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
+        let mut state = self.task.state.lock().unwrap();
+        let poll = match state.ready.pop_front() {
+            Some(frame) => Poll::Ready(Some(frame)),
+            None if state.next_frame >= state.end_frame && !state.scheduled => Poll::Ready(None),
+            None => {
+                state.waker = Some(cx.waker().clone());
+                Poll::Pending
+            }
+        };
+
+        let resume = self.schedule(&mut state);
+        drop(state);
+        if resume {
+            self.pool.handle.shared.submit(Arc::clone(&self.task));
+        }
+        poll
+    }
+
+    fn size_hint(&self) -> (usize, Option<usize>) {
+        let state = self.task.state.lock().unwrap();
+        let remaining =
+            state.ready.len() + state.rendering + state.end_frame.saturating_sub(state.next_frame) as usize;
+        (remaining, Some(remaining))
+    }
+}
+
+impl Drop for FrameStream {
+    fn drop(&mut self) {
+        // A queued turn sees this and returns without rendering
+        self.task.state.lock().unwrap().cancelled = true;
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use futures::executor::block_on;
+    use futures::StreamExt;
+    use vai_core::{VaiContainer, VaiHeader};
+
+    fn blank_compositor() -> FrameCompositor {
+        let header = VaiHeader::new(8, 6, 30, 1, 1000, 0, 0);
+        FrameCompositor::new(VaiContainer::new(header, Vec::new(), Vec::new()))
+    }
+
+    #[test]
+    fn test_streams_render_in_order_and_stop_at_file_end() {
+        let pool = RenderPool::new(2);
+        let options = StreamOptions {
+            ahead: 2,
+            format: StreamFormat::I420,
+        };
+        let streams = [
+            pool.stream(blank_compositor(), 0..10, options),
+            pool.stream(blank_compositor(), 25..100, options),
+        ];
+
+        let indices = block_on(futures::future::join_all(streams.into_iter().map(|stream| {
+            stream
+                .map(|frame| {
+                    let frame = frame.unwrap();
+                    assert!(matches!(frame.pixels, FramePixels::I420(ref f) if f.width() == 8));
+                    frame.index
+                })
+                .collect::<Vec<_>>()
+        })));
+
+        assert_eq!(indices[0], (0..10).collect::<Vec<_>>());
+        assert_eq!(indices[1], (25..30).collect::<Vec<_>>());
+    }
+
+    #[test]
+    fn test_size_hint_counts_frames_in_flight() {
+        let pool = RenderPool::new(1);
+        let mut stream = pool.stream(blank_compositor(), 0..5, StreamOptions::default());
+        assert_eq!(stream.size_hint(), (5, Some(5)));
+
+        // Hold the compositor so the first frame stays mid-render
+        let task = Arc::clone(&stream.task);
+        let compositor = task.compositor.lock().unwrap();
+        let mut cx = Context::from_waker(futures::task::noop_waker_ref());
+        assert!(Pin::new(&mut stream).poll_next(&mut cx).is_pending());
+        while task.state.lock().unwrap().rendering == 0 {
+            thread::yield_now();
+        }
+        assert_eq!(stream.size_hint(), (5, Some(5)));
+        drop(compositor);
+
+        assert_eq!(block_on(stream.count()), 5);
+    }
+}
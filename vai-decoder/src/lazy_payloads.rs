@@ -0,0 +1,108 @@
+//! On-demand asset payloads
+//!
+//! Opening a container normally reads every payload into memory.  For
+//! players that only need a few seconds at a time, `LazyPayloads` keeps the
+//! file open and reads a payload only when the compositor first decodes its
+//! asset, so startup cost and memory no longer scale with file size.
+
+use crate::{Error, Result};
+use std::collections::HashMap;
+use std::io::{self, Read, Seek, SeekFrom};
+use vai_core::{PayloadLocation, VaiContainer};
+
+/// A seekable byte source that payloads are fetched from
+pub trait PayloadReader: Read + Seek + Send {}
+
+impl<T: Read + Seek + Send> PayloadReader for T {}
+
+/// Payload locations of a lazily opened container plus the reader to fetch
+/// them from
+pub struct LazyPayloads {
+    reader: Box<dyn PayloadReader>,
+    locations: HashMap<u32, PayloadLocation>,
+    /// Stream length, if the reader can seek to its end
+    stream_len: Option<u64>,
+}
+
+/// Payload bytes reserved up front when the stream length is unknown; past
+/// this the buffer grows only as data actually arrives
+const UNBOUNDED_PREALLOC: usize = 1 << 20;
+
+impl LazyPayloads {
+    /// Reads the container index from `reader` and keeps the reader for
+    /// later payload fetches.  The container's assets have empty data.
+    pub fn open<R: PayloadReader + 'static>(mut reader: R) -> Result<(VaiContainer, Self)> {
+        let (container, locations) = VaiContainer::read_index(&mut reader)?;
+        let locations = container
+            .assets
+            .iter()
+            .map(|asset| asset.id)
+            .zip(locations)
+            .collect();
+        // Callback readers cannot seek from the end; their fetches are
+        // bounded by the bytes they actually deliver instead
+        let stream_len = reader.seek(SeekFrom::End(0)).ok();
+
+        let payloads = Self {
+            reader: Box::new(reader),
+            locations,
+            stream_len,
+        };
+        Ok((container, payloads))
+    }
+
+    /// Reads the payload of `asset_id`, checking that it lies within the
+    /// stream before allocating for it
+    pub fn fetch(&mut self, asset_id: u32) -> Result<Vec<u8>> {
+        let location = *self
+            .locations
+            .get(&asset_id)
+            .ok_or(Error::AssetNotFound(asset_id))?;
+        let len = location.len as usize;
+        if self
+            .stream_len
+            .is_some_and(|stream_len| location.offset + location.len as u64 > stream_len)
+        {
+            return Err(io::Error::from(io::ErrorKind::UnexpectedEof).into());
+        }
+
+        let capacity = if self.stream_len.is_some() { len } else { len.min(UNBOUNDED_PREALLOC) };
+        let mut data = Vec::with_capacity(capacity);
+        self.reader.seek(SeekFrom::Start(location.offset))?;
+        (&mut self.reader).take(location.len as u64).read_to_end(&mut data)?;
+        if data.len() != len {
+            return Err(io::Error::from(io::ErrorKind::UnexpectedEof).into());
+        }
+        Ok(data)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::io::Cursor;
+
+    #[test]
+    fn test_fetch_rejects_payloads_past_the_end() {
+        let bytes: Vec<u8> = (0..64).collect();
+        let locations = [
+            (0, PayloadLocation { offset: 8, len: 16 }),
+            (1, PayloadLocation { offset: 60, len: 8 }),
+            (2, PayloadLocation { offset: 8, len: u32::MAX }),
+        ];
+        let mut payloads = LazyPayloads {
+            reader: Box::new(Cursor::new(bytes.clone())),
+            locations: locations.into_iter().collect(),
+            stream_len: Some(bytes.len() as u64),
+        };
+        assert_eq!(payloads.fetch(0).unwrap(), bytes[8..24]);
+        assert!(payloads.fetch(1).is_err());
+        assert!(payloads.fetch(2).is_err());
+        assert!(matches!(payloads.fetch(3), Err(Error::AssetNotFound(3))));
+
+        // Without a known length the short read is still caught
+        payloads.stream_len = None;
+        assert_eq!(payloads.fetch(0).unwrap(), bytes[8..24]);
+        assert!(payloads.fetch(2).is_err());
+    }
+}
@@ -3,9 +3,27 @@
 //! This library provides functionality to decode VAI video files back into frames.
 
 pub mod avif_decoder;
+pub mod avif_parser;
+pub mod buffer_pool;
+pub mod dav1d_decoder;
 pub mod frame_compositor;
+#[cfg(feature = "async")]
+pub mod frame_stream;
+pub mod lazy_payloads;
+pub mod sprite_decoder;
+pub mod tier_controller;
+pub mod track_decoder;
+pub mod yuv;
 
-pub use frame_compositor::FrameCompositor;
+pub use buffer_pool::BufferPool;
+pub use bytes::Bytes;
+pub use dav1d_decoder::{AvifDecoder, DecoderConfig};
+pub use frame_compositor::{CacheStats, FrameCompositor};
+#[cfg(feature = "async")]
+pub use frame_stream::{FrameStream, RenderPool, StreamOptions};
+pub use lazy_payloads::{LazyPayloads, PayloadReader};
+pub use tier_controller::TierController;
+pub use track_decoder::TrackDecoder;
 
 /// Result type for vai-decoder operations
 pub type Result<T> = std::result::Result<T, Error>;
@@ -25,9 +43,24 @@ pub enum Error {
     #[error("AVIF decode error: {0}")]
     AvifDecode(String),
 
+    #[error("AVIF feature not supported by the direct decoder: {0}")]
+    AvifUnsupported(String),
+
+    #[error("Sprite decode error: {0}")]
+    SpriteDecode(String),
+
     #[error("Asset not found: {0}")]
     AssetNotFound(u32),
 
+    #[error("Track frame out of range: {0}")]
+    TrackFrameOutOfRange(u32),
+
+    #[error("Asset slice lies outside its atlas")]
+    SliceOutOfBounds,
+
     #[error("Invalid timestamp: {0}")]
     InvalidTimestamp(u64),
+
+    #[error("Rendering panicked at {0} ms")]
+    RenderPanicked(u64),
 }
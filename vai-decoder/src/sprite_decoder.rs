@@ -0,0 +1,104 @@
+//! Decoding for the fast sprite codecs (raw, zstd, LZ4, QOI)
+
+use crate::buffer_pool::BufferPool;
+use crate::{Error, Result};
+use image::RgbaImage;
+use vai_core::{Asset, AssetCodec};
+
+/// Decodes a non-AVIF asset into an RGBA image.
+///
+/// Raw, zstd and LZ4 payloads decode straight into a pooled buffer.
+pub fn decode_sprite(asset: &Asset, pool: &BufferPool) -> Result<RgbaImage> {
+    let len = asset.width as usize * asset.height as usize * 4;
+    let corrupt = |what: &str| Error::SpriteDecode(format!("asset {}: {what}", asset.id));
+
+    let pixels = match asset.codec {
+        AssetCodec::Avif | AssetCodec::Av1Track => {
+            return Err(corrupt("AV1 assets go through the AV1 decoders"))
+        }
+        AssetCodec::Raw => {
+            if asset.data.len() != len {
+                return Err(corrupt("raw size mismatch"));
+            }
+            let mut buf = pool.take(len);
+            buf.copy_from_slice(&asset.data);
+            buf
+        }
+        AssetCodec::Zstd => {
+            let mut buf = pool.take(len);
+            let written = zstd::bulk::decompress_to_buffer(&asset.data, &mut buf[..])
+                .map_err(|e| corrupt(&format!("zstd: {e}")))?;
+            if written != len {
+                return Err(corrupt("zstd size mismatch"));
+            }
+            buf
+        }
+        AssetCodec::Lz4 => {
+            // Checked before allocating, so a bad prefix cannot size the buffer
+            let (prefix, block) = asset
+                .data
+                .split_first_chunk::<4>()
+                .ok_or_else(|| corrupt("lz4 size prefix missing"))?;
+            if u32::from_le_bytes(*prefix) as usize != len {
+                return Err(corrupt("lz4 size mismatch"));
+            }
+            let mut buf = pool.take(len);
+            let written = lz4_flex::decompress_into(block, &mut buf[..])
+                .map_err(|e| corrupt(&format!("lz4: {e}")))?;
+            if written != len {
+                return Err(corrupt("lz4 size mismatch"));
+            }
+            buf
+        }
+        AssetCodec::Qoi => {
+            let (header, pixels) =
+                qoi::decode_to_vec(&asset.data).map_err(|e| corrupt(&format!("qoi: {e}")))?;
+            if !header.channels.is_rgba() {
+                return Err(corrupt("qoi image is not RGBA"));
+            }
+            pixels
+        }
+    };
+
+    RgbaImage::from_raw(asset.width, asset.height, pixels).ok_or_else(|| corrupt("size mismatch"))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_raw_and_zstd_roundtrip() {
+        let pixels: Vec<u8> = (0..3 * 2 * 4).map(|i| i as u8).collect();
+        let pool = BufferPool::default();
+
+        let raw = Asset::with_codec(1, 3, 2, AssetCodec::Raw, pixels.clone());
+        assert_eq!(decode_sprite(&raw, &pool).unwrap().into_raw(), pixels);
+
+        let packed = zstd::bulk::compress(&pixels, 3).unwrap();
+        let zstd = Asset::with_codec(2, 3, 2, AssetCodec::Zstd, packed);
+        assert_eq!(decode_sprite(&zstd, &pool).unwrap().into_raw(), pixels);
+
+        let short = Asset::with_codec(3, 3, 2, AssetCodec::Raw, vec![0; 4]);
+        assert!(decode_sprite(&short, &pool).is_err());
+    }
+
+    #[test]
+    fn test_lz4_size_prefix_must_match() {
+        let pixels: Vec<u8> = (0..3 * 2 * 4).map(|i| i as u8).collect();
+        let pool = BufferPool::default();
+
+        let packed = lz4_flex::compress_prepend_size(&pixels);
+        let lz4 = Asset::with_codec(1, 3, 2, AssetCodec::Lz4, packed.clone());
+        assert_eq!(decode_sprite(&lz4, &pool).unwrap().into_raw(), pixels);
+
+        // A prefix claiming 4 GiB is rejected without being allocated
+        let mut huge = packed.clone();
+        huge[..4].copy_from_slice(&u32::MAX.to_le_bytes());
+        let huge = Asset::with_codec(2, 3, 2, AssetCodec::Lz4, huge);
+        assert!(decode_sprite(&huge, &pool).is_err());
+
+        let truncated = Asset::with_codec(3, 3, 2, AssetCodec::Lz4, packed[..2].to_vec());
+        assert!(decode_sprite(&truncated, &pool).is_err());
+    }
+}
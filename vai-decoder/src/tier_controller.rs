@@ -0,0 +1,138 @@
+//! Adaptive quality tier selection
+//!
+//! Files encoded with reduced tiers carry half-resolution copies of their
+//! large assets.  `TierController` watches how long each frame takes to
+//! render against the frame duration and steps down to a cheaper tier when
+//! the player falls behind, then back up once there is headroom again.
+//! Both directions need a run of frames: one slow frame, like the first
+//! after a seek that pays for a cold background decode, changes nothing.
+
+use std::time::Duration;
+
+/// Step down when the average render time exceeds this share of the budget
+const DEGRADE_RATIO: f64 = 0.8;
+
+/// Step back up when the average stays below this share of the budget
+const RECOVER_RATIO: f64 = 0.4;
+
+/// Consecutive slow frames required before stepping down; a frame counts
+/// when both it and the average are over the degrade threshold
+const DEGRADE_FRAMES: u32 = 3;
+
+/// Consecutive fast frames required before stepping back up
+const RECOVER_FRAMES: u32 = 30;
+
+/// Weight of the newest sample in the moving average
+const SMOOTHING: f64 = 0.2;
+
+/// Picks the asset tier to decode from recent render times
+#[derive(Debug, Clone)]
+pub struct TierController {
+    budget: f64,
+    max_tier: u8,
+    tier: u8,
+    average: Option<f64>,
+    slow_frames: u32,
+    fast_frames: u32,
+}
+
+impl TierController {
+    /// Creates a controller for frames due every `frame_duration`, able to go
+    /// down to `max_tier`
+    pub fn new(frame_duration: Duration, max_tier: u8) -> Self {
+        Self {
+            budget: frame_duration.as_secs_f64(),
+            max_tier,
+            tier: 0,
+            average: None,
+            slow_frames: 0,
+            fast_frames: 0,
+        }
+    }
+
+    /// Tier to decode newly needed assets at (0 = full quality)
+    pub fn tier(&self) -> u8 {
+        self.tier
+    }
+
+    /// Records how long the last frame took to render
+    pub fn record(&mut self, render_time: Duration) {
+        let sample = render_time.as_secs_f64();
+        let average = match self.average {
+            Some(avg) => avg + SMOOTHING * (sample - avg),
+            None => sample,
+        };
+        self.average = Some(average);
+
+        let degrade_at = self.budget * DEGRADE_RATIO;
+        if average > degrade_at {
+            self.fast_frames = 0;
+            self.slow_frames = if sample > degrade_at { self.slow_frames + 1 } else { 0 };
+            if self.slow_frames >= DEGRADE_FRAMES && self.tier < self.max_tier {
+                self.tier += 1;
+                // Judge the new tier on its own timings
+                self.slow_frames = 0;
+                self.average = None;
+            }
+        } else if average < self.budget * RECOVER_RATIO && self.tier > 0 {
+            self.slow_frames = 0;
+            self.fast_frames += 1;
+            if self.fast_frames >= RECOVER_FRAMES {
+                self.tier -= 1;
+                self.fast_frames = 0;
+                self.average = None;
+            }
+        } else {
+            self.slow_frames = 0;
+            self.fast_frames = 0;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_degrades_and_recovers() {
+        let mut controller = TierController::new(Duration::from_millis(40), 1);
+
+        for _ in 1..DEGRADE_FRAMES {
+            controller.record(Duration::from_millis(60));
+        }
+        assert_eq!(controller.tier(), 0, "needs a run of slow frames");
+        controller.record(Duration::from_millis(60));
+        assert_eq!(controller.tier(), 1);
+        for _ in 0..DEGRADE_FRAMES {
+            controller.record(Duration::from_millis(60));
+        }
+        assert_eq!(controller.tier(), 1, "clamped to the deepest tier in the file");
+
+        // The average has to decay below the recovery threshold first
+        for _ in 0..2 * RECOVER_FRAMES {
+            controller.record(Duration::from_millis(5));
+        }
+        assert_eq!(controller.tier(), 0);
+    }
+
+    #[test]
+    fn test_one_slow_first_frame_does_not_degrade() {
+        let mut controller = TierController::new(Duration::from_millis(40), 2);
+
+        // A cold background decode on the first frame, then steady playback
+        controller.record(Duration::from_millis(400));
+        for _ in 0..2 * RECOVER_FRAMES {
+            controller.record(Duration::from_millis(10));
+            assert_eq!(controller.tier(), 0);
+        }
+
+        // Likewise after a step down: one slow frame does not go deeper
+        for _ in 0..DEGRADE_FRAMES {
+            controller.record(Duration::from_millis(200));
+        }
+        assert_eq!(controller.tier(), 1);
+        controller.record(Duration::from_millis(400));
+        controller.record(Duration::from_millis(10));
+        assert_eq!(controller.tier(), 1);
+    }
+}
@@ -0,0 +1,151 @@
+//! Sequential decoding of AV1 track assets
+//!
+//! Track frames predict from earlier frames, so unlike stills they cannot be
+//! decoded in isolation.  `TrackDecoder` keeps one dav1d instance per track
+//! warm: moving forward to the next frame only feeds the new temporal units,
+//! and only seeking backwards restarts from the key frame.
+
+use crate::dav1d_decoder::{self, DecoderConfig};
+use crate::yuv::YuvaImage;
+use crate::{BufferPool, Error, Result};
+use bytes::Bytes;
+use image::RgbaImage;
+use vai_core::track::TrackIndex;
+use vai_core::Asset;
+
+/// Upper bound on `get_picture` retries without progress
+const MAX_DRAIN_ATTEMPTS: usize = 64;
+
+/// Decoder state for one track asset
+pub struct TrackDecoder {
+    decoder: dav1d::Decoder,
+    index: TrackIndex,
+    extents: (u32, u32),
+    /// Next temporal unit to send
+    next_unit: u32,
+    /// Index of the next picture dav1d will output
+    next_frame: u32,
+    /// dav1d is still holding a temporal unit it could not accept yet
+    pending: bool,
+}
+
+impl TrackDecoder {
+    /// Creates a decoder for a track asset.  `payload` is the track's data,
+    /// which lazily opened files keep outside `asset`.
+    pub fn new(asset: &Asset, payload: &[u8], config: &DecoderConfig) -> Result<Self> {
+        let index = TrackIndex::parse(payload)?;
+
+        let mut settings = dav1d::Settings::new();
+        settings.set_n_threads(config.threads);
+        settings.set_max_frame_delay(config.max_frame_delay);
+        let decoder = dav1d::Decoder::with_settings(&settings)
+            .map_err(|e| Error::AvifDecode(format!("dav1d init failed: {e:?}")))?;
+
+        Ok(Self {
+            decoder,
+            index,
+            extents: (asset.width, asset.height),
+            next_unit: 0,
+            next_frame: 0,
+            pending: false,
+        })
+    }
+
+    /// Number of frames in the track
+    pub fn frame_count(&self) -> u32 {
+        self.index.frame_count()
+    }
+
+    /// Decodes `frame` to RGBA.  `payload` is the track asset's data; dav1d
+    /// is handed views of its temporal units rather than copies.
+    pub fn decode_rgba(&mut self, payload: &Bytes, frame: u32, pool: &BufferPool) -> Result<RgbaImage> {
+        let picture = self.picture(payload, frame)?;
+        dav1d_decoder::picture_to_rgba(&picture, Some(self.extents), None, pool)
+    }
+
+    /// Decodes `frame` to planar YUVA for the I420 compositing target
+    pub fn decode_yuva(&mut self, payload: &Bytes, frame: u32, pool: &BufferPool) -> Result<YuvaImage> {
+        let picture = self.picture(payload, frame)?;
+        let (width, height) = self.extents;
+        match dav1d_decoder::picture_to_i420(&picture, Some(self.extents), None) {
+            // Track frames are opaque crops of the source video
+            Ok(planes) => Ok(YuvaImage::from_planes(width, height, planes, Vec::new())),
+            Err(Error::AvifUnsupported(_)) => {
+                let rgba = dav1d_decoder::picture_to_rgba(&picture, Some(self.extents), None, pool)?;
+                let sprite = YuvaImage::from_rgba(&rgba);
+                pool.give(rgba.into_raw());
+                Ok(sprite)
+            }
+            Err(e) => Err(e),
+        }
+    }
+
+    /// Advances the decoder to `frame` and returns its picture
+    fn picture(&mut self, payload: &Bytes, frame: u32) -> Result<dav1d::Picture> {
+        if frame >= self.frame_count() {
+            return Err(Error::TrackFrameOutOfRange(frame));
+        }
+
+        // Going backwards means starting over from the key frame
+        if frame < self.next_frame {
+            self.decoder.flush();
+            self.next_unit = 0;
+            self.next_frame = 0;
+            self.pending = false;
+        }
+
+        let mut stalls = 0;
+        loop {
+            // Take out whatever dav1d has ready before feeding more data
+            match self.decoder.get_picture() {
+                Ok(picture) => {
+                    stalls = 0;
+                    let decoded = self.next_frame;
+                    self.next_frame += 1;
+                    if decoded == frame {
+                        return Ok(picture);
+                    }
+                    continue;
+                }
+                Err(dav1d::Error::Again) => {}
+                Err(e) => return Err(dav1d_error(e)),
+            }
+
+            if self.pending {
+                match self.decoder.send_pending_data() {
+                    Ok(()) => {
+                        self.pending = false;
+                        continue;
+                    }
+                    Err(dav1d::Error::Again) => {}
+                    Err(e) => return Err(dav1d_error(e)),
+                }
+            } else if self.next_unit < self.frame_count() {
+                let unit = self
+                    .index
+                    .temporal_unit(payload, self.next_unit)
+                    .ok_or(Error::TrackFrameOutOfRange(self.next_unit))?;
+                self.next_unit += 1;
+
+                match self.decoder.send_data(payload.slice_ref(unit), None, None, None) {
+                    Ok(()) => {}
+                    // dav1d keeps the data until pictures have been taken out
+                    Err(dav1d::Error::Again) => self.pending = true,
+                    Err(e) => return Err(dav1d_error(e)),
+                }
+                stalls = 0;
+                continue;
+            }
+
+            // All data is in; wait for the delayed pictures
+            stalls += 1;
+            if stalls > MAX_DRAIN_ATTEMPTS {
+                return Err(Error::AvifDecode("dav1d produced too few track frames".into()));
+            }
+        }
+    }
+}
+
+fn dav1d_error(e: dav1d::Error) -> Error {
+    Error::AvifDecode(format!("dav1d: {e:?}"))
+}
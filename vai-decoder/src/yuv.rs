@@ -0,0 +1,580 @@
+//! Planar YUV 4:2:0 (I420) frames and RGBA ↔ YUV conversion
+//!
+//! Output frames use BT.601 limited-range coefficients in 8.8 fixed point,
+//! which is what FFmpeg and VLC assume for untagged 4:2:0 input.  Chroma is
+//! the average of each 2×2 block; odd widths/heights round the chroma planes
+//! up.  Decoded AV1 pictures may use other matrices and ranges, handled by
+//! [`YuvToRgb`].
+
+use crate::BufferPool;
+use image::RgbaImage;
+
+/// A planar YUV 4:2:0 frame stored as one tightly packed buffer
+/// (Y plane, then U, then V), the layout VLC and FFmpeg call I420.
+#[derive(Debug, Clone)]
+pub struct I420Frame {
+    width: u32,
+    height: u32,
+    data: Vec<u8>,
+}
+
+impl I420Frame {
+    /// Creates a black frame
+    pub fn new(width: u32, height: u32) -> Self {
+        let mut frame = Self {
+            width,
+            height,
+            data: vec![0; i420_frame_size(width, height)],
+        };
+        frame.fill_black();
+        frame
+    }
+
+    /// Wraps an existing I420 buffer; returns None if it is too small
+    pub fn from_raw(width: u32, height: u32, data: Vec<u8>) -> Option<Self> {
+        if data.len() < i420_frame_size(width, height) {
+            return None;
+        }
+        Some(Self { width, height, data })
+    }
+
+    /// Frame width in pixels
+    pub fn width(&self) -> u32 {
+        self.width
+    }
+
+    /// Frame height in pixels
+    pub fn height(&self) -> u32 {
+        self.height
+    }
+
+    /// The packed Y/U/V bytes
+    pub fn as_raw(&self) -> &[u8] {
+        &self.data
+    }
+
+    /// Consumes the frame, returning the packed Y/U/V bytes
+    pub fn into_raw(self) -> Vec<u8> {
+        self.data
+    }
+
+    /// Resets the frame to opaque black (Y=16, U=V=128)
+    pub fn fill_black(&mut self) {
+        let luma_len = self.width as usize * self.height as usize;
+        self.data[..luma_len].fill(16);
+        self.data[luma_len..].fill(128);
+    }
+
+    /// Returns (Y, U, V) planes
+    pub fn planes(&self) -> (&[u8], &[u8], &[u8]) {
+        split_planes(&self.data, self.width, self.height)
+    }
+
+    /// Returns mutable (Y, U, V) planes
+    pub fn planes_mut(&mut self) -> (&mut [u8], &mut [u8], &mut [u8]) {
+        let luma_len = self.width as usize * self.height as usize;
+        let (cw, ch) = chroma_dimensions(self.width, self.height);
+        let chroma_len = cw as usize * ch as usize;
+        let (y, rest) = self.data.split_at_mut(luma_len);
+        let (u, rest) = rest.split_at_mut(chroma_len);
+        (y, u, &mut rest[..chroma_len])
+    }
+}
+
+/// Storage an I420 frame can be composed into: an owned [`I420Frame`], or
+/// planes borrowed from the caller ([`I420Planes`]) so nothing is copied out
+pub trait I420Target {
+    fn width(&self) -> u32;
+    fn height(&self) -> u32;
+    /// Mutable (Y, U, V) planes, each tightly packed
+    fn planes_mut(&mut self) -> (&mut [u8], &mut [u8], &mut [u8]);
+
+    /// Resets the frame to opaque black (Y=16, U=V=128)
+    fn fill_black(&mut self) {
+        let (y, u, v) = self.planes_mut();
+        y.fill(16);
+        u.fill(128);
+        v.fill(128);
+    }
+}
+
+impl I420Target for I420Frame {
+    fn width(&self) -> u32 {
+        self.width
+    }
+
+    fn height(&self) -> u32 {
+        self.height
+    }
+
+    fn planes_mut(&mut self) -> (&mut [u8], &mut [u8], &mut [u8]) {
+        I420Frame::planes_mut(self)
+    }
+
+    fn fill_black(&mut self) {
+        I420Frame::fill_black(self)
+    }
+}
+
+/// Three separately allocated, tightly packed I420 planes owned by someone
+/// else, e.g. a C caller's buffers
+pub struct I420Planes<'a> {
+    width: u32,
+    height: u32,
+    y: &'a mut [u8],
+    u: &'a mut [u8],
+    v: &'a mut [u8],
+}
+
+impl<'a> I420Planes<'a> {
+    /// Wraps the planes, trimmed to size; returns None if any is too small
+    pub fn new(width: u32, height: u32, y: &'a mut [u8], u: &'a mut [u8], v: &'a mut [u8]) -> Option<Self> {
+        let luma_len = width as usize * height as usize;
+        let (cw, ch) = chroma_dimensions(width, height);
+        let chroma_len = cw as usize * ch as usize;
+        if y.len() < luma_len || u.len() < chroma_len || v.len() < chroma_len {
+            return None;
+        }
+        Some(Self {
+            width,
+            height,
+            y: &mut y[..luma_len],
+            u: &mut u[..chroma_len],
+            v: &mut v[..chroma_len],
+        })
+    }
+}
+
+impl I420Target for I420Planes<'_> {
+    fn width(&self) -> u32 {
+        self.width
+    }
+
+    fn height(&self) -> u32 {
+        self.height
+    }
+
+    fn planes_mut(&mut self) -> (&mut [u8], &mut [u8], &mut [u8]) {
+        (&mut *self.y, &mut *self.u, &mut *self.v)
+    }
+}
+
+/// A decoded asset in planar YUV 4:2:0 plus alpha, ready for planar blending.
+///
+/// Alpha is kept at luma resolution and pre-averaged to chroma resolution so
+/// blending never touches RGBA.  Fully opaque sprites store no alpha at all
+/// and are composited with plain row copies.
+#[derive(Debug, Clone)]
+pub struct YuvaImage {
+    width: u32,
+    height: u32,
+    data: Vec<u8>,
+    alpha: Vec<u8>,
+    chroma_alpha: Vec<u8>,
+}
+
+impl YuvaImage {
+    /// Converts an RGBA image into planar YUVA
+    pub fn from_rgba(src: &RgbaImage) -> Self {
+        let mut data = Vec::new();
+        rgba_to_i420(src, &mut data);
+
+        let raw = src.as_raw();
+        let opaque = raw.chunks_exact(4).all(|px| px[3] == 255);
+        let (alpha, chroma_alpha) = if opaque {
+            (Vec::new(), Vec::new())
+        } else {
+            let alpha: Vec<u8> = raw.chunks_exact(4).map(|px| px[3]).collect();
+            let chroma_alpha = subsample_plane(&alpha, src.width(), src.height());
+            (alpha, chroma_alpha)
+        };
+
+        Self {
+            width: src.width(),
+            height: src.height(),
+            data,
+            alpha,
+            chroma_alpha,
+        }
+    }
+
+    /// Builds a sprite from already-converted planes.
+    ///
+    /// `data` is packed I420 (BT.601 limited range) and `alpha` is a
+    /// luma-resolution plane, or empty for an opaque sprite.
+    pub fn from_planes(width: u32, height: u32, data: Vec<u8>, alpha: Vec<u8>) -> Self {
+        let opaque = alpha.iter().all(|&a| a == 255);
+        let (alpha, chroma_alpha) = if opaque {
+            (Vec::new(), Vec::new())
+        } else {
+            let chroma_alpha = subsample_plane(&alpha, width, height);
+            (alpha, chroma_alpha)
+        };
+
+        Self {
+            width,
+            height,
+            data,
+            alpha,
+            chroma_alpha,
+        }
+    }
+
+    /// Width in pixels
+    pub fn width(&self) -> u32 {
+        self.width
+    }
+
+    /// Height in pixels
+    pub fn height(&self) -> u32 {
+        self.height
+    }
+
+    /// True when every pixel is fully opaque
+    pub fn is_opaque(&self) -> bool {
+        self.alpha.is_empty()
+    }
+
+    /// Returns (Y, U, V) planes
+    pub fn planes(&self) -> (&[u8], &[u8], &[u8]) {
+        split_planes(&self.data, self.width, self.height)
+    }
+
+    /// Luma-resolution alpha (empty when opaque)
+    pub fn alpha(&self) -> &[u8] {
+        &self.alpha
+    }
+
+    /// Chroma-resolution alpha (empty when opaque)
+    pub fn chroma_alpha(&self) -> &[u8] {
+        &self.chroma_alpha
+    }
+
+    /// Approximate heap size in bytes
+    pub fn byte_size(&self) -> usize {
+        self.data.len() + self.alpha.len() + self.chroma_alpha.len()
+    }
+
+    /// Hands the plane buffers back to `pool`
+    pub fn recycle(self, pool: &BufferPool) {
+        pool.give(self.data);
+        pool.give(self.alpha);
+        pool.give(self.chroma_alpha);
+    }
+
+    /// Nearest-neighbour resize to `width`×`height`, used to stretch a
+    /// reduced tier back to its full-quality size
+    pub fn resized(&self, width: u32, height: u32) -> Self {
+        let (src_cw, src_ch) = chroma_dimensions(self.width, self.height);
+        let (dst_cw, dst_ch) = chroma_dimensions(width, height);
+        let (y, u, v) = self.planes();
+
+        let mut data = resize_plane(y, self.width, self.height, width, height);
+        data.extend(resize_plane(u, src_cw, src_ch, dst_cw, dst_ch));
+        data.extend(resize_plane(v, src_cw, src_ch, dst_cw, dst_ch));
+
+        let (alpha, chroma_alpha) = if self.is_opaque() {
+            (Vec::new(), Vec::new())
+        } else {
+            (
+                resize_plane(&self.alpha, self.width, self.height, width, height),
+                resize_plane(&self.chroma_alpha, src_cw, src_ch, dst_cw, dst_ch),
+            )
+        };
+
+        Self {
+            width,
+            height,
+            data,
+            alpha,
+            chroma_alpha,
+        }
+    }
+}
+
+/// Nearest-neighbour resize of one 8-bit plane
+fn resize_plane(src: &[u8], src_w: u32, src_h: u32, dst_w: u32, dst_h: u32) -> Vec<u8> {
+    let columns: Vec<usize> = (0..dst_w as u64)
+        .map(|x| (x * src_w as u64 / dst_w as u64) as usize)
+        .collect();
+    let mut out = Vec::with_capacity(dst_w as usize * dst_h as usize);
+    for y in 0..dst_h as u64 {
+        let row = &src[(y * src_h as u64 / dst_h as u64) as usize * src_w as usize..];
+        out.extend(columns.iter().map(|&x| row[x]));
+    }
+    out
+}
+
+fn split_planes(data: &[u8], width: u32, height: u32) -> (&[u8], &[u8], &[u8]) {
+    let luma_len = width as usize * height as usize;
+    let (cw, ch) = chroma_dimensions(width, height);
+    let chroma_len = cw as usize * ch as usize;
+    let (y, rest) = data.split_at(luma_len);
+    let (u, rest) = rest.split_at(chroma_len);
+    (y, u, &rest[..chroma_len])
+}
+
+/// Averages each 2×2 block of a single-channel plane
+fn subsample_plane(plane: &[u8], width: u32, height: u32) -> Vec<u8> {
+    let (w, h) = (width as usize, height as usize);
+    let (cw, ch) = chroma_dimensions(width, height);
+    let mut out = Vec::with_capacity(cw as usize * ch as usize);
+    for cy in 0..ch as usize {
+        let y0 = cy * 2;
+        let y1 = (y0 + 1).min(h - 1);
+        for cx in 0..cw as usize {
+            let x0 = cx * 2;
+            let x1 = (x0 + 1).min(w - 1);
+            let sum = plane[y0 * w + x0] as u32
+                + plane[y0 * w + x1] as u32
+                + plane[y1 * w + x0] as u32
+                + plane[y1 * w + x1] as u32;
+            out.push((sum / 4) as u8);
+        }
+    }
+    out
+}
+
+/// YCbCr matrix used by a decoded picture
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum YuvMatrix {
+    Bt601,
+    Bt709,
+    Bt2020,
+}
+
+impl YuvMatrix {
+    /// Maps CICP matrix coefficients; None for identity (GBR) and other
+    /// non-YCbCr encodings.  Unspecified values fall back to BT.601, like
+    /// libavif does.
+    pub fn from_cicp(matrix_coefficients: u16) -> Option<Self> {
+        match matrix_coefficients {
+            0 | 8 | 11..=14 => None,
+            1 => Some(YuvMatrix::Bt709),
+            9 | 10 => Some(YuvMatrix::Bt2020),
+            _ => Some(YuvMatrix::Bt601),
+        }
+    }
+
+    /// (Kr, Kb) luma weights
+    fn weights(self) -> (f64, f64) {
+        match self {
+            YuvMatrix::Bt601 => (0.299, 0.114),
+            YuvMatrix::Bt709 => (0.2126, 0.0722),
+            YuvMatrix::Bt2020 => (0.2627, 0.0593),
+        }
+    }
+}
+
+/// Fixed-point YCbCr → RGB converter for one matrix/range combination
+#[derive(Debug, Clone, Copy)]
+pub struct YuvToRgb {
+    y_offset: i32,
+    y_mul: i32,
+    cr_r: i32,
+    cb_g: i32,
+    cr_g: i32,
+    cb_b: i32,
+}
+
+impl YuvToRgb {
+    const SHIFT: u32 = 14;
+
+    /// Builds a converter for the given matrix and sample range
+    pub fn new(matrix: YuvMatrix, full_range: bool) -> Self {
+        let (kr, kb) = matrix.weights();
+        let kg = 1.0 - kr - kb;
+        let (y_scale, c_scale, y_offset) = if full_range {
+            (1.0, 1.0, 0)
+        } else {
+            (255.0 / 219.0, 255.0 / 224.0, 16)
+        };
+        let fixed = |v: f64| (v * (1 << Self::SHIFT) as f64).round() as i32;
+
+        Self {
+            y_offset,
+            y_mul: fixed(y_scale),
+            cr_r: fixed(2.0 * (1.0 - kr) * c_scale),
+            cb_g: fixed(2.0 * kb * (1.0 - kb) / kg * c_scale),
+            cr_g: fixed(2.0 * kr * (1.0 - kr) / kg * c_scale),
+            cb_b: fixed(2.0 * (1.0 - kb) * c_scale),
+        }
+    }
+
+    /// Converts one YCbCr sample to RGB
+    #[inline]
+    pub fn convert(&self, y: u8, cb: u8, cr: u8) -> [u8; 3] {
+        let round = 1 << (Self::SHIFT - 1);
+        let y = (y as i32 - self.y_offset) * self.y_mul;
+        let cb = cb as i32 - 128;
+        let cr = cr as i32 - 128;
+        let clamp = |v: i32| ((v + round) >> Self::SHIFT).clamp(0, 255) as u8;
+        [
+            clamp(y + self.cr_r * cr),
+            clamp(y - self.cb_g * cb - self.cr_g * cr),
+            clamp(y + self.cb_b * cb),
+        ]
+    }
+}
+
+/// Borrowed 8-bit planes of a decoded picture
+#[derive(Debug, Clone, Copy)]
+pub struct YuvPlanes<'a> {
+    pub y: &'a [u8],
+    pub y_stride: usize,
+    /// Chroma planes; None for monochrome (4:0:0) pictures
+    pub uv: Option<(&'a [u8], &'a [u8])>,
+    pub uv_stride: usize,
+    /// Horizontal chroma subsampling shift (1 for 4:2:0 and 4:2:2)
+    pub ss_x: u32,
+    /// Vertical chroma subsampling shift (1 for 4:2:0)
+    pub ss_y: u32,
+}
+
+/// Converts the top-left `width`×`height` of a YCbCr picture into packed
+/// RGBA with opaque alpha.  `out` must hold `width * height * 4` bytes.
+pub fn yuv_to_rgba(planes: &YuvPlanes, width: u32, height: u32, conv: &YuvToRgb, out: &mut [u8]) {
+    let width = width as usize;
+    for (row, out_row) in out.chunks_exact_mut(width * 4).take(height as usize).enumerate() {
+        let y_row = &planes.y[row * planes.y_stride..][..width];
+        match planes.uv {
+            Some((u, v)) => {
+                let c_off = (row >> planes.ss_y) * planes.uv_stride;
+                let (u_row, v_row) = (&u[c_off..], &v[c_off..]);
+                for (x, (px, &luma)) in out_row.chunks_exact_mut(4).zip(y_row).enumerate() {
+                    let cx = x >> planes.ss_x;
+                    let [r, g, b] = conv.convert(luma, u_row[cx], v_row[cx]);
+                    px.copy_from_slice(&[r, g, b, 255]);
+                }
+            }
+            None => {
+                for (px, &luma) in out_row.chunks_exact_mut(4).zip(y_row) {
+                    let [r, g, b] = conv.convert(luma, 128, 128);
+                    px.copy_from_slice(&[r, g, b, 255]);
+                }
+            }
+        }
+    }
+}
+
+/// Expands a limited-range (16–235) sample to full range
+#[inline]
+pub fn expand_limited(v: u8) -> u8 {
+    (((v.clamp(16, 235) as u32 - 16) * 255 + 109) / 219) as u8
+}
+
+/// Blends `src` over `dst` in place using per-sample alpha
+#[inline]
+pub fn blend_row(dst: &mut [u8], src: &[u8], alpha: &[u8]) {
+    for ((d, &s), &a) in dst.iter_mut().zip(src).zip(alpha) {
+        let a = a as u32;
+        *d = ((s as u32 * a + *d as u32 * (255 - a) + 127) / 255) as u8;
+    }
+}
+
+/// Size in bytes of one I420 frame (Y plane followed by U and V planes)
+pub fn i420_frame_size(width: u32, height: u32) -> usize {
+    let (cw, ch) = chroma_dimensions(width, height);
+    (width as usize * height as usize) + 2 * (cw as usize * ch as usize)
+}
+
+/// Dimensions of each chroma plane for a 4:2:0 frame of the given size
+pub fn chroma_dimensions(width: u32, height: u32) -> (u32, u32) {
+    ((width + 1) / 2, (height + 1) / 2)
+}
+
+/// Converts an RGBA image into a tightly packed I420 buffer.
+///
+/// `out` is resized to [`i420_frame_size`] so the same buffer can be reused
+/// across frames without reallocating.
+pub fn rgba_to_i420(src: &RgbaImage, out: &mut Vec<u8>) {
+    let width = src.width() as usize;
+    let height = src.height() as usize;
+    let (cw, ch) = chroma_dimensions(src.width(), src.height());
+    let (cw, ch) = (cw as usize, ch as usize);
+
+    out.resize(i420_frame_size(src.width(), src.height()), 0);
+    let (y_plane, chroma) = out.split_at_mut(width * height);
+    let (u_plane, v_plane) = chroma.split_at_mut(cw * ch);
+    let raw = src.as_raw();
+
+    // Luma
+    for (row, y_row) in raw.chunks_exact(width * 4).zip(y_plane.chunks_exact_mut(width)) {
+        for (px, y) in row.chunks_exact(4).zip(y_row.iter_mut()) {
+            *y = luma(px[0], px[1], px[2]);
+        }
+    }
+
+    // Chroma: average each 2×2 block (clamped at the right/bottom edge)
+    for cy in 0..ch {
+        let y0 = cy * 2;
+        let y1 = (y0 + 1).min(height - 1);
+        for cx in 0..cw {
+            let x0 = cx * 2;
+            let x1 = (x0 + 1).min(width - 1);
+
+            let mut r = 0u32;
+            let mut g = 0u32;
+            let mut b = 0u32;
+            for &(x, y) in &[(x0, y0), (x1, y0), (x0, y1), (x1, y1)] {
+                let off = (y * width + x) * 4;
+                r += raw[off] as u32;
+                g += raw[off + 1] as u32;
+                b += raw[off + 2] as u32;
+            }
+
+            let (u, v) = chroma_from_rgb((r / 4) as u8, (g / 4) as u8, (b / 4) as u8);
+            u_plane[cy * cw + cx] = u;
+            v_plane[cy * cw + cx] = v;
+        }
+    }
+}
+
+/// BT.601 limited-range luma for one RGB sample
+#[inline]
+pub fn luma(r: u8, g: u8, b: u8) -> u8 {
+    let (r, g, b) = (r as i32, g as i32, b as i32);
+    (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16) as u8
+}
+
+/// BT.601 limited-range (Cb, Cr) for one RGB sample
+#[inline]
+pub fn chroma_from_rgb(r: u8, g: u8, b: u8) -> (u8, u8) {
+    let (r, g, b) = (r as i32, g as i32, b as i32);
+    let u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    let v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    (u as u8, v as u8)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use image::Rgba;
+
+    #[test]
+    fn test_i420_odd_dimensions() {
+        let img = RgbaImage::from_pixel(5, 3, Rgba([255, 255, 255, 255]));
+        let mut out = Vec::new();
+        rgba_to_i420(&img, &mut out);
+
+        // 5×3 luma + 2 × (3×2) chroma
+        assert_eq!(out.len(), 15 + 12);
+        assert!(out[..15].iter().all(|&y| y == 235));
+        assert!(out[15..].iter().all(|&c| c == 128));
+    }
+
+    #[test]
+    fn test_yuv_to_rgb_ranges() {
+        let limited = YuvToRgb::new(YuvMatrix::Bt601, false);
+        assert_eq!(limited.convert(235, 128, 128), [255, 255, 255]);
+        assert_eq!(limited.convert(16, 128, 128), [0, 0, 0]);
+
+        // Round trip through the encoder-side coefficients
+        let (u, v) = chroma_from_rgb(200, 40, 90);
+        let [r, g, b] = limited.convert(luma(200, 40, 90), u, v);
+        assert!((r as i32 - 200).abs() <= 3 && (g as i32 - 40).abs() <= 3 && (b as i32 - 90).abs() <= 3);
+
+        let full = YuvToRgb::new(YuvMatrix::Bt709, true);
+        assert_eq!(full.convert(255, 128, 128), [255, 255, 255]);
+    }
+}
@@ -0,0 +1,121 @@
+//! Encoder hot-path benchmarks
+//!
+//! Run with `cargo bench -p vai-encoder`; every input is a
+//! [`SyntheticVideo`] frame from a fixed seed.  The FFmpeg group is skipped
+//! when no AV1 encoder is available.  The `analyze` group runs both encoder
+//! passes over synthetic video, one preset per benchmark.
+
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use image::RgbaImage;
+use vai_encoder::synthetic::{Preset, SyntheticConfig, SyntheticVideo};
+use vai_encoder::{avif_encoder, ffmpeg_encoder, scene_analyzer, scene_detector, EncoderConfig, SceneAnalyzer};
+
+#[path = "../../benches/common.rs"]
+mod common;
+
+/// Sprite edge lengths for the AVIF encoders
+const SPRITE_SIZES: [u32; 3] = [64, 128, 256];
+
+/// A `width` x `height` video with `sprites` sprites over a textured background
+fn video(width: u32, height: u32, sprites: u32, seed: u64) -> SyntheticVideo {
+    SyntheticVideo::new(SyntheticConfig {
+        width,
+        height,
+        sprites,
+        seed,
+        ..SyntheticConfig::default()
+    })
+}
+
+/// First frame of a square video, used as a sprite to encode
+fn sprite(size: u32) -> RgbaImage {
+    video(size, size, 1, size as u64).frame(0)
+}
+
+fn bench_diff(c: &mut Criterion) {
+    let config = EncoderConfig::default();
+    let video = video(1280, 720, 8, 1);
+    let (background, frame) = (video.frame(0), video.frame(1));
+
+    let mut group = c.benchmark_group("diff");
+    group.throughput(Throughput::Elements(1280 * 720));
+    group.bench_function("find_diff_regions/720p_8_sprites", |b| {
+        b.iter(|| scene_analyzer::find_diff_regions(&config, black_box(&background), black_box(&frame)))
+    });
+    group.bench_function("compute_change_ratio/720p", |b| {
+        b.iter(|| scene_detector::compute_change_ratio(black_box(&background), black_box(&frame), 30))
+    });
+    group.finish();
+}
+
+fn bench_avif(c: &mut Criterion) {
+    let mut group = c.benchmark_group("encode_avif");
+    group.sample_size(10);
+    for size in SPRITE_SIZES {
+        let sprite = sprite(size);
+        group.throughput(Throughput::Elements(size as u64 * size as u64));
+        group.bench_with_input(BenchmarkId::new("ravif", size), &sprite, |b, sprite| {
+            b.iter(|| avif_encoder::encode_avif(sprite, 80).unwrap())
+        });
+    }
+    group.finish();
+
+    if !ffmpeg_encoder::is_available() {
+        eprintln!("encode_avif_ffmpeg: no FFmpeg AV1 encoder, skipped");
+        return;
+    }
+    let mut group = c.benchmark_group("encode_avif_ffmpeg");
+    group.sample_size(10);
+    for size in SPRITE_SIZES {
+        let sprite = sprite(size);
+        group.throughput(Throughput::Elements(size as u64 * size as u64));
+        group.bench_with_input(BenchmarkId::new("ffmpeg", size), &sprite, |b, sprite| {
+            b.iter(|| ffmpeg_encoder::encode_avif_ffmpeg(sprite, 80).unwrap())
+        });
+    }
+    group.finish();
+}
+
+fn bench_analyze(c: &mut Criterion) {
+    let analyzer = SceneAnalyzer::new(EncoderConfig::default());
+    let detector = scene_detector::SceneDetectorConfig::default();
+
+    let mut group = c.benchmark_group("analyze");
+    group.sample_size(10);
+    for (name, preset) in [
+        ("sprites", Preset::Sprites),
+        ("drift", Preset::Drift),
+        ("cuts", Preset::Cuts),
+        ("noise", Preset::Noise),
+        ("screen", Preset::Screen),
+    ] {
+        let config = SyntheticConfig {
+            width: 320,
+            height: 180,
+            frames: 90,
+            ..SyntheticConfig::preset(preset)
+        };
+        group.throughput(Throughput::Elements(config.frames as u64));
+        group.bench_with_input(BenchmarkId::new("synthetic", name), &config, |b, config| {
+            b.iter(|| {
+                let mut video = SyntheticVideo::new(config.clone());
+                let mut segments = scene_detector::detect_scenes(&mut video, &detector).unwrap();
+                if let Some(last) = segments.last_mut() {
+                    last.end_frame = config.frames as usize;
+                }
+                let duration_ms = config.duration_ms();
+                analyzer
+                    .analyze_parallel(&mut video, segments, 320, 180, config.fps_num, config.fps_den, duration_ms)
+                    .unwrap()
+            })
+        });
+    }
+    group.finish();
+}
+
+criterion_group! {
+    name = benches;
+    config = common::config();
+    targets = bench_diff, bench_avif, bench_analyze
+}
+criterion_main!(benches);
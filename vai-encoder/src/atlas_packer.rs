@@ -0,0 +1,144 @@
+//! Sprite atlas packing
+//!
+//! Every sprite stored as its own AVIF pays for its own `ftyp`/`meta` boxes
+//! and its own decoder invocation.  In atlas mode the small sprites of a
+//! chunk are shelf-packed into shared atlas images that are encoded once;
+//! the container then addresses each sprite as a slice of its atlas.
+
+use image::RgbaImage;
+
+/// Largest atlas edge in pixels
+pub const MAX_ATLAS_SIZE: u32 = 1024;
+
+/// Gap around every sprite, filled by repeating its edge pixels so lossy
+/// coding does not bleed neighbours (or transparency) into the slice.
+/// Even, and cells are rounded up to even sizes, so slice origins keep
+/// the atlas's 4:2:0 chroma alignment.
+const PADDING: u32 = 2;
+
+/// One packed atlas image
+#[derive(Debug)]
+pub struct Atlas {
+    /// Packed pixels
+    pub image: RgbaImage,
+    /// `(sprite index, x, y)` of every sprite placed in this atlas
+    pub placements: Vec<(usize, u32, u32)>,
+}
+
+/// Packs sprites into as few atlases as the shelf heuristic manages.
+///
+/// Sprites larger than an atlas (after padding) are skipped; callers only
+/// pass small sprites.  Every other sprite index appears in exactly one
+/// atlas's placements.
+pub fn pack_atlases(sprites: &[&RgbaImage]) -> Vec<Atlas> {
+    let fits = |s: &RgbaImage| {
+        s.width() + 2 * PADDING <= MAX_ATLAS_SIZE && s.height() + 2 * PADDING <= MAX_ATLAS_SIZE
+    };
+
+    // Tallest first keeps shelves tight
+    let mut order: Vec<usize> = (0..sprites.len()).filter(|&i| fits(sprites[i])).collect();
+    order.sort_by_key(|&i| std::cmp::Reverse((sprites[i].height(), sprites[i].width())));
+
+    let mut atlases = Vec::new();
+    let mut placements = Vec::new();
+    let (mut x, mut y, mut shelf_height, mut used_width) = (0u32, 0u32, 0u32, 0u32);
+
+    for i in order {
+        let cell_w = (sprites[i].width() + 2 * PADDING + 1) & !1;
+        let cell_h = (sprites[i].height() + 2 * PADDING + 1) & !1;
+
+        if x + cell_w > MAX_ATLAS_SIZE {
+            // Next shelf
+            x = 0;
+            y += shelf_height;
+            shelf_height = 0;
+        }
+        if y + cell_h > MAX_ATLAS_SIZE {
+            // Atlas full
+            atlases.push(build_atlas(sprites, std::mem::take(&mut placements), used_width, y + shelf_height));
+            x = 0;
+            y = 0;
+            shelf_height = 0;
+            used_width = 0;
+        }
+
+        placements.push((i, x + PADDING, y + PADDING));
+        x += cell_w;
+        shelf_height = shelf_height.max(cell_h);
+        used_width = used_width.max(x);
+    }
+
+    if !placements.is_empty() {
+        atlases.push(build_atlas(sprites, placements, used_width, y + shelf_height));
+    }
+
+    atlases
+}
+
+/// Blits the placed sprites (with edge-replicated padding) into one image
+fn build_atlas(sprites: &[&RgbaImage], placements: Vec<(usize, u32, u32)>, width: u32, height: u32) -> Atlas {
+    // Round up to even sizes for 4:2:0 encoders
+    let mut image = RgbaImage::new((width + 1) & !1, (height + 1) & !1);
+    let atlas_stride = image.width() as usize * 4;
+    let atlas: &mut [u8] = &mut image;
+
+    for &(i, px, py) in &placements {
+        let sprite = sprites[i];
+        let (w, h) = (sprite.width() as usize, sprite.height() as usize);
+        let src = sprite.as_raw();
+        let pad = PADDING as usize;
+
+        for cy in 0..h + 2 * pad {
+            let sy = cy.saturating_sub(pad).min(h - 1);
+            let src_row = &src[sy * w * 4..][..w * 4];
+            let row_start = (py as usize - pad + cy) * atlas_stride + (px as usize - pad) * 4;
+            let dst_row = &mut atlas[row_start..][..(w + 2 * pad) * 4];
+
+            // Left padding, sprite row, right padding
+            for p in 0..pad {
+                dst_row[p * 4..][..4].copy_from_slice(&src_row[..4]);
+                dst_row[(pad + w + p) * 4..][..4].copy_from_slice(&src_row[(w - 1) * 4..]);
+            }
+            dst_row[pad * 4..][..w * 4].copy_from_slice(src_row);
+        }
+    }
+
+    Atlas { image, placements }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use image::Rgba;
+
+    #[test]
+    fn test_pack_places_every_sprite_without_overlap() {
+        let sprites: Vec<RgbaImage> = (0..40)
+            .map(|i| RgbaImage::from_pixel(10 + i * 7, 5 + i * 3, Rgba([i as u8, 0, 0, 255])))
+            .collect();
+        let refs: Vec<&RgbaImage> = sprites.iter().collect();
+
+        let atlases = pack_atlases(&refs);
+        let mut seen = vec![false; sprites.len()];
+        for atlas in &atlases {
+            let rects: Vec<(u32, u32, u32, u32)> = atlas
+                .placements
+                .iter()
+                .map(|&(i, x, y)| (x, y, sprites[i].width(), sprites[i].height()))
+                .collect();
+            for (a, &(i, x, y)) in atlas.placements.iter().enumerate() {
+                assert!(!seen[i]);
+                seen[i] = true;
+                assert_eq!((x % 2, y % 2), (0, 0));
+                assert!(x + sprites[i].width() <= atlas.image.width());
+                assert!(y + sprites[i].height() <= atlas.image.height());
+                assert_eq!(atlas.image.get_pixel(x, y), &Rgba([i as u8, 0, 0, 255]));
+                for &(bx, by, bw, bh) in &rects[a + 1..] {
+                    let (w, h) = (sprites[i].width(), sprites[i].height());
+                    assert!(x + w <= bx || bx + bw <= x || y + h <= by || by + bh <= y);
+                }
+            }
+        }
+        assert!(seen.iter().all(|&s| s));
+    }
+}
@@ -1,8 +1,10 @@
 //! AVIF encoding functionality
 
+use crate::metrics::{self, Stage};
 use crate::{Error, Result};
 use image::RgbaImage;
 use ravif::{Encoder, Img, RGBA8};
+use std::time::Instant;
 
 /// Encode an RGBA image to AVIF, dispatching to the FFmpeg backend when
 /// `use_ffmpeg` is true (and falling back to ravif if FFmpeg is unavailable).
@@ -20,6 +22,7 @@ pub fn encode_avif_auto(image: &RgbaImage, quality: u8, use_ffmpeg: bool) -> Res
 
 /// Encodes an RGBA image to AVIF format using the pure-Rust ravif encoder
 pub fn encode_avif(image: &RgbaImage, quality: u8) -> Result<Vec<u8>> {
+    let started = Instant::now();
     let width = image.width() as usize;
     let height = image.height() as usize;
 
@@ -37,6 +40,7 @@ pub fn encode_avif(image: &RgbaImage, quality: u8) -> Result<Vec<u8>> {
     let encoded = encoder.encode_rgba(img)
         .map_err(|e| Error::AvifEncode(format!("{:?}", e)))?;
 
+    metrics::global().record(Stage::AvifRavif, started.elapsed(), 1, encoded.avif_file.len() as u64);
     Ok(encoded.avif_file)
 }
 
@@ -10,8 +10,10 @@
 //!   3. AV1 encoder → raw OBU bitstream
 //!   4. Wrap the OBU in a minimal AVIF (ISOBMFF) container
 
+use crate::metrics::{self, Stage};
 use crate::{Error, Result};
 use image::RgbaImage;
+use std::time::Instant;
 
 // ── Encoder preference list ──
 // Tried in order; first one that FFmpeg can find wins.
@@ -36,122 +38,220 @@ pub fn encode_avif_ffmpeg(image: &RgbaImage, quality: u8) -> Result<Vec<u8>> {
         )));
     }
 
-    // Map quality 0..100 → CRF 63..0  (higher quality = lower CRF)
-    let crf = ((100u16.saturating_sub(quality as u16)) as f64 * 63.0 / 100.0).round() as i32;
+    let started = Instant::now();
+    let mut session = Av1Session::open(width, height, quality, None)?;
+    session.send(image)?;
+    let av1_data = session.finish()?.concat();
 
-    // ── 1. Find an AV1 encoder ──
-    let codec = ENCODER_NAMES
-        .iter()
-        .find_map(|name| ffmpeg_next::encoder::find_by_name(name))
-        .ok_or_else(|| {
-            Error::AvifEncode(
-                "No AV1 encoder found (tried libsvtav1, libaom-av1, librav1e)".into(),
-            )
-        })?;
+    if av1_data.is_empty() {
+        return Err(Error::AvifEncode("AV1 encoder produced no output".into()));
+    }
+
+    // ── 5. Wrap raw AV1 OBUs in a minimal AVIF (ISOBMFF) container ──
+    let avif = wrap_av1_in_avif(&av1_data, width, height);
+
+    metrics::global().record(Stage::AvifFfmpeg, started.elapsed(), 1, avif.len() as u64);
+    Ok(avif)
+}
 
-    let encoder_name = unsafe {
-        std::ffi::CStr::from_ptr((*codec.as_ptr()).name)
-            .to_str()
-            .unwrap_or("unknown")
-            .to_string()
-    };
-
-    // ── 2. Configure the encoder ──
-    // YUV420P requires even dimensions; round up if needed.
-    let enc_width = (width + 1) & !1;
-    let enc_height = (height + 1) & !1;
-
-    let context = ffmpeg_next::codec::context::Context::from_parameters(
-        ffmpeg_next::codec::Parameters::new(),
-    )?;
-    let mut video = context.encoder().video()?;
-
-    video.set_width(enc_width);
-    video.set_height(enc_height);
-    video.set_format(ffmpeg_next::format::Pixel::YUV420P);
-    video.set_time_base(ffmpeg_next::Rational(1, 25));
-    // Single still image — one intra frame, no B-frames
-    video.set_gop(0);
-    video.set_max_b_frames(0);
-
-    // Encoder-specific options via the private options dict
-    let mut opts = ffmpeg_next::Dictionary::new();
-    opts.set("crf", &crf.to_string());
-
-    // SVT-AV1 specific: use a fast preset for stills
-    if encoder_name == "libsvtav1" {
-        // preset 6 is a good speed/quality trade-off for stills
-        opts.set("preset", "6");
-        // Limit SVT-AV1 to 1 thread per instance — our outer parallel loop
-        // already saturates all cores, so each SVT-AV1 instance only needs 1.
-        opts.set("svtav1-params", "lp=1");
-    } else if encoder_name == "libaom-av1" {
-        // cpu-used 6 is much faster than default (1)
-        opts.set("cpu-used", "6");
-        opts.set("usage", "allintra");
-        opts.set("row-mt", "1");
+/// Encode equally sized RGBA frames as one AV1 sequence with inter
+/// prediction, returning one temporal unit per frame.
+///
+/// Frame 0 is the only key frame and the encoder runs in low-delay mode, so
+/// frames decode in order with no reordering.  Frames smaller than the
+/// encoder minimum are padded; the padding is transparent and cropped away
+/// by the decoder.
+pub fn encode_av1_sequence(frames: &[RgbaImage], quality: u8) -> Result<Vec<Vec<u8>>> {
+    let first = frames
+        .first()
+        .ok_or_else(|| Error::AvifEncode("empty AV1 sequence".into()))?;
+    let (width, height) = first.dimensions();
+    if frames.iter().any(|f| f.dimensions() != (width, height)) {
+        return Err(Error::AvifEncode("AV1 sequence frames differ in size".into()));
+    }
+
+    let started = Instant::now();
+    let mut session = Av1Session::open(width, height, quality, Some(frames.len() as u32))?;
+    for frame in frames {
+        session.send(frame)?;
+    }
+    let temporal_units = session.finish()?;
+
+    if temporal_units.len() != frames.len() {
+        return Err(Error::AvifEncode(format!(
+            "AV1 encoder produced {} temporal units for {} frames",
+            temporal_units.len(),
+            frames.len()
+        )));
     }
+    let bytes = temporal_units.iter().map(|unit| unit.len() as u64).sum();
+    metrics::global().record(Stage::TrackEncode, started.elapsed(), 1, bytes);
+    Ok(temporal_units)
+}
 
-    let mut encoder = video.open_as_with(codec, opts).map_err(|e| {
-        Error::AvifEncode(format!(
-            "FFmpeg encoder open failed for {encoder_name} ({enc_width}×{enc_height}, crf={crf}): {e}"
-        ))
-    })?;
+/// An open FFmpeg AV1 encoder plus the RGBA → YUV420P conversion feeding it
+struct Av1Session {
+    encoder: ffmpeg_next::codec::encoder::video::Encoder,
+    scaler: ffmpeg_next::software::scaling::Context,
+    rgba_frame: ffmpeg_next::util::frame::video::Video,
+    width: u32,
+    height: u32,
+    next_pts: i64,
+    packets: Vec<Vec<u8>>,
+}
 
-    // ── 3. Create RGBA frame and convert to YUV420P ──
-    // If we rounded up, create frames at the padded size and copy the source
-    // pixels into the top-left corner (the extra column/row is black/transparent).
-    let mut rgba_frame =
-        ffmpeg_next::util::frame::video::Video::new(ffmpeg_next::format::Pixel::RGBA, enc_width, enc_height);
-    rgba_frame.set_pts(Some(0));
+impl Av1Session {
+    /// Opens an encoder for `width`×`height` input.  `sequence_len` is `None`
+    /// for a single intra-only still, or the frame count of a low-delay
+    /// sequence (which is padded up to the 64×64 encoder minimum).
+    fn open(width: u32, height: u32, quality: u8, sequence_len: Option<u32>) -> Result<Self> {
+        // Map quality 0..100 → CRF 63..0  (higher quality = lower CRF)
+        let crf = ((100u16.saturating_sub(quality as u16)) as f64 * 63.0 / 100.0).round() as i32;
 
-    // Copy RGBA pixels into the frame (respecting stride + possible padding)
-    {
-        let stride = rgba_frame.stride(0);
-        let dst = rgba_frame.data_mut(0);
-        let src = image.as_raw();
-        let row_bytes = (width as usize) * 4;
-        for y in 0..height as usize {
-            let src_off = y * row_bytes;
-            let dst_off = y * stride;
-            dst[dst_off..dst_off + row_bytes].copy_from_slice(&src[src_off..src_off + row_bytes]);
+        // ── 1. Find an AV1 encoder ──
+        let codec = ENCODER_NAMES
+            .iter()
+            .find_map(|name| ffmpeg_next::encoder::find_by_name(name))
+            .ok_or_else(|| {
+                Error::AvifEncode(
+                    "No AV1 encoder found (tried libsvtav1, libaom-av1, librav1e)".into(),
+                )
+            })?;
+
+        let encoder_name = unsafe {
+            std::ffi::CStr::from_ptr((*codec.as_ptr()).name)
+                .to_str()
+                .unwrap_or("unknown")
+                .to_string()
+        };
+
+        // ── 2. Configure the encoder ──
+        // YUV420P requires even dimensions; round up if needed.
+        let (min_w, min_h) = if sequence_len.is_some() { (64, 64) } else { (0, 0) };
+        let enc_width = (width.max(min_w) + 1) & !1;
+        let enc_height = (height.max(min_h) + 1) & !1;
+
+        let context = ffmpeg_next::codec::context::Context::from_parameters(
+            ffmpeg_next::codec::Parameters::new(),
+        )?;
+        let mut video = context.encoder().video()?;
+
+        video.set_width(enc_width);
+        video.set_height(enc_height);
+        video.set_format(ffmpeg_next::format::Pixel::YUV420P);
+        video.set_time_base(ffmpeg_next::Rational(1, 25));
+        match sequence_len {
+            // Single still image — one intra frame, no B-frames
+            None => video.set_gop(0),
+            // One key frame for the whole sequence
+            Some(len) => video.set_gop(len.max(1)),
+        }
+        video.set_max_b_frames(0);
+
+        // Encoder-specific options via the private options dict
+        let mut opts = ffmpeg_next::Dictionary::new();
+        opts.set("crf", &crf.to_string());
+
+        // SVT-AV1 specific: use a fast preset for stills
+        if encoder_name == "libsvtav1" {
+            // preset 6 is a good speed/quality trade-off for stills
+            opts.set("preset", "6");
+            // Limit SVT-AV1 to 1 thread per instance — our outer parallel loop
+            // already saturates all cores, so each SVT-AV1 instance only needs 1.
+            // Sequences use the low-delay structure: one packet per frame, in order.
+            if sequence_len.is_some() {
+                opts.set("svtav1-params", "lp=1:pred-struct=1");
+            } else {
+                opts.set("svtav1-params", "lp=1");
+            }
+        } else if encoder_name == "libaom-av1" {
+            // cpu-used 6 is much faster than default (1)
+            opts.set("cpu-used", "6");
+            opts.set("row-mt", "1");
+            if sequence_len.is_some() {
+                opts.set("lag-in-frames", "0");
+            } else {
+                opts.set("usage", "allintra");
+            }
+        } else if encoder_name == "librav1e" && sequence_len.is_some() {
+            opts.set("rav1e-params", "low_latency=true");
         }
-    }
 
-    // swscale: RGBA → YUV420P
-    let mut scaler = ffmpeg_next::software::scaling::Context::get(
-        ffmpeg_next::format::Pixel::RGBA,
-        enc_width,
-        enc_height,
-        ffmpeg_next::format::Pixel::YUV420P,
-        enc_width,
-        enc_height,
-        ffmpeg_next::software::scaling::Flags::BILINEAR,
-    )?;
-
-    let mut yuv_frame = ffmpeg_next::util::frame::video::Video::empty();
-    scaler.run(&rgba_frame, &mut yuv_frame)?;
-    yuv_frame.set_pts(Some(0));
-
-    // ── 4. Encode ──
-    let mut av1_data = Vec::new();
-
-    encoder.send_frame(&yuv_frame)?;
-    encoder.send_eof()?;
-
-    let mut packet = ffmpeg_next::Packet::empty();
-    while encoder.receive_packet(&mut packet).is_ok() {
-        av1_data.extend_from_slice(packet.data().unwrap_or(&[]));
+        let encoder = video.open_as_with(codec, opts).map_err(|e| {
+            Error::AvifEncode(format!(
+                "FFmpeg encoder open failed for {encoder_name} ({enc_width}×{enc_height}, crf={crf}): {e}"
+            ))
+        })?;
+
+        // ── 3. RGBA input frame and RGBA → YUV420P converter ──
+        // If we rounded up, the frame is created at the padded size and the
+        // source pixels go into the top-left corner (the extra area is
+        // black/transparent).
+        let rgba_frame =
+            ffmpeg_next::util::frame::video::Video::new(ffmpeg_next::format::Pixel::RGBA, enc_width, enc_height);
+
+        let scaler = ffmpeg_next::software::scaling::Context::get(
+            ffmpeg_next::format::Pixel::RGBA,
+            enc_width,
+            enc_height,
+            ffmpeg_next::format::Pixel::YUV420P,
+            enc_width,
+            enc_height,
+            ffmpeg_next::software::scaling::Flags::BILINEAR,
+        )?;
+
+        Ok(Self {
+            encoder,
+            scaler,
+            rgba_frame,
+            width,
+            height,
+            next_pts: 0,
+            packets: Vec::new(),
+        })
     }
 
-    if av1_data.is_empty() {
-        return Err(Error::AvifEncode("AV1 encoder produced no output".into()));
+    /// Converts and encodes one frame
+    fn send(&mut self, image: &RgbaImage) -> Result<()> {
+        // Copy RGBA pixels into the frame (respecting stride + possible padding)
+        {
+            let stride = self.rgba_frame.stride(0);
+            let dst = self.rgba_frame.data_mut(0);
+            let src = image.as_raw();
+            let row_bytes = (self.width as usize) * 4;
+            for y in 0..self.height as usize {
+                let src_off = y * row_bytes;
+                let dst_off = y * stride;
+                dst[dst_off..dst_off + row_bytes].copy_from_slice(&src[src_off..src_off + row_bytes]);
+            }
+        }
+        self.rgba_frame.set_pts(Some(self.next_pts));
+
+        // swscale: RGBA → YUV420P
+        let mut yuv_frame = ffmpeg_next::util::frame::video::Video::empty();
+        self.scaler.run(&self.rgba_frame, &mut yuv_frame)?;
+        yuv_frame.set_pts(Some(self.next_pts));
+        self.next_pts += 1;
+
+        // ── 4. Encode ──
+        self.encoder.send_frame(&yuv_frame)?;
+        self.drain();
+        Ok(())
     }
 
-    // ── 5. Wrap raw AV1 OBUs in a minimal AVIF (ISOBMFF) container ──
-    let avif = wrap_av1_in_avif(&av1_data, width, height);
+    /// Flushes the encoder and returns every packet produced, in order
+    fn finish(mut self) -> Result<Vec<Vec<u8>>> {
+        self.encoder.send_eof()?;
+        self.drain();
+        Ok(self.packets)
+    }
 
-    Ok(avif)
+    fn drain(&mut self) {
+        let mut packet = ffmpeg_next::Packet::empty();
+        while self.encoder.receive_packet(&mut packet).is_ok() {
+            self.packets.push(packet.data().unwrap_or(&[]).to_vec());
+        }
+    }
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -0,0 +1,31 @@
+//! Frame sources the encoder passes read from
+//!
+//! Both passes only need the stream geometry and an in-order walk over the
+//! frames, so they are written against `FrameSource` rather than FFmpeg.
+//! [`VideoReader`](crate::VideoReader) decodes real files;
+//! [`SyntheticVideo`](crate::synthetic::SyntheticVideo) generates test
+//! content offline.
+
+use crate::Result;
+use image::RgbaImage;
+
+/// A video the encoder can read, one frame at a time
+pub trait FrameSource {
+    /// Frame width in pixels
+    fn width(&self) -> u32;
+
+    /// Frame height in pixels
+    fn height(&self) -> u32;
+
+    /// Frame rate as (numerator, denominator)
+    fn frame_rate(&self) -> (u32, u32);
+
+    /// Total duration in milliseconds
+    fn duration_ms(&self) -> u64;
+
+    /// Hands every frame to `callback` in order, with its index.  Each pass
+    /// reads the source once, so sources that can restart do so here.
+    fn read_frames_streaming<F>(&mut self, callback: F) -> Result<()>
+    where
+        F: FnMut(usize, RgbaImage) -> Result<()>;
+}
@@ -2,18 +2,29 @@
 //!
 //! This library provides functionality to encode video files into VAI format.
 
+pub mod atlas_packer;
 pub mod avif_encoder;
 pub mod ffmpeg_encoder;
+pub mod frame_source;
+pub mod metrics;
+pub mod preview_builder;
 pub mod progress_tracker;
 pub mod scene_analyzer;
 pub mod scene_detector;
+pub mod sprite_encoder;
+pub mod synthetic;
+pub mod tier_encoder;
 pub mod video_reader;
 
+pub use frame_source::FrameSource;
+pub use metrics::{EncoderMetrics, MetricsSnapshot};
 pub use progress_tracker::ProgressTracker;
 pub use scene_analyzer::SceneAnalyzer;
 pub use scene_detector::{SceneDetectorConfig, SceneSegment};
 pub use video_reader::VideoReader;
 
+use vai_core::AssetCodec;
+
 /// Result type for vai-encoder operations
 pub type Result<T> = std::result::Result<T, Error>;
 
@@ -35,6 +46,9 @@ pub enum Error {
     #[error("AVIF encode error: {0}")]
     AvifEncode(String),
 
+    #[error("Sprite encode error: {0}")]
+    SpriteEncode(String),
+
     #[error("Invalid video file")]
     InvalidVideo,
 
@@ -56,6 +70,25 @@ pub struct EncoderConfig {
     /// Use FFmpeg AV1 encoder (libsvtav1) instead of ravif.
     /// Much faster but requires FFmpeg with AV1 encoder support.
     pub use_ffmpeg: bool,
+    /// Codec for sprites at or below `sprite_max_area` pixels
+    /// (`AssetCodec::Avif` keeps every sprite in AVIF)
+    pub sprite_codec: AssetCodec,
+    /// Largest sprite area, in pixels, stored with `sprite_codec`
+    /// (or packed into an atlas when `atlas` is set)
+    pub sprite_max_area: u32,
+    /// Pack small sprites of each chunk into shared atlas images
+    /// (parallel encoder only)
+    pub atlas: bool,
+    /// Store regions that persist across consecutive frames as AV1
+    /// sequences with inter prediction (parallel encoder with `use_ffmpeg`)
+    pub tracks: bool,
+    /// Also store a half-resolution tier of backgrounds and large sprites
+    /// for players that cannot decode full quality in real time
+    /// (parallel encoder only)
+    pub low_tier: bool,
+    /// Store a low-resolution preview frame every second, for scrubbing
+    /// and instant post-seek display (parallel encoder only)
+    pub preview: bool,
 }
 
 impl Default for EncoderConfig {
@@ -66,6 +99,12 @@ impl Default for EncoderConfig {
             threshold: 30,
             min_region_size: 64,
             use_ffmpeg: false,
+            sprite_codec: AssetCodec::Qoi,
+            sprite_max_area: 64 * 64,
+            atlas: false,
+            tracks: false,
+            low_tier: false,
+            preview: false,
         }
     }
 }
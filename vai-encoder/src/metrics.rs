@@ -0,0 +1,309 @@
+//! Per-stage encoder metrics
+//!
+//! `ProgressTracker` says how far an encode has got; these counters say
+//! where its time went.  Every stage adds its wall time, call count and
+//! bytes to one process-wide [`EncoderMetrics`] (see [`global`]), so the
+//! free functions of the encoder record without a handle being threaded
+//! through them.  Encodes running side by side, as in `vai encode-batch`,
+//! add to the same counters.
+//!
+//! Besides the stages, the chunked encoder reports how many raw frames it
+//! has buffered (the queue in front of the workers) and how busy its worker
+//! threads were: every parallel step adds its wall time × thread budget as
+//! capacity and the time workers actually spent as busy, so
+//! `1 - utilisation` is time lost at chunk barriers and to uneven work.
+//!
+//! [`MetricsSnapshot`] reads the counters and renders them as JSON (with the
+//! `serde` feature) or as a Prometheus text-format file.
+
+use std::fmt::Write as _;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::{Duration, Instant};
+
+/// A timed encoder stage
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Stage {
+    /// FFmpeg packet decoding; bytes are compressed input
+    Decode,
+    /// Decoded frame to RGBA conversion; bytes are RGBA output
+    Convert,
+    /// Pass 1 change-ratio comparisons; bytes are frames compared
+    SceneDetect,
+    /// Pass 2 background diffing; bytes are frames diffed
+    Diff,
+    /// ravif AVIF encoding; bytes are encoded output
+    AvifRavif,
+    /// FFmpeg AVIF encoding; bytes are encoded output
+    AvifFfmpeg,
+    /// Raw, zstd, LZ4 and QOI sprite encoding; bytes are encoded output
+    SpriteEncode,
+    /// AV1 track sequences; bytes are encoded output
+    TrackEncode,
+    /// Reading stalled while a chunk of buffered frames was encoded
+    ChunkFlush,
+}
+
+impl Stage {
+    pub const ALL: [Stage; 9] = [
+        Stage::Decode,
+        Stage::Convert,
+        Stage::SceneDetect,
+        Stage::Diff,
+        Stage::AvifRavif,
+        Stage::AvifFfmpeg,
+        Stage::SpriteEncode,
+        Stage::TrackEncode,
+        Stage::ChunkFlush,
+    ];
+
+    /// Name used in reports and metric labels
+    pub fn name(self) -> &'static str {
+        match self {
+            Stage::Decode => "decode",
+            Stage::Convert => "convert",
+            Stage::SceneDetect => "scene_detect",
+            Stage::Diff => "diff",
+            Stage::AvifRavif => "avif_ravif",
+            Stage::AvifFfmpeg => "avif_ffmpeg",
+            Stage::SpriteEncode => "sprite_encode",
+            Stage::TrackEncode => "track_encode",
+            Stage::ChunkFlush => "chunk_flush",
+        }
+    }
+}
+
+struct StageCounters {
+    nanos: AtomicU64,
+    count: AtomicU64,
+    bytes: AtomicU64,
+}
+
+impl StageCounters {
+    const NEW: Self = Self {
+        nanos: AtomicU64::new(0),
+        count: AtomicU64::new(0),
+        bytes: AtomicU64::new(0),
+    };
+}
+
+/// Cumulative encoder counters, safe to update from any thread
+pub struct EncoderMetrics {
+    stages: [StageCounters; Stage::ALL.len()],
+    /// Raw frames buffered for the next chunk
+    queue_depth: AtomicU64,
+    queue_depth_max: AtomicU64,
+    /// Worker time spent working and available, in nanoseconds
+    busy_nanos: AtomicU64,
+    capacity_nanos: AtomicU64,
+}
+
+static METRICS: EncoderMetrics = EncoderMetrics::new();
+
+/// The process-wide counters every encoder stage records into
+pub fn global() -> &'static EncoderMetrics {
+    &METRICS
+}
+
+impl EncoderMetrics {
+    pub const fn new() -> Self {
+        Self {
+            stages: [StageCounters::NEW; Stage::ALL.len()],
+            queue_depth: AtomicU64::new(0),
+            queue_depth_max: AtomicU64::new(0),
+            busy_nanos: AtomicU64::new(0),
+            capacity_nanos: AtomicU64::new(0),
+        }
+    }
+
+    /// Adds `count` calls taking `elapsed` in total and handling `bytes`
+    pub fn record(&self, stage: Stage, elapsed: Duration, count: u64, bytes: u64) {
+        let counters = &self.stages[stage as usize];
+        counters.nanos.fetch_add(elapsed.as_nanos() as u64, Ordering::Relaxed);
+        counters.count.fetch_add(count, Ordering::Relaxed);
+        counters.bytes.fetch_add(bytes, Ordering::Relaxed);
+    }
+
+    /// Runs `f` as one call of `stage`; `bytes` sizes its result
+    pub fn time<T>(&self, stage: Stage, f: impl FnOnce() -> T, bytes: impl FnOnce(&T) -> u64) -> T {
+        let started = Instant::now();
+        let result = f();
+        self.record(stage, started.elapsed(), 1, bytes(&result));
+        result
+    }
+
+    /// Counts `frames` more buffered frames, keeping the high-water mark.
+    /// Encodes running side by side each add and release their own.
+    pub fn add_queue_depth(&self, frames: u64) {
+        let depth = self.queue_depth.fetch_add(frames, Ordering::Relaxed) + frames;
+        self.queue_depth_max.fetch_max(depth, Ordering::Relaxed);
+    }
+
+    /// Counts `frames` buffered frames as released
+    pub fn sub_queue_depth(&self, frames: u64) {
+        self.queue_depth.fetch_sub(frames, Ordering::Relaxed);
+    }
+
+    /// Adds one parallel step: `threads` workers were available for `wall`
+    /// and spent `busy` working in total
+    pub fn record_workers(&self, threads: usize, wall: Duration, busy: Duration) {
+        let capacity = wall.as_nanos() as u64 * threads as u64;
+        self.capacity_nanos.fetch_add(capacity, Ordering::Relaxed);
+        self.busy_nanos.fetch_add(busy.as_nanos() as u64, Ordering::Relaxed);
+    }
+
+    /// Zeroes every counter
+    pub fn reset(&self) {
+        for counters in &self.stages {
+            counters.nanos.store(0, Ordering::Relaxed);
+            counters.count.store(0, Ordering::Relaxed);
+            counters.bytes.store(0, Ordering::Relaxed);
+        }
+        for gauge in [&self.queue_depth, &self.queue_depth_max, &self.busy_nanos, &self.capacity_nanos] {
+            gauge.store(0, Ordering::Relaxed);
+        }
+    }
+
+    /// Reads the counters.  Taken while encoders run, the values are each
+    /// current but not mutually consistent.
+    pub fn snapshot(&self) -> MetricsSnapshot {
+        let seconds = |nanos: &AtomicU64| nanos.load(Ordering::Relaxed) as f64 / 1e9;
+        let busy = seconds(&self.busy_nanos);
+        let capacity = seconds(&self.capacity_nanos);
+        MetricsSnapshot {
+            stages: Stage::ALL
+                .iter()
+                .map(|&stage| {
+                    let counters = &self.stages[stage as usize];
+                    StageMetrics {
+                        stage: stage.name(),
+                        seconds: seconds(&counters.nanos),
+                        count: counters.count.load(Ordering::Relaxed),
+                        bytes: counters.bytes.load(Ordering::Relaxed),
+                    }
+                })
+                .collect(),
+            queue_depth: self.queue_depth.load(Ordering::Relaxed),
+            queue_depth_max: self.queue_depth_max.load(Ordering::Relaxed),
+            worker_busy_seconds: busy,
+            worker_capacity_seconds: capacity,
+            worker_utilisation: if capacity > 0.0 { busy / capacity } else { 0.0 },
+        }
+    }
+}
+
+impl Default for EncoderMetrics {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Totals of one stage
+#[derive(Debug, Clone, PartialEq)]
+#[cfg_attr(feature = "serde", derive(serde::Serialize))]
+pub struct StageMetrics {
+    pub stage: &'static str,
+    /// Cumulative wall time across all threads
+    pub seconds: f64,
+    pub count: u64,
+    pub bytes: u64,
+}
+
+/// Point-in-time copy of [`EncoderMetrics`]
+#[derive(Debug, Clone, PartialEq)]
+#[cfg_attr(feature = "serde", derive(serde::Serialize))]
+pub struct MetricsSnapshot {
+    pub stages: Vec<StageMetrics>,
+    pub queue_depth: u64,
+    pub queue_depth_max: u64,
+    pub worker_busy_seconds: f64,
+    pub worker_capacity_seconds: f64,
+    /// Busy over capacity (0.0 before any parallel step)
+    pub worker_utilisation: f64,
+}
+
+impl MetricsSnapshot {
+    pub fn stage(&self, stage: Stage) -> &StageMetrics {
+        &self.stages[stage as usize]
+    }
+
+    /// Renders the snapshot in the Prometheus text exposition format, for
+    /// the node_exporter textfile collector
+    pub fn to_prometheus(&self) -> String {
+        let mut out = String::new();
+        let per_stage: [(&str, &str, fn(&StageMetrics) -> String); 3] = [
+            ("stage_seconds_total", "Cumulative wall time per encoder stage", |s| s.seconds.to_string()),
+            ("stage_calls_total", "Calls per encoder stage", |s| s.count.to_string()),
+            ("stage_bytes_total", "Bytes handled per encoder stage", |s| s.bytes.to_string()),
+        ];
+        for (name, help, value) in per_stage {
+            let _ = writeln!(out, "# HELP vai_encoder_{name} {help}");
+            let _ = writeln!(out, "# TYPE vai_encoder_{name} counter");
+            for stage in &self.stages {
+                let _ = writeln!(out, "vai_encoder_{name}{{stage=\"{}\"}} {}", stage.stage, value(stage));
+            }
+        }
+
+        let scalars: [(&str, &str, &str, String); 5] = [
+            ("queue_depth", "gauge", "Raw frames buffered for the next chunk", self.queue_depth.to_string()),
+            ("queue_depth_max", "gauge", "Most raw frames buffered at once", self.queue_depth_max.to_string()),
+            (
+                "worker_busy_seconds_total",
+                "counter",
+                "Time encoder workers spent working",
+                self.worker_busy_seconds.to_string(),
+            ),
+            (
+                "worker_capacity_seconds_total",
+                "counter",
+                "Worker time available during parallel steps",
+                self.worker_capacity_seconds.to_string(),
+            ),
+            (
+                "worker_utilisation",
+                "gauge",
+                "Busy over available worker time",
+                self.worker_utilisation.to_string(),
+            ),
+        ];
+        for (name, kind, help, value) in scalars {
+            let _ = writeln!(out, "# HELP vai_encoder_{name} {help}");
+            let _ = writeln!(out, "# TYPE vai_encoder_{name} {kind}");
+            let _ = writeln!(out, "vai_encoder_{name} {value}");
+        }
+        out
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_snapshot_and_prometheus_output() {
+        let metrics = EncoderMetrics::new();
+        metrics.record(Stage::Diff, Duration::from_millis(1500), 3, 300);
+        let len = metrics.time(Stage::SpriteEncode, || vec![0u8; 42], |data| data.len() as u64).len();
+        assert_eq!(len, 42);
+        // Two encodes buffering at once
+        metrics.add_queue_depth(4);
+        metrics.add_queue_depth(3);
+        metrics.sub_queue_depth(4);
+        metrics.sub_queue_depth(1);
+        metrics.record_workers(4, Duration::from_secs(1), Duration::from_secs(3));
+
+        let snapshot = metrics.snapshot();
+        assert_eq!(snapshot.stage(Stage::Diff).seconds, 1.5);
+        assert_eq!((snapshot.stage(Stage::Diff).count, snapshot.stage(Stage::Diff).bytes), (3, 300));
+        assert_eq!(snapshot.stage(Stage::SpriteEncode).bytes, 42);
+        assert_eq!((snapshot.queue_depth, snapshot.queue_depth_max), (2, 7));
+        assert_eq!(snapshot.worker_utilisation, 0.75);
+
+        let text = snapshot.to_prometheus();
+        assert!(text.contains("vai_encoder_stage_seconds_total{stage=\"diff\"} 1.5\n"));
+        assert!(text.contains("vai_encoder_stage_bytes_total{stage=\"sprite_encode\"} 42\n"));
+        assert!(text.contains("# TYPE vai_encoder_queue_depth_max gauge\nvai_encoder_queue_depth_max 7\n"));
+
+        metrics.reset();
+        assert_eq!(metrics.snapshot(), EncoderMetrics::new().snapshot());
+    }
+}
@@ -0,0 +1,123 @@
+//! Low-resolution preview frames
+//!
+//! Samples the source video at a fixed interval and shrinks each sample to a
+//! thumbnail.  The thumbnails are packed into shared atlases, so a player can
+//! show scrub previews, or a first frame right after a seek, from a single
+//! small decode.
+
+use image::RgbaImage;
+
+/// Time between preview frames
+pub const PREVIEW_INTERVAL_MS: u64 = 1000;
+
+/// Width of a preview thumbnail; the height follows the aspect ratio
+pub const PREVIEW_WIDTH: u32 = 160;
+
+/// Collects thumbnails while frames stream past
+#[derive(Debug, Default)]
+pub struct PreviewBuilder {
+    next_ms: u64,
+    thumbnails: Vec<(u64, RgbaImage)>,
+}
+
+impl PreviewBuilder {
+    /// Creates an empty builder
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Offers a source frame; keeps a thumbnail of it if a preview is due
+    pub fn offer(&mut self, timestamp_ms: u64, frame: &RgbaImage) {
+        if timestamp_ms >= self.next_ms {
+            self.thumbnails.push((timestamp_ms, thumbnail(frame, PREVIEW_WIDTH)));
+            self.next_ms = (timestamp_ms / PREVIEW_INTERVAL_MS + 1) * PREVIEW_INTERVAL_MS;
+        }
+    }
+
+    /// Returns the collected `(timestamp_ms, thumbnail)` pairs
+    pub fn finish(self) -> Vec<(u64, RgbaImage)> {
+        self.thumbnails
+    }
+}
+
+/// Shrinks an image to `width` pixels wide (never enlarging) by averaging
+/// the source pixels covered by each thumbnail pixel
+pub fn thumbnail(image: &RgbaImage, width: u32) -> RgbaImage {
+    let (src_w, src_h) = (image.width() as usize, image.height() as usize);
+    let dst_w = (width as usize).min(src_w).max(1);
+    // Even height keeps 4:2:0 encoders happy
+    let dst_h = (((src_h * dst_w + src_w / 2) / src_w).max(2) + 1) & !1;
+    let src = image.as_raw();
+
+    let mut out = Vec::with_capacity(dst_w * dst_h * 4);
+    for ty in 0..dst_h {
+        let (y0, y1) = (ty * src_h / dst_h, ((ty + 1) * src_h / dst_h).max(ty * src_h / dst_h + 1));
+        for tx in 0..dst_w {
+            let (x0, x1) = (tx * src_w / dst_w, ((tx + 1) * src_w / dst_w).max(tx * src_w / dst_w + 1));
+            let mut sum = [0u32; 4];
+            for y in y0..y1.min(src_h) {
+                for px in src[(y * src_w + x0) * 4..(y * src_w + x1) * 4].chunks_exact(4) {
+                    for c in 0..4 {
+                        sum[c] += px[c] as u32;
+                    }
+                }
+            }
+            let count = ((y1.min(src_h) - y0) * (x1 - x0)).max(1) as u32;
+            out.extend(sum.iter().map(|&s| ((s + count / 2) / count) as u8));
+        }
+    }
+
+    RgbaImage::from_raw(dst_w as u32, dst_h as u32, out).unwrap()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use image::Rgba;
+
+    #[test]
+    fn test_thumbnail_keeps_aspect_ratio_and_even_height() {
+        // 16:9 and an aspect ratio whose exact height would be odd
+        let wide = thumbnail(&RgbaImage::new(1920, 1080), PREVIEW_WIDTH);
+        assert_eq!(wide.dimensions(), (160, 90));
+        let odd = thumbnail(&RgbaImage::new(320, 202), PREVIEW_WIDTH);
+        assert_eq!(odd.dimensions(), (160, 102));
+
+        // Never enlarged, and never thinner than two rows
+        assert_eq!(thumbnail(&RgbaImage::new(40, 30), PREVIEW_WIDTH).dimensions(), (40, 30));
+        assert_eq!(thumbnail(&RgbaImage::new(400, 1), PREVIEW_WIDTH).dimensions(), (160, 2));
+    }
+
+    #[test]
+    fn test_thumbnail_averages_source_pixels() {
+        // Alternating black and white columns average to mid grey
+        let stripes = RgbaImage::from_fn(320, 180, |x, _| {
+            let v = if x % 2 == 0 { 0 } else { 255 };
+            Rgba([v, v, v, 255])
+        });
+        let thumb = thumbnail(&stripes, PREVIEW_WIDTH);
+        assert!(thumb.pixels().all(|p| p.0 == [128, 128, 128, 255]));
+    }
+
+    #[test]
+    fn test_builder_samples_once_per_interval() {
+        let frame = RgbaImage::new(64, 36);
+        let mut builder = PreviewBuilder::new();
+        // 30 fps for 3.5 s
+        for i in 0..105u64 {
+            builder.offer(i * 1000 / 30, &frame);
+        }
+        let thumbnails = builder.finish();
+        let times: Vec<u64> = thumbnails.iter().map(|(t, _)| *t).collect();
+        assert_eq!(times, vec![0, 1000, 2000, 3000]);
+        assert!(thumbnails.iter().all(|(_, t)| t.dimensions() == (64, 36)));
+
+        // A gap in the input is sampled at the first frame after it
+        let mut builder = PreviewBuilder::new();
+        for t in [0, 400, 2500, 2900, 3100] {
+            builder.offer(t, &frame);
+        }
+        let times: Vec<u64> = builder.finish().iter().map(|(t, _)| *t).collect();
+        assert_eq!(times, vec![0, 2500, 3100]);
+    }
+}
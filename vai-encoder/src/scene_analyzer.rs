@@ -1,20 +1,66 @@
 //! Scene analysis and motion detection
 
+use crate::metrics::{self, Stage};
 use crate::scene_detector::SceneSegment;
-use crate::{avif_encoder, progress_tracker::ProgressTracker, EncoderConfig, Result};
+use crate::{
+    atlas_packer, avif_encoder, ffmpeg_encoder, preview_builder::PreviewBuilder,
+    progress_tracker::ProgressTracker, sprite_encoder, tier_encoder, EncoderConfig, FrameSource,
+    Result,
+};
 use image::{ImageBuffer, Rgba, RgbaImage};
 use std::thread;
-use vai_core::{Asset, TimelineEntry, VaiContainer, VaiHeader};
+use std::time::{Duration, Instant};
+use vai_core::{
+    track, Asset, AssetCodec, AssetSlice, AssetTier, PreviewFrame, TimelineEntry, VaiContainer,
+    VaiHeader,
+};
+
+/// Maximum raw frames to buffer before flushing a parallel encode.
+/// At 1080p RGBA (~8 MB/frame) 500 frames ≈ 4 GB peak.
+const CHUNK_SIZE: usize = 500;
 
 /// Scene analyzer that extracts background and motion regions
 pub struct SceneAnalyzer {
     config: EncoderConfig,
+    /// Worker threads for parallel encoding
+    threads: usize,
+    /// Cap on raw frame bytes buffered per chunk; `None` = `CHUNK_SIZE` frames
+    chunk_bytes: Option<u64>,
+    /// Print progress and summaries to stdout
+    verbose: bool,
 }
 
 impl SceneAnalyzer {
     /// Creates a new scene analyzer with the given configuration
     pub fn new(config: EncoderConfig) -> Self {
-        Self { config }
+        Self {
+            config,
+            threads: num_cpus::get().max(1),
+            chunk_bytes: None,
+            verbose: true,
+        }
+    }
+
+    /// Stops printing progress, for encodes whose output would interleave
+    /// with others' (see `vai encode-batch`)
+    pub fn quiet(mut self) -> Self {
+        self.verbose = false;
+        self
+    }
+
+    /// Whether progress is printed
+    pub fn is_verbose(&self) -> bool {
+        self.verbose
+    }
+
+    /// Limits parallel encoding to `threads` workers and its raw frame
+    /// buffer to `chunk_bytes`, so several encodes can share a machine
+    /// (see `vai encode-batch`).  Chunks still hold at least one frame and
+    /// at most `CHUNK_SIZE`.
+    pub fn with_resources(mut self, threads: usize, chunk_bytes: u64) -> Self {
+        self.threads = threads.max(1);
+        self.chunk_bytes = Some(chunk_bytes);
+        self
     }
 
     /// Analyzes frames and creates a VAI container (legacy, loads all frames into memory)
@@ -52,11 +98,12 @@ impl SceneAnalyzer {
 
             if !diff_regions.is_empty() {
                 for (x, y, region_img) in diff_regions {
-                    let region_data = avif_encoder::encode_avif_auto(&region_img, self.config.quality, self.config.use_ffmpeg)?;
-                    let region_asset = Asset::new(
+                    let (codec, region_data) = sprite_encoder::encode_sprite(&region_img, &self.config)?;
+                    let region_asset = Asset::with_codec(
                         asset_id,
                         region_img.width(),
                         region_img.height(),
+                        codec,
                         region_data,
                     );
                     assets.push(region_asset);
@@ -97,7 +144,7 @@ impl SceneAnalyzer {
     /// instead of O(N).
     pub fn analyze_streaming(
         &self,
-        reader: &mut crate::VideoReader,
+        reader: &mut impl FrameSource,
         width: u32,
         height: u32,
         fps_num: u32,
@@ -137,11 +184,12 @@ impl SceneAnalyzer {
                 let diff_regions = find_diff_regions(&config, bg, &frame);
 
                 for (x, y, region_img) in diff_regions {
-                    let region_data = avif_encoder::encode_avif_auto(&region_img, quality, use_ffmpeg)?;
-                    let region_asset = Asset::new(
+                    let (codec, region_data) = sprite_encoder::encode_sprite(&region_img, &config)?;
+                    let region_asset = Asset::with_codec(
                         asset_id,
                         region_img.width(),
                         region_img.height(),
+                        codec,
                         region_data,
                     );
                     assets.push(region_asset);
@@ -162,17 +210,21 @@ impl SceneAnalyzer {
                 }
             }
 
-            progress.increment_and_report(50);
+            if self.verbose {
+                progress.increment_and_report(50);
+            }
 
             Ok(())
         })?;
 
-        println!(
-            "  Total: {} frames, {} assets, {} timeline entries",
-            total_frames,
-            assets.len(),
-            timeline.len()
-        );
+        if self.verbose {
+            println!(
+                "  Total: {} frames, {} assets, {} timeline entries",
+                total_frames,
+                assets.len(),
+                timeline.len()
+            );
+        }
 
         let header = VaiHeader::new(
             width,
@@ -193,13 +245,19 @@ impl SceneAnalyzer {
     /// **Pass 2** – Read frames a second time. Raw frames are buffered in
     ///   chunks of up to `CHUNK_SIZE`. Each time the buffer fills (or a segment
     ///   boundary / end-of-stream is reached) the chunk is encoded in parallel
-    ///   across all CPU cores, only the compact AVIF results are kept, and the
+    ///   across all CPU cores (or the budget given to
+    ///   [`with_resources`](Self::with_resources)), only the compact AVIF results are kept, and the
     ///   raw frames are freed.  This bounds peak memory to roughly
     ///   `CHUNK_SIZE × frame_size` plus the (much smaller) accumulated AVIF
     ///   assets, and needs no temporary files on disk.
+    ///
+    /// With `config.atlas` set, each chunk's small regions are packed into
+    /// shared atlas images and referenced through asset slices.  With
+    /// `config.tracks` set (and an FFmpeg AV1 encoder), regions that persist
+    /// across consecutive frames become AV1 track assets.
     pub fn analyze_parallel(
         &self,
-        reader: &mut crate::VideoReader,
+        reader: &mut impl FrameSource,
         segments: Vec<SceneSegment>,
         width: u32,
         height: u32,
@@ -207,16 +265,19 @@ impl SceneAnalyzer {
         fps_den: u32,
         duration_ms: u64,
     ) -> Result<VaiContainer> {
-        /// Maximum raw frames to buffer before flushing a parallel encode.
-        /// At 1080p RGBA (~8 MB/frame) 500 frames ≈ 4 GB peak.
-        const CHUNK_SIZE: usize = 500;
-
         let num_segments = segments.len();
-        let n_threads = num_cpus::get().max(1);
-        println!(
-            "  Pass 2: encoding {} scene segment(s) in parallel ({} threads, chunk size {}) …",
-            num_segments, n_threads, CHUNK_SIZE
-        );
+        let n_threads = self.threads;
+        let frame_bytes = width as u64 * height as u64 * 4;
+        let chunk_size = match self.chunk_bytes {
+            Some(bytes) => ((bytes / frame_bytes.max(1)) as usize).clamp(1, CHUNK_SIZE),
+            None => CHUNK_SIZE,
+        };
+        if self.verbose {
+            println!(
+                "  Pass 2: encoding {} scene segment(s) in parallel ({} threads, chunk size {}) …",
+                num_segments, n_threads, chunk_size
+            );
+        }
 
         let estimated_frame_count =
             ((duration_ms as f64 * fps_num as f64) / (fps_den as f64 * 1000.0)).ceil() as u64;
@@ -226,19 +287,20 @@ impl SceneAnalyzer {
             duration_ms as f64
         };
 
-        let quality = self.config.quality;
-        let use_ffmpeg = self.config.use_ffmpeg;
         let config = self.config.clone();
-
-        let mut all_assets: Vec<Asset> = Vec::new();
-        let mut all_timeline: Vec<TimelineEntry> = Vec::new();
-        let mut next_asset_id: u32 = 0;
+        let mut out = EncodedOutput::default();
 
         // ── Encode each segment's background up-front ──
-        println!("  Encoding {} background(s) …", num_segments);
-        for seg in &segments {
-            let bg_data = avif_encoder::encode_avif_auto(&seg.background, quality, use_ffmpeg)?;
-            all_assets.push(Asset::new(next_asset_id, width, height, bg_data));
+        if self.verbose {
+            println!("  Encoding {} background(s) …", num_segments);
+        }
+        let backgrounds: Vec<&RgbaImage> = segments.iter().map(|seg| &seg.background).collect();
+        let encoded_backgrounds = parallel_map(&backgrounds, n_threads, |bg| {
+            let data = avif_encoder::encode_avif_auto(bg, config.quality, config.use_ffmpeg)?;
+            Ok(((AssetCodec::Avif, data), tier_encoder::encode_low_tier(bg, &config)?))
+        })?;
+        for (seg, (encoded, low)) in segments.iter().zip(encoded_backgrounds) {
+            let bg_id = out.push_asset(width, height, encoded, low);
 
             let scene_start_ms = (seg.start_frame as f64 * ms_per_frame) as u64;
             let scene_end_ms = if seg.end_frame == usize::MAX {
@@ -246,70 +308,66 @@ impl SceneAnalyzer {
             } else {
                 (seg.end_frame as f64 * ms_per_frame) as u64
             };
-            all_timeline.push(TimelineEntry::new(
-                next_asset_id, scene_start_ms, scene_end_ms, 0, 0, 0,
+            out.timeline.push(TimelineEntry::new(
+                bg_id, scene_start_ms, scene_end_ms, 0, 0, 0,
             ));
-            next_asset_id += 1;
         }
 
         // ── Stream frames, encoding in fixed-size chunks ──
         // Buffer: (global_frame_idx, segment_index, raw RGBA image)
-        let mut chunk: Vec<(usize, usize, RgbaImage)> = Vec::with_capacity(CHUNK_SIZE);
+        let mut chunk: Vec<(usize, usize, RgbaImage)> = Vec::with_capacity(chunk_size);
         let progress = ProgressTracker::new(estimated_frame_count, "Processing frames:");
+        let mut previews = config.preview.then(PreviewBuilder::new);
+
+        let streamed = reader.read_frames_streaming(|frame_idx, frame| {
+            if let Some(previews) = &mut previews {
+                previews.offer((frame_idx as f64 * ms_per_frame) as u64, &frame);
+            }
 
-        reader.read_frames_streaming(|frame_idx, frame| {
             // Find the segment this frame belongs to
             for (seg_idx, seg) in segments.iter().enumerate() {
                 if frame_idx >= seg.start_frame && frame_idx < seg.end_frame {
                     // First frame of each segment is the background – already encoded
                     if frame_idx != seg.start_frame {
                         chunk.push((frame_idx, seg_idx, frame));
+                        metrics::global().add_queue_depth(1);
                     }
                     break;
                 }
             }
 
             // Flush the chunk when full
-            if chunk.len() >= CHUNK_SIZE {
-                flush_chunk(
-                    &mut chunk,
-                    &segments,
-                    &config,
-                    quality,
-                    use_ffmpeg,
-                    ms_per_frame,
-                    n_threads,
-                    &mut all_assets,
-                    &mut all_timeline,
-                    &mut next_asset_id,
-                )?;
+            if chunk.len() >= chunk_size {
+                flush_chunk(&mut chunk, &segments, &config, ms_per_frame, n_threads, &mut out)?;
             }
 
-            progress.increment_and_report(100);
+            if self.verbose {
+                progress.increment_and_report(100);
+            }
             Ok(())
-        })?;
+        });
+
+        // Flush any remaining frames; those a failed read or flush leaves
+        // behind are dropped with the chunk, so stop counting them
+        let flushed =
+            streamed.and_then(|_| flush_chunk(&mut chunk, &segments, &config, ms_per_frame, n_threads, &mut out));
+        metrics::global().sub_queue_depth(chunk.len() as u64);
+        flushed?;
 
-        // Flush any remaining frames
-        if !chunk.is_empty() {
-            flush_chunk(
-                &mut chunk,
-                &segments,
-                &config,
-                quality,
-                use_ffmpeg,
-                ms_per_frame,
-                n_threads,
-                &mut all_assets,
-                &mut all_timeline,
-                &mut next_asset_id,
-            )?;
+        if let Some(previews) = previews {
+            encode_previews(previews.finish(), &config, n_threads, &mut out)?;
         }
 
-        println!(
-            "  Total: {} assets, {} timeline entries",
-            all_assets.len(),
-            all_timeline.len()
-        );
+        if self.verbose {
+            println!(
+                "  Total: {} assets ({} reduced tiers), {} atlas slices, {} timeline entries, {} previews",
+                out.assets.len(),
+                out.tiers.len(),
+                out.slices.len(),
+                out.timeline.len(),
+                out.previews.len()
+            );
+        }
 
         let header = VaiHeader::new(
             width,
@@ -317,11 +375,14 @@ impl SceneAnalyzer {
             fps_num,
             fps_den,
             duration_ms,
-            all_assets.len() as u32,
-            all_timeline.len() as u32,
+            out.assets.len() as u32,
+            out.timeline.len() as u32,
         );
 
-        Ok(VaiContainer::new(header, all_assets, all_timeline))
+        Ok(VaiContainer::new(header, out.assets, out.timeline)
+            .with_slices(out.slices)
+            .with_tiers(out.tiers)
+            .with_previews(out.previews))
     }
 
     /// Finds regions that differ from the background
@@ -339,91 +400,387 @@ impl SceneAnalyzer {
     }
 }
 
+/// Everything the chunked encoder has produced so far
+#[derive(Default)]
+struct EncodedOutput {
+    assets: Vec<Asset>,
+    timeline: Vec<TimelineEntry>,
+    slices: Vec<AssetSlice>,
+    tiers: Vec<AssetTier>,
+    previews: Vec<PreviewFrame>,
+    next_asset_id: u32,
+}
+
+impl EncodedOutput {
+    /// Reserves the next asset/slice ID
+    fn next_id(&mut self) -> u32 {
+        let id = self.next_asset_id;
+        self.next_asset_id += 1;
+        id
+    }
+
+    /// Adds an encoded asset (plus its reduced tier, if any) and returns its ID
+    fn push_asset(
+        &mut self,
+        width: u32,
+        height: u32,
+        (codec, data): (AssetCodec, Vec<u8>),
+        low_tier: Option<tier_encoder::EncodedTier>,
+    ) -> u32 {
+        let id = self.next_id();
+        self.assets.push(Asset::with_codec(id, width, height, codec, data));
+
+        if let Some((tw, th, tier_codec, tier_data)) = low_tier {
+            let tier_id = self.next_id();
+            self.assets.push(Asset::with_codec(tier_id, tw, th, tier_codec, tier_data));
+            self.tiers.push(AssetTier::new(id, 1, tier_id));
+        }
+        id
+    }
+}
+
+/// Shortest run of frames worth storing as an AV1 track
+const MIN_TRACK_FRAMES: usize = 8;
+
+/// A track stops growing once its bounding rectangle exceeds this multiple
+/// of its largest region, so one track never covers the whole frame
+const MAX_TRACK_GROWTH: u64 = 2;
+
+/// A diff region found in one buffered frame
+struct Region {
+    frame_idx: usize,
+    /// Position of the source frame in the chunk buffer
+    chunk_pos: usize,
+    seg_idx: usize,
+    x: u32,
+    y: u32,
+    image: RgbaImage,
+}
+
+impl Region {
+    fn rect(&self) -> (u32, u32, u32, u32) {
+        (self.x, self.y, self.image.width(), self.image.height())
+    }
+}
+
+/// A run of regions stored as one AV1 track over a fixed rectangle
+struct Track {
+    regions: std::ops::Range<usize>,
+    rect: (u32, u32, u32, u32),
+}
+
 /// Encodes a chunk of buffered raw frames in parallel, appends the compact
-/// AVIF results to the output vectors, then clears the buffer to free memory.
+/// encoded results to the output vectors, then clears the buffer to free memory.
+///
+/// Runs in phases: diff every frame against its background (parallel), group
+/// regions that persist across consecutive frames into AV1 tracks when
+/// `config.tracks` is set, pack small leftover regions into atlases when
+/// `config.atlas` is set, then encode tracks, atlases and standalone sprites
+/// (parallel).
 fn flush_chunk(
     chunk: &mut Vec<(usize, usize, RgbaImage)>,
     segments: &[SceneSegment],
     config: &EncoderConfig,
-    quality: u8,
-    use_ffmpeg: bool,
     ms_per_frame: f64,
     n_threads: usize,
-    all_assets: &mut Vec<Asset>,
-    all_timeline: &mut Vec<TimelineEntry>,
-    next_asset_id: &mut u32,
+    out: &mut EncodedOutput,
 ) -> crate::Result<()> {
     if chunk.is_empty() {
         return Ok(());
     }
+    let started = Instant::now();
+    let frames = chunk.len() as u64;
+
+    // ── Phase 1: diff regions, in frame order ──
+    let positions: Vec<usize> = (0..chunk.len()).collect();
+    let regions: Vec<Region> = parallel_map(&positions, n_threads, |&chunk_pos| {
+        let (frame_idx, seg_idx, frame) = &chunk[chunk_pos];
+        let bg = &segments[*seg_idx].background;
+        Ok(find_diff_regions(config, bg, frame)
+            .into_iter()
+            .map(|(x, y, image)| Region {
+                frame_idx: *frame_idx,
+                chunk_pos,
+                seg_idx: *seg_idx,
+                x,
+                y,
+                image,
+            })
+            .collect::<Vec<_>>())
+    })?
+    .into_iter()
+    .flatten()
+    .collect();
+
+    // ── Phase 2: tracks over persistent regions ──
+    let tracks = if tracks_enabled(config) {
+        find_tracks(&regions)
+    } else {
+        Vec::new()
+    };
+    let mut in_track = vec![false; regions.len()];
+    let track_frames: Vec<Vec<RgbaImage>> = tracks
+        .iter()
+        .map(|track| {
+            let (x, y, w, h) = track.rect;
+            track
+                .regions
+                .clone()
+                .map(|i| {
+                    in_track[i] = true;
+                    crop(&chunk[regions[i].chunk_pos].2, x, y, w, h)
+                })
+                .collect()
+        })
+        .collect();
+
+    // Raw frames are no longer needed
+    metrics::global().sub_queue_depth(chunk.len() as u64);
+    chunk.clear();
+
+    // ── Phase 3: pack small leftover regions into atlases ──
+    let atlas_candidates: Vec<usize> = if config.atlas {
+        (0..regions.len())
+            .filter(|&i| {
+                let img = &regions[i].image;
+                !in_track[i] && img.width() as u64 * img.height() as u64 <= config.sprite_max_area as u64
+            })
+            .collect()
+    } else {
+        Vec::new()
+    };
+    let candidate_images: Vec<&RgbaImage> = atlas_candidates.iter().map(|&i| &regions[i].image).collect();
+    let atlases = atlas_packer::pack_atlases(&candidate_images);
+
+    // Region index → (atlas index, x, y) for packed regions
+    let mut packed: Vec<Option<(usize, u32, u32)>> = vec![None; regions.len()];
+    for (atlas_idx, atlas) in atlases.iter().enumerate() {
+        for &(candidate, x, y) in &atlas.placements {
+            packed[atlas_candidates[candidate]] = Some((atlas_idx, x, y));
+        }
+    }
 
-    // Each thread will produce a list of encoded regions.
-    type RegionResult = (usize, u32, u32, u32, u32, Vec<u8>); // (frame_idx, x, y, w, h, avif_data)
+    // ── Phase 4: encode tracks, atlases and standalone regions ──
+    let encoded_tracks = parallel_map(&track_frames, n_threads, |frames| {
+        let units = ffmpeg_encoder::encode_av1_sequence(frames, config.quality)?;
+        Ok(track::write_track(&units))
+    })?;
+    drop(track_frames);
+
+    let standalone: Vec<usize> = (0..regions.len())
+        .filter(|&i| !in_track[i] && packed[i].is_none())
+        .collect();
+    let images: Vec<&RgbaImage> = atlases
+        .iter()
+        .map(|a| &a.image)
+        .chain(standalone.iter().map(|&i| &regions[i].image))
+        .collect();
+    let mut encoded = parallel_map(&images, n_threads, |img| {
+        Ok((sprite_encoder::encode_sprite(img, config)?, tier_encoder::encode_low_tier(img, config)?))
+    })?
+    .into_iter();
+
+    // Assign IDs: tracks, atlases, their slices, then standalone sprites.
+    // Each region gets (asset id, x, y, track frame index).
+    let mut placements = vec![(0u32, 0u32, 0u32, 0u32); regions.len()];
+    for (track, data) in tracks.iter().zip(encoded_tracks) {
+        let (x, y, w, h) = track.rect;
+        let id = out.push_asset(w, h, (AssetCodec::Av1Track, data), None);
+        for (frame, i) in track.regions.clone().enumerate() {
+            placements[i] = (id, x, y, frame as u32);
+        }
+    }
+    let mut atlas_ids = Vec::with_capacity(atlases.len());
+    for atlas in &atlases {
+        let (encoded, low) = encoded.next().expect("one encoding per image");
+        let (w, h) = atlas.image.dimensions();
+        atlas_ids.push(out.push_asset(w, h, encoded, low));
+    }
+    for (i, slot) in packed.iter().enumerate() {
+        if let Some((atlas_idx, x, y)) = *slot {
+            let region = &regions[i];
+            let id = out.next_id();
+            out.slices.push(AssetSlice::new(
+                id,
+                atlas_ids[atlas_idx],
+                x,
+                y,
+                region.image.width(),
+                region.image.height(),
+            ));
+            placements[i] = (id, region.x, region.y, 0);
+        }
+    }
+    for (&i, (encoded, low)) in standalone.iter().zip(encoded) {
+        let region = &regions[i];
+        let (w, h) = region.image.dimensions();
+        let id = out.push_asset(w, h, encoded, low);
+        placements[i] = (id, region.x, region.y, 0);
+    }
+
+    for (region, (id, x, y, frame_index)) in regions.iter().zip(placements) {
+        let start_time = (region.frame_idx as f64 * ms_per_frame) as u64;
+        let end_time = start_time + ms_per_frame as u64;
+
+        out.timeline.push(
+            TimelineEntry::new(id, start_time, end_time, x as i32, y as i32, 1)
+                .with_frame_index(frame_index),
+        );
+    }
+
+    metrics::global().record(Stage::ChunkFlush, started.elapsed(), frames, 0);
+    Ok(())
+}
+
+/// Packs preview thumbnails into atlases and adds them as slices
+fn encode_previews(
+    thumbnails: Vec<(u64, RgbaImage)>,
+    config: &EncoderConfig,
+    n_threads: usize,
+    out: &mut EncodedOutput,
+) -> crate::Result<()> {
+    let images: Vec<&RgbaImage> = thumbnails.iter().map(|(_, image)| image).collect();
+    let atlases = atlas_packer::pack_atlases(&images);
+    let encoded = parallel_map(&atlases, n_threads, |atlas| {
+        avif_encoder::encode_avif_auto(&atlas.image, config.quality, config.use_ffmpeg)
+    })?;
+
+    for (atlas, data) in atlases.iter().zip(encoded) {
+        let (w, h) = atlas.image.dimensions();
+        let atlas_id = out.push_asset(w, h, (AssetCodec::Avif, data), None);
+        for &(i, x, y) in &atlas.placements {
+            let (timestamp_ms, image) = &thumbnails[i];
+            let id = out.next_id();
+            out.slices.push(AssetSlice::new(id, atlas_id, x, y, image.width(), image.height()));
+            out.previews.push(PreviewFrame::new(*timestamp_ms, id));
+        }
+    }
+
+    Ok(())
+}
+
+/// Tracks need an FFmpeg AV1 encoder; ravif only encodes stills
+fn tracks_enabled(config: &EncoderConfig) -> bool {
+    config.tracks && config.use_ffmpeg && ffmpeg_encoder::is_available()
+}
+
+/// Groups runs of overlapping regions in consecutive frames of one segment
+/// into tracks.  Regions are in frame order with at most one per frame.
+fn find_tracks(regions: &[Region]) -> Vec<Track> {
+    let mut tracks = Vec::new();
+    let mut start = 0;
+
+    while start < regions.len() {
+        let mut rect = regions[start].rect();
+        let mut largest = area(rect);
+        let mut end = start + 1;
+
+        while end < regions.len() {
+            let (prev, next) = (&regions[end - 1], &regions[end]);
+            if next.frame_idx != prev.frame_idx + 1
+                || next.seg_idx != prev.seg_idx
+                || !overlaps(prev.rect(), next.rect())
+            {
+                break;
+            }
+            let grown = union(rect, next.rect());
+            let grown_largest = largest.max(area(next.rect()));
+            if area(grown) > MAX_TRACK_GROWTH * grown_largest {
+                break;
+            }
+            rect = grown;
+            largest = grown_largest;
+            end += 1;
+        }
+
+        if end - start >= MIN_TRACK_FRAMES {
+            tracks.push(Track { regions: start..end, rect });
+        }
+        start = end;
+    }
+
+    tracks
+}
 
-    let per_thread = (chunk.len() + n_threads - 1) / n_threads;
+fn area((_, _, w, h): (u32, u32, u32, u32)) -> u64 {
+    w as u64 * h as u64
+}
+
+fn overlaps(a: (u32, u32, u32, u32), b: (u32, u32, u32, u32)) -> bool {
+    a.0 < b.0 + b.2 && b.0 < a.0 + a.2 && a.1 < b.1 + b.3 && b.1 < a.1 + a.3
+}
 
-    let results: Vec<crate::Result<Vec<RegionResult>>> = thread::scope(|scope| {
-        let handles: Vec<_> = chunk
+fn union(a: (u32, u32, u32, u32), b: (u32, u32, u32, u32)) -> (u32, u32, u32, u32) {
+    let x = a.0.min(b.0);
+    let y = a.1.min(b.1);
+    let right = (a.0 + a.2).max(b.0 + b.2);
+    let bottom = (a.1 + a.3).max(b.1 + b.3);
+    (x, y, right - x, bottom - y)
+}
+
+/// Copies a rectangle out of a frame
+fn crop(frame: &RgbaImage, x: u32, y: u32, width: u32, height: u32) -> RgbaImage {
+    let stride = frame.width() as usize * 4;
+    let row_bytes = width as usize * 4;
+    let src = frame.as_raw();
+    let mut data = Vec::with_capacity(row_bytes * height as usize);
+    for row in y as usize..(y + height) as usize {
+        data.extend_from_slice(&src[row * stride + x as usize * 4..][..row_bytes]);
+    }
+    RgbaImage::from_raw(width, height, data).unwrap()
+}
+
+/// Applies `f` to `items` across up to `n_threads` scoped threads, returning
+/// the outputs in input order.
+fn parallel_map<T: Sync, R: Send>(
+    items: &[T],
+    n_threads: usize,
+    f: impl Fn(&T) -> crate::Result<R> + Sync,
+) -> crate::Result<Vec<R>> {
+    if items.is_empty() {
+        return Ok(Vec::new());
+    }
+    let per_thread = (items.len() + n_threads - 1) / n_threads;
+    let f = &f;
+
+    let started = Instant::now();
+    let results: Vec<(crate::Result<Vec<R>>, Duration)> = thread::scope(|scope| {
+        let handles: Vec<_> = items
             .chunks(per_thread)
             .map(|sub| {
-                scope.spawn(move || -> crate::Result<Vec<RegionResult>> {
-                    let mut thread_results = Vec::new();
-                    for (frame_idx, seg_idx, frame) in sub {
-                        let bg = &segments[*seg_idx].background;
-                        let diff_regions = find_diff_regions(config, bg, frame);
-                        for (x, y, region_img) in diff_regions {
-                            let data = avif_encoder::encode_avif_auto(&region_img, quality, use_ffmpeg)?;
-                            thread_results.push((
-                                *frame_idx,
-                                x,
-                                y,
-                                region_img.width(),
-                                region_img.height(),
-                                data,
-                            ));
-                        }
-                    }
-                    Ok(thread_results)
+                scope.spawn(move || {
+                    let busy = Instant::now();
+                    (sub.iter().map(f).collect(), busy.elapsed())
                 })
             })
             .collect();
 
         handles.into_iter().map(|h| h.join().unwrap()).collect()
     });
+    let busy = results.iter().map(|(_, busy)| *busy).sum();
+    metrics::global().record_workers(n_threads, started.elapsed(), busy);
 
-    // Collect the compact results and assign asset IDs
-    for result in results {
-        let regions = result?;
-        for (frame_idx, x, y, rw, rh, data) in regions {
-            all_assets.push(Asset::new(*next_asset_id, rw, rh, data));
-
-            let start_time = (frame_idx as f64 * ms_per_frame) as u64;
-            let end_time = start_time + ms_per_frame as u64;
-
-            all_timeline.push(TimelineEntry::new(
-                *next_asset_id,
-                start_time,
-                end_time,
-                x as i32,
-                y as i32,
-                1,
-            ));
-
-            *next_asset_id += 1;
-        }
+    let mut out = Vec::with_capacity(items.len());
+    for (result, _) in results {
+        out.extend(result?);
     }
-
-    // Free all raw frames
-    chunk.clear();
-    Ok(())
+    Ok(out)
 }
 
-/// Finds regions that differ from the background (free function for use in closures)
-fn find_diff_regions(
+/// Finds regions that differ from the background, as (x, y, cropped image).
+/// A free function for use in closures; public for the benchmarks.
+pub fn find_diff_regions(
     config: &EncoderConfig,
     background: &RgbaImage,
     frame: &RgbaImage,
 ) -> Vec<(u32, u32, RgbaImage)> {
+    let started = Instant::now();
+    let regions = diff_regions(config, background, frame);
+    metrics::global().record(Stage::Diff, started.elapsed(), 1, frame.as_raw().len() as u64);
+    regions
+}
+
+fn diff_regions(config: &EncoderConfig, background: &RgbaImage, frame: &RgbaImage) -> Vec<(u32, u32, RgbaImage)> {
     let width = background.width();
     let height = background.height();
 
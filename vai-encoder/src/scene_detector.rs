@@ -4,8 +4,10 @@
 //! This produces a list of `SceneSegment`s, each with a background frame
 //! and a time range. The segments can then be encoded in parallel.
 
-use crate::{Result, VideoReader};
+use crate::metrics::{self, Stage};
+use crate::{FrameSource, Result};
 use image::{Rgba, RgbaImage};
+use std::time::Instant;
 
 /// A detected scene segment with its background and frame range
 #[derive(Debug, Clone)]
@@ -32,6 +34,8 @@ pub struct SceneDetectorConfig {
     pub pixel_threshold: u8,
     /// Fraction of pixels that must differ to trigger a scene change (0.0 - 1.0)
     pub scene_change_ratio: f64,
+    /// Print scanning progress to stdout
+    pub verbose: bool,
 }
 
 impl Default for SceneDetectorConfig {
@@ -39,6 +43,7 @@ impl Default for SceneDetectorConfig {
         Self {
             pixel_threshold: 40,
             scene_change_ratio: 0.35,
+            verbose: true,
         }
     }
 }
@@ -48,7 +53,7 @@ impl Default for SceneDetectorConfig {
 /// This is the *first pass*: it reads every frame but only keeps the background
 /// images and the frame indices where scene changes occur.
 pub fn detect_scenes(
-    reader: &mut VideoReader,
+    reader: &mut impl FrameSource,
     config: &SceneDetectorConfig,
 ) -> Result<Vec<SceneSegment>> {
     let mut segments: Vec<SceneSegment> = Vec::new();
@@ -66,7 +71,9 @@ pub fn detect_scenes(
                 scene_start = 0;
             }
             Some(ref bg) => {
+                let started = Instant::now();
                 let changed_ratio = compute_change_ratio(bg, &frame, pixel_threshold);
+                metrics::global().record(Stage::SceneDetect, started.elapsed(), 1, frame.as_raw().len() as u64);
 
                 if changed_ratio >= scene_change_ratio {
                     // Scene change detected – close the current segment
@@ -82,7 +89,7 @@ pub fn detect_scenes(
             }
         }
 
-        if (frame_idx + 1) % 200 == 0 {
+        if config.verbose && (frame_idx + 1) % 200 == 0 {
             println!(
                 "  Scene detection: scanned {} frames, {} scenes so far",
                 frame_idx + 1,
@@ -108,7 +115,7 @@ pub fn detect_scenes(
 }
 
 /// Computes the fraction of pixels that differ beyond `threshold`.
-fn compute_change_ratio(a: &RgbaImage, b: &RgbaImage, threshold: u8) -> f64 {
+pub fn compute_change_ratio(a: &RgbaImage, b: &RgbaImage, threshold: u8) -> f64 {
     let width = a.width().min(b.width());
     let height = a.height().min(b.height());
     let total = (width as u64) * (height as u64);
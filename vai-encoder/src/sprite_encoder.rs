@@ -0,0 +1,56 @@
+//! Fast-decode codecs for small sprites
+//!
+//! Per-image AV1 is a poor fit for small regions: the AVIF boxes and decoder
+//! setup cost more than the pixels, and the FFmpeg encoders refuse anything
+//! under 64×64.  Sprites that fall under the size/area rule are stored as
+//! raw, zstd, LZ4 or QOI RGBA instead, which decode in microseconds.
+
+use crate::metrics::{self, Stage};
+use crate::{avif_encoder, EncoderConfig, Error, Result};
+use image::RgbaImage;
+use std::time::Instant;
+use vai_core::AssetCodec;
+
+/// zstd level for sprite payloads; decode speed is level-independent
+const ZSTD_LEVEL: i32 = 3;
+
+/// Sprites thinner than this in either dimension never go through AV1
+const MIN_AV1_DIMENSION: u32 = 16;
+
+/// Picks the codec for a sprite of the given size
+pub fn choose_codec(width: u32, height: u32, config: &EncoderConfig) -> AssetCodec {
+    let small = width as u64 * height as u64 <= config.sprite_max_area as u64
+        || width.min(height) < MIN_AV1_DIMENSION;
+    if small {
+        config.sprite_codec
+    } else {
+        AssetCodec::Avif
+    }
+}
+
+/// Encodes a sprite with the codec chosen by [`choose_codec`]
+pub fn encode_sprite(image: &RgbaImage, config: &EncoderConfig) -> Result<(AssetCodec, Vec<u8>)> {
+    let codec = choose_codec(image.width(), image.height(), config);
+    let data = encode_with(image, codec, config)?;
+    Ok((codec, data))
+}
+
+/// Encodes an image with a specific codec
+pub fn encode_with(image: &RgbaImage, codec: AssetCodec, config: &EncoderConfig) -> Result<Vec<u8>> {
+    let pixels = image.as_raw();
+    let started = Instant::now();
+    let data = match codec {
+        AssetCodec::Avif => return avif_encoder::encode_avif_auto(image, config.quality, config.use_ffmpeg),
+        AssetCodec::Raw => Ok(pixels.clone()),
+        AssetCodec::Zstd => zstd::bulk::compress(pixels, ZSTD_LEVEL)
+            .map_err(|e| Error::SpriteEncode(format!("zstd: {e}"))),
+        AssetCodec::Lz4 => Ok(lz4_flex::compress_prepend_size(pixels)),
+        AssetCodec::Qoi => qoi::encode_to_vec(pixels, image.width(), image.height())
+            .map_err(|e| Error::SpriteEncode(format!("qoi: {e}"))),
+        AssetCodec::Av1Track => Err(Error::SpriteEncode(
+            "tracks are encoded from frame sequences".into(),
+        )),
+    }?;
+    metrics::global().record(Stage::SpriteEncode, started.elapsed(), 1, data.len() as u64);
+    Ok(data)
+}
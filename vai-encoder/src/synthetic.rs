@@ -0,0 +1,374 @@
+//! Deterministic synthetic video
+//!
+//! Encoder tests and benchmarks need content with known structure: how many
+//! scenes there are, how much of each frame moves, how noisy it is.  Real
+//! clips hide that, depend on FFmpeg and are too large to check in.
+//! `SyntheticVideo` renders frames from a [`SyntheticConfig`] instead: a
+//! textured background, sprites moving across it, slow lighting drift, hard
+//! cuts, sensor noise and screen-recording style UI updates.  Every frame is
+//! a pure function of the config and its index, so the same seed gives the
+//! same bytes on every machine, and the video is a [`FrameSource`] the
+//! encoder passes read directly.
+
+use crate::{FrameSource, Result};
+use image::{Rgba, RgbaImage};
+
+/// Content presets, each stressing one part of the encoder
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Preset {
+    /// Static background with moving sprites
+    Sprites,
+    /// Sprites under slowly changing lighting
+    Drift,
+    /// Sprites with a hard cut every two seconds
+    Cuts,
+    /// Sprites with per-pixel sensor noise
+    Noise,
+    /// Screen recording: toolbar, typed text and a popup that opens and closes
+    Screen,
+}
+
+/// What to generate
+#[derive(Debug, Clone)]
+pub struct SyntheticConfig {
+    pub width: u32,
+    pub height: u32,
+    pub fps_num: u32,
+    pub fps_den: u32,
+    /// Frames in the video
+    pub frames: u32,
+    /// Seeds the background, sprite paths and noise
+    pub seed: u64,
+    /// Moving sprites
+    pub sprites: u32,
+    /// Sprite edge length in pixels
+    pub sprite_size: u32,
+    /// Peak lighting change as a fraction of brightness (0.0 = none); one
+    /// full cycle takes ten seconds
+    pub drift: f32,
+    /// Start a new scene every this many frames
+    pub cut_every: Option<u32>,
+    /// Peak per-channel sensor noise
+    pub noise: u8,
+    /// Draw screen-recording style UI on top
+    pub ui: bool,
+}
+
+impl Default for SyntheticConfig {
+    fn default() -> Self {
+        Self {
+            width: 640,
+            height: 360,
+            fps_num: 30,
+            fps_den: 1,
+            frames: 150,
+            seed: 1,
+            sprites: 4,
+            sprite_size: 48,
+            drift: 0.0,
+            cut_every: None,
+            noise: 0,
+            ui: false,
+        }
+    }
+}
+
+impl SyntheticConfig {
+    /// Default geometry with the content of `preset`
+    pub fn preset(preset: Preset) -> Self {
+        Self::default().with_preset(preset)
+    }
+
+    /// This geometry and frame rate with the content of `preset`; cuts are
+    /// timed from the frame rate, so set it first
+    pub fn with_preset(self, preset: Preset) -> Self {
+        let base = self;
+        match preset {
+            Preset::Sprites => base,
+            Preset::Drift => Self { drift: 0.15, ..base },
+            Preset::Cuts => Self {
+                cut_every: Some(2 * base.fps_num / base.fps_den),
+                ..base
+            },
+            Preset::Noise => Self { noise: 6, ..base },
+            Preset::Screen => Self {
+                sprites: 1,
+                sprite_size: 16,
+                ui: true,
+                ..base
+            },
+        }
+    }
+
+    /// Duration covered by `frames`, in milliseconds
+    pub fn duration_ms(&self) -> u64 {
+        self.frames as u64 * 1000 * self.fps_den as u64 / self.fps_num as u64
+    }
+}
+
+/// A sprite's colour and straight-line path, bouncing off the frame edges
+struct Sprite {
+    color: [u8; 3],
+    x: u32,
+    y: u32,
+    dx: i32,
+    dy: i32,
+}
+
+/// Video generated from a [`SyntheticConfig`]
+pub struct SyntheticVideo {
+    config: SyntheticConfig,
+}
+
+impl SyntheticVideo {
+    pub fn new(config: SyntheticConfig) -> Self {
+        Self { config }
+    }
+
+    pub fn config(&self) -> &SyntheticConfig {
+        &self.config
+    }
+
+    /// Scene that frame `index` belongs to
+    pub fn scene(&self, index: u32) -> u32 {
+        self.config.cut_every.map_or(0, |n| index / n.max(1))
+    }
+
+    /// Renders frame `index`
+    pub fn frame(&self, index: u32) -> RgbaImage {
+        let c = &self.config;
+        let scene = self.scene(index) as u64;
+        let scene_seed = mix(c.seed ^ scene.wrapping_mul(0x9E37_79B9_7F4A_7C15));
+
+        let mut image = background(c.width, c.height, scene_seed, scene % 2 == 1);
+        for sprite in self.sprites(scene_seed) {
+            draw_sprite(&mut image, &sprite, index, c.sprite_size);
+        }
+        if c.ui {
+            draw_ui(&mut image, index, scene_seed);
+        }
+
+        if c.drift > 0.0 {
+            let t = index as f32 * c.fps_den as f32 / c.fps_num as f32;
+            let gain = 1.0 + c.drift * (t * std::f32::consts::TAU / 10.0).sin();
+            for p in image.pixels_mut() {
+                for ch in &mut p.0[..3] {
+                    *ch = (*ch as f32 * gain).round().clamp(0.0, 255.0) as u8;
+                }
+            }
+        }
+
+        if c.noise > 0 {
+            let span = 2 * c.noise as u64 + 1;
+            let frame_seed = mix(c.seed ^ ((index as u64) << 32));
+            for (i, p) in image.pixels_mut().enumerate() {
+                let h = mix(frame_seed ^ i as u64);
+                for (ch, bits) in p.0[..3].iter_mut().zip([0, 16, 32]) {
+                    let offset = ((h >> bits) & 0xFFFF) % span;
+                    *ch = (*ch as i32 + offset as i32 - c.noise as i32).clamp(0, 255) as u8;
+                }
+            }
+        }
+        image
+    }
+
+    fn sprites(&self, scene_seed: u64) -> Vec<Sprite> {
+        let c = &self.config;
+        let size = c.sprite_size.min(c.width).min(c.height);
+        (0..c.sprites as u64)
+            .map(|i| {
+                let h = mix(scene_seed ^ (i + 1).wrapping_mul(0xD1B5_4A32_D192_ED03));
+                let speed = |bits: u32| ((h >> bits) % 7) as i32 - 3;
+                Sprite {
+                    color: [(h >> 8) as u8 | 0x40, (h >> 16) as u8 | 0x40, (h >> 24) as u8 | 0x40],
+                    x: (h >> 32) as u32 % (c.width - size + 1),
+                    y: (h >> 44) as u32 % (c.height - size + 1),
+                    dx: speed(52).max(1) * 2,
+                    dy: speed(56),
+                }
+            })
+            .collect()
+    }
+}
+
+impl FrameSource for SyntheticVideo {
+    fn width(&self) -> u32 {
+        self.config.width
+    }
+
+    fn height(&self) -> u32 {
+        self.config.height
+    }
+
+    fn frame_rate(&self) -> (u32, u32) {
+        (self.config.fps_num, self.config.fps_den)
+    }
+
+    fn duration_ms(&self) -> u64 {
+        self.config.duration_ms()
+    }
+
+    fn read_frames_streaming<F>(&mut self, mut callback: F) -> Result<()>
+    where
+        F: FnMut(usize, RgbaImage) -> Result<()>,
+    {
+        for index in 0..self.config.frames {
+            callback(index as usize, self.frame(index))?;
+        }
+        Ok(())
+    }
+}
+
+/// splitmix64 finaliser
+fn mix(mut x: u64) -> u64 {
+    x = (x ^ (x >> 30)).wrapping_mul(0xBF58_476D_1CE4_E5B9);
+    x = (x ^ (x >> 27)).wrapping_mul(0x94D0_49BB_1331_11EB);
+    x ^ (x >> 31)
+}
+
+/// Diagonal gradient overlaid with 16×16 tiles of varying shade, so the
+/// background has edges to match against but still compresses.  Scenes
+/// alternate between dark and bright palettes so every cut is unmistakable.
+fn background(width: u32, height: u32, seed: u64, bright: bool) -> RgbaImage {
+    let lift = if bright { 128 } else { 0 };
+    let base = [8, 16, 24].map(|bits| (seed >> bits) as u8 % 32 + lift);
+    RgbaImage::from_fn(width, height, |x, y| {
+        let tile = mix(seed ^ (((x / 16) as u64) << 20) ^ (y / 16) as u64);
+        let ramp = ((x + y) * 64 / (width + height).max(1)) as u8;
+        let shade = (tile & 0x0F) as u8;
+        Rgba([
+            base[0] + ramp + shade,
+            base[1] + ramp / 2 + shade,
+            base[2] + (63 - ramp) + shade,
+            255,
+        ])
+    })
+}
+
+/// Position along a path that bounces between 0 and `span`
+fn bounce(start: u32, velocity: i32, index: u32, span: u32) -> u32 {
+    if span == 0 {
+        return 0;
+    }
+    let period = 2 * span as i64;
+    let p = (start as i64 + velocity as i64 * index as i64).rem_euclid(period);
+    (if p > span as i64 { period - p } else { p }) as u32
+}
+
+fn draw_sprite(image: &mut RgbaImage, sprite: &Sprite, index: u32, size: u32) {
+    let size = size.min(image.width()).min(image.height());
+    let x0 = bounce(sprite.x, sprite.dx, index, image.width() - size);
+    let y0 = bounce(sprite.y, sprite.dy, index, image.height() - size);
+    let [r, g, b] = sprite.color;
+    for y in 0..size {
+        for x in 0..size {
+            // A darker border keeps the sprite's edges sharp
+            let edge = x < 2 || y < 2 || x + 2 >= size || y + 2 >= size;
+            let px = if edge { Rgba([r / 3, g / 3, b / 3, 255]) } else { Rgba([r, g, b, 255]) };
+            image.put_pixel(x0 + x, y0 + y, px);
+        }
+    }
+}
+
+fn fill(image: &mut RgbaImage, x: u32, y: u32, w: u32, h: u32, color: Rgba<u8>) {
+    for py in y..(y + h).min(image.height()) {
+        for px in x..(x + w).min(image.width()) {
+            image.put_pixel(px, py, color);
+        }
+    }
+}
+
+/// Toolbar, a line of text typed one glyph every three frames with a
+/// blinking cursor, and a popup open for every other second-and-a-half
+fn draw_ui(image: &mut RgbaImage, index: u32, seed: u64) {
+    let (width, height) = image.dimensions();
+    let bar = (height / 12).max(8);
+    fill(image, 0, 0, width, bar, Rgba([40, 44, 52, 255]));
+    for button in 0..4 {
+        fill(image, 6 + button * (bar + 4), 2, bar - 4, bar - 4, Rgba([90, 96, 110, 255]));
+    }
+
+    let glyph = (bar / 2).max(4);
+    let line_y = bar + glyph;
+    let columns = width.saturating_sub(16) / (glyph + 2);
+    let typed = (index / 3).min(columns);
+    for col in 0..typed {
+        // Glyph heights vary so consecutive characters differ
+        let h = glyph / 2 + (mix(seed ^ col as u64) % (glyph as u64 / 2 + 1)) as u32;
+        fill(image, 8 + col * (glyph + 2), line_y + glyph - h, glyph, h, Rgba([230, 230, 230, 255]));
+    }
+    if (index / 15) % 2 == 0 {
+        fill(image, 8 + typed * (glyph + 2), line_y, 2, glyph, Rgba([255, 255, 255, 255]));
+    }
+
+    if (index / 45) % 2 == 1 {
+        let (w, h) = (width / 3, height / 3);
+        fill(image, (width - w) / 2, (height - h) / 2, w, h, Rgba([245, 245, 245, 255]));
+        fill(image, (width - w) / 2, (height - h) / 2, w, bar, Rgba([60, 120, 200, 255]));
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::scene_detector::{detect_scenes, SceneDetectorConfig};
+
+    fn small(preset: Preset) -> SyntheticConfig {
+        SyntheticConfig {
+            width: 96,
+            height: 64,
+            frames: 40,
+            sprite_size: 12,
+            ..SyntheticConfig::preset(preset)
+        }
+    }
+
+    #[test]
+    fn test_frames_are_deterministic() {
+        for preset in [Preset::Sprites, Preset::Drift, Preset::Cuts, Preset::Noise, Preset::Screen] {
+            let a = SyntheticVideo::new(small(preset));
+            let b = SyntheticVideo::new(small(preset));
+            for index in [0, 1, 17, 39] {
+                assert_eq!(a.frame(index), b.frame(index), "{preset:?} frame {index}");
+            }
+            assert_ne!(a.frame(0), a.frame(1), "{preset:?} should change between frames");
+        }
+
+        let other = SyntheticVideo::new(SyntheticConfig {
+            seed: 2,
+            ..small(Preset::Sprites)
+        });
+        assert_ne!(other.frame(0), SyntheticVideo::new(small(Preset::Sprites)).frame(0));
+    }
+
+    #[test]
+    fn test_hard_cuts_start_new_scenes() {
+        let mut video = SyntheticVideo::new(SyntheticConfig {
+            cut_every: Some(10),
+            ..small(Preset::Cuts)
+        });
+        let segments = detect_scenes(&mut video, &SceneDetectorConfig::default()).unwrap();
+        let starts: Vec<usize> = segments.iter().map(|s| s.start_frame).collect();
+        assert_eq!(starts, vec![0, 10, 20, 30]);
+    }
+
+    #[test]
+    fn test_presets_fit_any_geometry_and_rate() {
+        let config = SyntheticConfig {
+            fps_num: 60,
+            ..SyntheticConfig::default()
+        };
+        assert_eq!(config.with_preset(Preset::Cuts).cut_every, Some(120));
+
+        // Narrower than the UI margins
+        let tiny = SyntheticConfig {
+            width: 8,
+            height: 6,
+            ..SyntheticConfig::preset(Preset::Screen)
+        };
+        let video = SyntheticVideo::new(tiny);
+        for index in [0, 50] {
+            assert_eq!(video.frame(index).dimensions(), (8, 6));
+        }
+    }
+}
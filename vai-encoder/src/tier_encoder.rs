@@ -0,0 +1,51 @@
+//! Reduced-resolution asset tiers for adaptive decode
+//!
+//! A tier asset holds the same picture at half resolution, so a player that
+//! falls behind can decode a quarter of the pixels and scale the result back
+//! up instead of stalling.
+
+use crate::{sprite_encoder, EncoderConfig, Result};
+use image::RgbaImage;
+use vai_core::AssetCodec;
+
+/// Assets smaller than this decode quickly enough without a tier
+const MIN_TIER_AREA: u64 = 128 * 128;
+
+/// An encoded reduced tier: `(width, height, codec, data)`
+pub type EncodedTier = (u32, u32, AssetCodec, Vec<u8>);
+
+/// Encodes the half-resolution tier of `image`, if tiers are enabled and the
+/// image is large enough to benefit
+pub fn encode_low_tier(image: &RgbaImage, config: &EncoderConfig) -> Result<Option<EncodedTier>> {
+    if !config.low_tier || (image.width() as u64 * image.height() as u64) < MIN_TIER_AREA {
+        return Ok(None);
+    }
+
+    let half = downscale_half(image);
+    let (codec, data) = sprite_encoder::encode_sprite(&half, config)?;
+    Ok(Some((half.width(), half.height(), codec, data)))
+}
+
+/// Halves both dimensions (rounding up) with a 2×2 box filter
+pub fn downscale_half(image: &RgbaImage) -> RgbaImage {
+    let (w, h) = (image.width() as usize, image.height() as usize);
+    let (hw, hh) = ((w + 1) / 2, (h + 1) / 2);
+    let src = image.as_raw();
+    let mut out = Vec::with_capacity(hw * hh * 4);
+
+    for y in 0..hh {
+        let (y0, y1) = (2 * y, (2 * y + 1).min(h - 1));
+        for x in 0..hw {
+            let (x0, x1) = (2 * x, (2 * x + 1).min(w - 1));
+            for c in 0..4 {
+                let sum = src[(y0 * w + x0) * 4 + c] as u32
+                    + src[(y0 * w + x1) * 4 + c] as u32
+                    + src[(y1 * w + x0) * 4 + c] as u32
+                    + src[(y1 * w + x1) * 4 + c] as u32;
+                out.push(((sum + 2) / 4) as u8);
+            }
+        }
+    }
+
+    RgbaImage::from_raw(hw as u32, hh as u32, out).unwrap()
+}
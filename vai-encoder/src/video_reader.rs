@@ -1,9 +1,11 @@
 //! Video reading and frame extraction using FFmpeg
 
+use crate::metrics::{self, Stage};
 use crate::{Error, Result};
 use ffmpeg_next as ffmpeg;
 use image::{ImageBuffer, Rgba};
 use std::sync::Once;
+use std::time::Instant;
 
 static FFMPEG_INIT: Once = Once::new();
 
@@ -160,35 +162,54 @@ impl VideoReader {
         } = self;
         let stream_idx = *video_stream_index;
 
+        let metrics = metrics::global();
         for (stream, packet) in input.packets() {
             if stream.index() != stream_idx {
                 continue;
             }
 
+            let started = Instant::now();
             decoder.send_packet(&packet)?;
+            metrics.record(Stage::Decode, started.elapsed(), 0, packet.size() as u64);
 
-            let mut decoded = ffmpeg::frame::Video::empty();
-            while decoder.receive_frame(&mut decoded).is_ok() {
-                if let Some(ref mut sc) = scaler {
-                    let img = Self::frame_to_rgba(sc, &decoded, width, height)?;
-                    callback(frame_index, img)?;
-                    frame_index += 1;
-                }
-            }
+            Self::drain(decoder, scaler, width, height, &mut frame_index, &mut callback)?;
         }
 
         // Flush decoder
         decoder.send_eof()?;
+        Self::drain(decoder, scaler, width, height, &mut frame_index, &mut callback)
+    }
+
+    /// Hands every frame the decoder has ready to `callback`, recording
+    /// decode and conversion time per frame
+    fn drain<F>(
+        decoder: &mut ffmpeg::codec::decoder::Video,
+        scaler: &mut Option<ffmpeg::software::scaling::Context>,
+        width: u32,
+        height: u32,
+        frame_index: &mut usize,
+        callback: &mut F,
+    ) -> Result<()>
+    where
+        F: FnMut(usize, ImageBuffer<Rgba<u8>, Vec<u8>>) -> Result<()>,
+    {
+        let metrics = metrics::global();
         let mut decoded = ffmpeg::frame::Video::empty();
-        while decoder.receive_frame(&mut decoded).is_ok() {
+        loop {
+            let started = Instant::now();
+            if decoder.receive_frame(&mut decoded).is_err() {
+                return Ok(());
+            }
+            metrics.record(Stage::Decode, started.elapsed(), 1, 0);
+
             if let Some(ref mut sc) = scaler {
+                let started = Instant::now();
                 let img = Self::frame_to_rgba(sc, &decoded, width, height)?;
-                callback(frame_index, img)?;
-                frame_index += 1;
+                metrics.record(Stage::Convert, started.elapsed(), 1, img.as_raw().len() as u64);
+                callback(*frame_index, img)?;
+                *frame_index += 1;
             }
         }
-
-        Ok(())
     }
 
     /// Reads all frames from the video into memory.
@@ -203,3 +224,28 @@ impl VideoReader {
         Ok(frames)
     }
 }
+
+impl crate::FrameSource for VideoReader {
+    fn width(&self) -> u32 {
+        VideoReader::width(self)
+    }
+
+    fn height(&self) -> u32 {
+        VideoReader::height(self)
+    }
+
+    fn frame_rate(&self) -> (u32, u32) {
+        VideoReader::frame_rate(self)
+    }
+
+    fn duration_ms(&self) -> u64 {
+        VideoReader::duration_ms(self)
+    }
+
+    fn read_frames_streaming<F>(&mut self, callback: F) -> Result<()>
+    where
+        F: FnMut(usize, ImageBuffer<Rgba<u8>, Vec<u8>>) -> Result<()>,
+    {
+        VideoReader::read_frames_streaming(self, callback)
+    }
+}
@@ -0,0 +1,608 @@
+/**
+ * Headless VLC host for the VAI demuxer.
+ *
+ * Stands in for libvlccore so vlc_shim.c can be exercised without a
+ * player: it implements the VLC symbols the shim uses (vlc_stream_*,
+ * vlc_interrupt_*, block_*, es_format_*, vlc_Log and an es_out_t), loads
+ * the built plugin, and drives Open, Demux and Control — including seeks —
+ * against a .vai file.  It reports per-frame demux latency percentiles, first-frame
+ * latency after seeks, and peak memory.  With -l it only loads the plugin,
+ * which fails if the shim uses a libvlccore symbol this file does not
+ * define: run that in CI whenever the shim changes.
+ *
+ * Build against the same VLC 3.0 plugin headers as the shim.  -rdynamic is
+ * what lets the plugin resolve the symbols defined here:
+ *
+ *   cc -O2 -rdynamic -I/usr/include/vlc/plugins host/vai_host.c -o vai-host -ldl
+ */
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64   /* the plugin is built for the ft64 ABI */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vlc/plugins/vlc_common.h>
+#include <vlc/plugins/vlc_plugin.h>
+#include <vlc/plugins/vlc_demux.h>
+#include <vlc/plugins/vlc_es.h>
+#include <vlc/plugins/vlc_es_out.h>
+#include <vlc/plugins/vlc_block.h>
+#include <vlc/plugins/vlc_stream.h>
+#include <vlc/plugins/vlc_interrupt.h>
+
+/* Module entry point exported by the plugin (see vlc_exports.map) */
+#define VAI_ENTRY "vlc_entry__3_0_0ft64"
+
+/* Frames demuxed after every seek, so warming is included in the run */
+#define FRAMES_AFTER_SEEK 8
+
+/* ── Callbacks registered by the module descriptor ── */
+typedef struct {
+    int         (*open)(vlc_object_t *);
+    void        (*close)(vlc_object_t *);
+    const char  *capability;
+    int          score;
+    int          config;       /* stands in for every module_config_t */
+} host_module_t;
+
+/* ── File-backed stream_t ── */
+typedef struct {
+    int       fd;
+    uint64_t  size;
+    uint64_t  pos;
+    bool      seekable;
+    uint8_t  *peek;
+    size_t    peek_size;
+} host_stream_t;
+
+/* ── What the demuxer sent to its es_out_t ── */
+struct es_out_id_t {
+    es_format_t fmt;
+};
+
+struct es_out_sys_t {
+    struct es_out_id_t es;
+    bool      added;
+    uint64_t  blocks;
+    uint64_t  bytes;
+    mtime_t   last_pts;
+    mtime_t   last_pcr;
+    uint64_t  pcr_regressions;
+};
+
+typedef struct {
+    double *values;
+    size_t  count;
+    size_t  capacity;
+} samples_t;
+
+/* ═════════════════════════════════════════════════════════════════════
+ *  libvlccore stand-ins resolved by the plugin
+ * ═════════════════════════════════════════════════════════════════════ */
+void vlc_vaLog(vlc_object_t *obj, int prio, const char *module,
+               const char *file, unsigned line, const char *func,
+               const char *format, va_list ap)
+{
+    static const char *const levels[] = { "info", "error", "warning", "debug" };
+    (void)obj; (void)file; (void)line; (void)func;
+
+    const char *level = (prio >= 0 && prio < 4) ? levels[prio] : "log";
+    fprintf(stderr, "[%s] %s: ", module ? module : "vai", level);
+    vfprintf(stderr, format, ap);
+    fputc('\n', stderr);
+}
+
+void vlc_Log(vlc_object_t *obj, int prio, const char *module,
+             const char *file, unsigned line, const char *func,
+             const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    vlc_vaLog(obj, prio, module, file, line, func, format, ap);
+    va_end(ap);
+}
+
+/* Interrupt contexts: once killed, reads on the thread that set the
+ * context fail, as libvlccore's interruptible I/O does */
+struct vlc_interrupt {
+    atomic_bool killed;
+};
+
+static _Thread_local vlc_interrupt_t *current_interrupt;
+
+vlc_interrupt_t *vlc_interrupt_create(void)
+{
+    vlc_interrupt_t *ctx = malloc(sizeof(*ctx));
+    if (ctx)
+        atomic_init(&ctx->killed, false);
+    return ctx;
+}
+
+void vlc_interrupt_destroy(vlc_interrupt_t *ctx)
+{
+    free(ctx);
+}
+
+vlc_interrupt_t *vlc_interrupt_set(vlc_interrupt_t *ctx)
+{
+    vlc_interrupt_t *previous = current_interrupt;
+    current_interrupt = ctx;
+    return previous;
+}
+
+void vlc_interrupt_kill(vlc_interrupt_t *ctx)
+{
+    atomic_store(&ctx->killed, true);
+}
+
+static bool Interrupted(void)
+{
+    return current_interrupt && atomic_load(&current_interrupt->killed);
+}
+
+ssize_t vlc_stream_Read(stream_t *s, void *buf, size_t len)
+{
+    host_stream_t *hs = s->p_sys;
+    size_t done = 0;
+
+    while (done < len) {
+        if (Interrupted())
+            return done > 0 ? (ssize_t)done : -1;
+        ssize_t n = pread(hs->fd, (uint8_t *)buf + done, len - done,
+                          (off_t)(hs->pos + done));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return done > 0 ? (ssize_t)done : -1;
+        }
+        if (n == 0)
+            break;
+        done += (size_t)n;
+    }
+    hs->pos += done;
+    return (ssize_t)done;
+}
+
+ssize_t vlc_stream_Peek(stream_t *s, const uint8_t **bufp, size_t len)
+{
+    host_stream_t *hs = s->p_sys;
+
+    if (len > hs->peek_size) {
+        uint8_t *peek = realloc(hs->peek, len);
+        if (!peek)
+            return -1;
+        hs->peek = peek;
+        hs->peek_size = len;
+    }
+
+    uint64_t pos = hs->pos;
+    ssize_t n = vlc_stream_Read(s, hs->peek, len);
+    hs->pos = pos;
+    *bufp = hs->peek;
+    return n;
+}
+
+int vlc_stream_Seek(stream_t *s, uint64_t offset)
+{
+    host_stream_t *hs = s->p_sys;
+    if (!hs->seekable)
+        return VLC_EGENERIC;
+    hs->pos = offset;
+    return VLC_SUCCESS;
+}
+
+int vlc_stream_vaControl(stream_t *s, int query, va_list args)
+{
+    host_stream_t *hs = s->p_sys;
+
+    switch (query) {
+    case STREAM_CAN_SEEK:
+    case STREAM_CAN_FASTSEEK:
+        *va_arg(args, bool *) = hs->seekable;
+        return VLC_SUCCESS;
+    case STREAM_GET_SIZE:
+        *va_arg(args, uint64_t *) = hs->size;
+        return VLC_SUCCESS;
+    default:
+        return VLC_EGENERIC;
+    }
+}
+
+static void BlockRelease(block_t *block)
+{
+    free(block);
+}
+
+block_t *block_Alloc(size_t size)
+{
+    /* Header and payload in one allocation, like libvlccore */
+    block_t *block = malloc(sizeof(*block) + size);
+    if (!block)
+        return NULL;
+
+    memset(block, 0, sizeof(*block));
+    block->p_start    = (uint8_t *)(block + 1);
+    block->p_buffer   = block->p_start;
+    block->i_size     = size;
+    block->i_buffer   = size;
+    block->i_pts      = VLC_TS_INVALID;
+    block->i_dts      = VLC_TS_INVALID;
+    block->pf_release = BlockRelease;
+    return block;
+}
+
+void es_format_Init(es_format_t *fmt, int i_cat, vlc_fourcc_t i_codec)
+{
+    memset(fmt, 0, sizeof(*fmt));
+    fmt->i_cat   = i_cat;
+    fmt->i_codec = i_codec;
+}
+
+void es_format_Clean(es_format_t *fmt)
+{
+    memset(fmt, 0, sizeof(*fmt));
+}
+
+/* ═════════════════════════════════════════════════════════════════════
+ *  es_out_t – counts what the demuxer delivers
+ * ═════════════════════════════════════════════════════════════════════ */
+static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
+{
+    es_out_sys_t *sys = out->p_sys;
+    if (sys->added)
+        return NULL;
+    sys->es.fmt = *fmt;
+    sys->added = true;
+    return &sys->es;
+}
+
+static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
+{
+    es_out_sys_t *sys = out->p_sys;
+    (void)id;
+
+    sys->blocks++;
+    sys->bytes += block->i_buffer;
+    sys->last_pts = block->i_pts;
+    block_Release(block);
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel(es_out_t *out, es_out_id_t *id)
+{
+    (void)id;
+    out->p_sys->added = false;
+}
+
+static int EsOutControl(es_out_t *out, int query, va_list args)
+{
+    es_out_sys_t *sys = out->p_sys;
+
+    switch (query) {
+    case ES_OUT_SET_PCR: {
+        mtime_t pcr = va_arg(args, mtime_t);
+        if (pcr < sys->last_pcr)
+            sys->pcr_regressions++;
+        sys->last_pcr = pcr;
+        return VLC_SUCCESS;
+    }
+    case ES_OUT_RESET_PCR:
+        sys->last_pcr = 0;
+        return VLC_SUCCESS;
+    default:
+        return VLC_EGENERIC;
+    }
+}
+
+/* ═════════════════════════════════════════════════════════════════════
+ *  Module loading
+ * ═════════════════════════════════════════════════════════════════════ */
+static int ModuleSet(void *opaque, void *target, int property, ...)
+{
+    host_module_t *module = opaque;
+    va_list ap;
+    (void)target;
+
+    va_start(ap, property);
+    switch (property) {
+    case VLC_MODULE_CREATE:
+        *va_arg(ap, module_t **) = (module_t *)module;
+        break;
+    case VLC_CONFIG_CREATE:
+        (void)va_arg(ap, int);
+        *va_arg(ap, module_config_t **) = (module_config_t *)&module->config;
+        break;
+    case VLC_MODULE_CAPABILITY:
+        module->capability = va_arg(ap, const char *);
+        break;
+    case VLC_MODULE_SCORE:
+        module->score = va_arg(ap, int);
+        break;
+    case VLC_MODULE_CB_OPEN:
+        (void)va_arg(ap, const char *);
+        module->open = (int (*)(vlc_object_t *))va_arg(ap, void *);
+        break;
+    case VLC_MODULE_CB_CLOSE:
+        (void)va_arg(ap, const char *);
+        module->close = (void (*)(vlc_object_t *))va_arg(ap, void *);
+        break;
+    default:
+        break;   /* names, shortcuts, categories: not needed here */
+    }
+    va_end(ap);
+    return 0;
+}
+
+static int LoadModule(const char *path, host_module_t *module)
+{
+    /* RTLD_NOW binds every symbol up front, so one the host lacks fails
+     * here rather than at its first call */
+    void *lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!lib) {
+        fprintf(stderr, "vai-host: cannot load plugin: %s\n"
+                "vai-host: a libvlccore symbol the shim uses needs a stand-in"
+                " in vai_host.c\n", dlerror());
+        return -1;
+    }
+
+    int (*entry)(vlc_set_cb, void *) =
+        (int (*)(vlc_set_cb, void *))dlsym(lib, VAI_ENTRY);
+    if (!entry) {
+        fprintf(stderr, "vai-host: %s does not export " VAI_ENTRY "\n", path);
+        return -1;
+    }
+
+    memset(module, 0, sizeof(*module));
+    if (entry(ModuleSet, module) != 0 || !module->open || !module->close) {
+        fprintf(stderr, "vai-host: module descriptor failed\n");
+        return -1;
+    }
+    if (!module->capability || strcmp(module->capability, "demux") != 0) {
+        fprintf(stderr, "vai-host: not a demux module\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* ═════════════════════════════════════════════════════════════════════
+ *  Measurements
+ * ═════════════════════════════════════════════════════════════════════ */
+static double NowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void SamplePush(samples_t *samples, double value)
+{
+    if (samples->count == samples->capacity) {
+        size_t capacity = samples->capacity ? samples->capacity * 2 : 1024;
+        double *values = realloc(samples->values, capacity * sizeof(*values));
+        if (!values)
+            return;
+        samples->values = values;
+        samples->capacity = capacity;
+    }
+    samples->values[samples->count++] = value;
+}
+
+static int CompareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void PrintPercentiles(const char *label, samples_t *samples)
+{
+    if (samples->count == 0) {
+        printf("%-14s no samples\n", label);
+        return;
+    }
+
+    qsort(samples->values, samples->count, sizeof(double), CompareDouble);
+    const double *v = samples->values;
+    size_t n = samples->count;
+    printf("%-14s p50 %.3f ms  p90 %.3f ms  p99 %.3f ms  max %.3f ms\n", label,
+           v[n / 2], v[n * 90 / 100], v[n * 99 / 100], v[n - 1]);
+}
+
+static double PeakRssMiB(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);   /* bytes */
+#else
+    return usage.ru_maxrss / 1024.0;              /* KiB */
+#endif
+}
+
+static int DemuxControl(demux_t *demux, int query, ...)
+{
+    va_list ap;
+    va_start(ap, query);
+    int ret = demux->pf_control(demux, query, ap);
+    va_end(ap);
+    return ret;
+}
+
+static void Usage(void)
+{
+    fprintf(stderr,
+            "usage: vai-host [-n frames] [-s seeks] [-r] [-b] PLUGIN FILE.vai\n"
+            "       vai-host -l PLUGIN\n"
+            "  -l    load the plugin and check its descriptor, then exit\n"
+            "  -n N  frames to demux before seeking (default: all)\n"
+            "  -s N  seeks to random times after that (default: 20)\n"
+            "  -r    pace Demux calls in real time instead of back to back\n"
+            "  -b    present FILE as a non-seekable stream\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t max_frames = UINT64_MAX;
+    unsigned seeks = 20;
+    bool realtime = false, seekable = true, load_only = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:rbl")) != -1) {
+        switch (opt) {
+        case 'l': load_only = true; break;
+        case 'n': max_frames = strtoull(optarg, NULL, 10); break;
+        case 's': seeks = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'r': realtime = true; break;
+        case 'b': seekable = false; break;
+        default: Usage(); return 2;
+        }
+    }
+    if (argc - optind != (load_only ? 1 : 2)) {
+        Usage();
+        return 2;
+    }
+
+    host_module_t module;
+    if (LoadModule(argv[optind], &module) != 0)
+        return 1;
+    if (load_only) {
+        printf("%-14s %s: demux, score %d\n", "loaded", argv[optind], module.score);
+        return 0;
+    }
+
+    host_stream_t hs = { .seekable = seekable };
+    struct stat st;
+    hs.fd = open(argv[optind + 1], O_RDONLY);
+    if (hs.fd < 0 || fstat(hs.fd, &st) != 0) {
+        perror(argv[optind + 1]);
+        return 1;
+    }
+    hs.size = (uint64_t)st.st_size;
+
+    stream_t *stream = calloc(1, sizeof(*stream));
+    demux_t *demux = calloc(1, sizeof(*demux));
+    es_out_sys_t out_sys = { .last_pcr = 0 };
+    es_out_t out = {
+        .pf_add     = EsOutAdd,
+        .pf_send    = EsOutSend,
+        .pf_del     = EsOutDel,
+        .pf_control = EsOutControl,
+        .p_sys      = &out_sys,
+    };
+    if (!stream || !demux)
+        return 1;
+    stream->p_sys = &hs;
+    demux->s   = stream;
+    demux->out = &out;
+
+    /* ── Open ── */
+    double t0 = NowMs();
+    if (module.open(VLC_OBJECT(demux)) != VLC_SUCCESS) {
+        fprintf(stderr, "vai-host: Open failed\n");
+        return 1;
+    }
+    printf("%-14s %.2f ms (%s)\n", "open", NowMs() - t0,
+           seekable ? "seekable stream" : "buffered");
+
+    int64_t length_us = 0;
+    DemuxControl(demux, DEMUX_GET_LENGTH, &length_us);
+    const video_format_t *video = &out_sys.es.fmt.video;
+    double frame_ms = video->i_frame_rate
+        ? 1000.0 * video->i_frame_rate_base / video->i_frame_rate : 0.0;
+    printf("%-14s %ux%u, %.3f ms/frame, %.3f s\n", "stream",
+           video->i_width, video->i_height, frame_ms, length_us / 1e6);
+
+    /* ── Linear playback ── */
+    samples_t latency = { 0 };
+    uint64_t gaps = 0;
+    mtime_t prev_pts = VLC_TS_INVALID;
+    double start = NowMs();
+    while (latency.count < max_frames) {
+        if (realtime && out_sys.blocks > 0) {
+            double due = start + out_sys.last_pts / 1000.0 + frame_ms;
+            double wait = due - NowMs();
+            if (wait > 0) {
+                long long ns = (long long)(wait * 1e6);
+                struct timespec ts = { (time_t)(ns / 1000000000), (long)(ns % 1000000000) };
+                nanosleep(&ts, NULL);
+            }
+        }
+
+        double before = NowMs();
+        int ret = demux->pf_demux(demux);
+        if (ret != VLC_DEMUXER_SUCCESS)
+            break;
+        SamplePush(&latency, NowMs() - before);
+
+        /* Dropped frames show up as PTS jumps of more than one frame */
+        if (prev_pts != VLC_TS_INVALID
+         && out_sys.last_pts - prev_pts > (mtime_t)(frame_ms * 1500.0))
+            gaps++;
+        prev_pts = out_sys.last_pts;
+    }
+    double elapsed = NowMs() - start;
+    printf("%-14s %zu frames, %"PRIu64" gaps, %.1f fps, %.1f MiB delivered\n",
+           "demux", latency.count, gaps,
+           elapsed > 0 ? latency.count * 1000.0 / elapsed : 0.0,
+           out_sys.bytes / (1024.0 * 1024.0));
+    PrintPercentiles("  latency", &latency);
+
+    /* ── Seeks: time the first frame delivered after each ── */
+    samples_t seek_latency = { 0 };
+    unsigned misses = 0;
+    uint64_t lcg = 0x9E3779B97F4A7C15ull;
+    for (unsigned i = 0; i < seeks && length_us > 0; i++) {
+        lcg = lcg * 6364136223846793005ull + 1442695040888963407ull;
+        int64_t target = (int64_t)((lcg >> 11) % (uint64_t)length_us);
+
+        double before = NowMs();
+        if (DemuxControl(demux, DEMUX_SET_TIME, target, true) != VLC_SUCCESS
+         || demux->pf_demux(demux) != VLC_DEMUXER_SUCCESS) {
+            misses++;
+            continue;
+        }
+        SamplePush(&seek_latency, NowMs() - before);
+
+        /* Must land on the frame containing the target */
+        if (llabs(out_sys.last_pts - target) > (int64_t)(frame_ms * 1000.0) + 1)
+            misses++;
+
+        for (int f = 0; f < FRAMES_AFTER_SEEK; f++)
+            if (demux->pf_demux(demux) != VLC_DEMUXER_SUCCESS)
+                break;
+    }
+    if (seeks > 0) {
+        printf("%-14s %u seeks, %u missed\n", "seek", seeks, misses);
+        PrintPercentiles("  first frame", &seek_latency);
+    }
+
+    /* ── Close ── */
+    module.close(VLC_OBJECT(demux));
+    printf("%-14s %.1f MiB\n", "peak RSS", PeakRssMiB());
+
+    int status = 0;
+    if (out_sys.pcr_regressions > seeks) {
+        fprintf(stderr, "vai-host: PCR went backwards %"PRIu64" times\n",
+                out_sys.pcr_regressions);
+        status = 1;
+    }
+    if (misses > 0)
+        status = 1;
+
+    free(latency.values);
+    free(seek_latency.values);
+    free(hs.peek);
+    free(demux);
+    free(stream);
+    close(hs.fd);
+    return status;
+}
@@ -0,0 +1,152 @@
+//! Playback clock for late-frame detection
+//!
+//! The demuxer does not see VLC's output clock, but it does see its own
+//! pace: every delivered frame becomes the PCR, and once VLC's buffer is
+//! full it only asks for frames in real time.  `PlaybackClock` anchors the
+//! wall clock to the last PCR delivered while the producer was ahead, and
+//! from that predicts when each later frame is due.
+//!
+//! After a seek, pause or start VLC pulls frames as fast as they come until
+//! its buffer is full again, so an anchor taken then says nothing about
+//! deadlines.  Late checks stay off until a delivery finds the whole ring
+//! rendered, which only happens once VLC is pacing.
+
+use std::time::{Duration, Instant};
+
+/// How far behind its due time a frame may finish before it is dropped;
+/// VLC's own buffering absorbs lateness below this
+const LATE_TOLERANCE: Duration = Duration::from_millis(100);
+
+/// Weight of the newest sample in the render cost average
+const COST_SMOOTHING: f64 = 0.2;
+
+/// Maps presentation times to wall-clock deadlines
+#[derive(Debug, Clone, Default)]
+pub struct PlaybackClock {
+    /// Wall time at which the anchor PCR was delivered, and that PCR in ms
+    anchor: Option<(Instant, u64)>,
+    /// VLC has been pulling in real time since the last reset
+    paced: bool,
+    /// Moving average of the time to render one frame
+    render_cost: Option<Duration>,
+}
+
+impl PlaybackClock {
+    /// Records that the frame at `pcr_ms` was delivered right now.  `ring_full`
+    /// says every ring buffer was rendered and waiting, so VLC, not the
+    /// producer, set the pace.
+    pub fn anchor(&mut self, pcr_ms: u64, ring_full: bool) {
+        self.anchor_at(Instant::now(), pcr_ms, ring_full);
+    }
+
+    fn anchor_at(&mut self, now: Instant, pcr_ms: u64, ring_full: bool) {
+        self.anchor = Some((now, pcr_ms));
+        self.paced |= ring_full;
+    }
+
+    /// Forgets the anchor (after a seek or pause); nothing counts as late
+    /// until VLC is pacing again
+    pub fn reset(&mut self) {
+        self.anchor = None;
+        self.paced = false;
+    }
+
+    /// Folds one measured composition time into the cost estimate
+    pub fn record_render(&mut self, elapsed: Duration) {
+        self.render_cost = Some(match self.render_cost {
+            Some(cost) => cost.mul_f64(1.0 - COST_SMOOTHING) + elapsed.mul_f64(COST_SMOOTHING),
+            None => elapsed,
+        });
+    }
+
+    /// If a frame at `timestamp_ms` started now would miss its deadline,
+    /// returns the earliest presentation time that would still be on time
+    pub fn catch_up_ms(&self, timestamp_ms: u64) -> Option<u64> {
+        self.catch_up_ms_at(Instant::now(), timestamp_ms)
+    }
+
+    fn catch_up_ms_at(&self, now: Instant, timestamp_ms: u64) -> Option<u64> {
+        if !self.paced {
+            return None;
+        }
+        let (anchor_wall, anchor_ms) = self.anchor?;
+        let finish = now + self.render_cost.unwrap_or_default();
+
+        // Presentation time the clock will have reached when we finish
+        let reached_ms = anchor_ms + finish.saturating_duration_since(anchor_wall).as_millis() as u64;
+        let tolerance_ms = LATE_TOLERANCE.as_millis() as u64;
+        (timestamp_ms + tolerance_ms < reached_ms).then(|| reached_ms - tolerance_ms)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn ms(ms: u64) -> Duration {
+        Duration::from_millis(ms)
+    }
+
+    #[test]
+    fn test_no_late_verdict_until_paced() {
+        let start = Instant::now();
+        let mut clock = PlaybackClock::default();
+        assert_eq!(clock.catch_up_ms_at(start, 0), None);
+
+        // VLC refilling its buffer: frames go out as soon as they exist
+        clock.anchor_at(start, 0, false);
+        assert_eq!(clock.catch_up_ms_at(start + ms(5000), 0), None);
+    }
+
+    #[test]
+    fn test_waiting_frame_anchors_the_clock() {
+        let start = Instant::now();
+        let mut clock = PlaybackClock::default();
+        clock.anchor_at(start, 1000, true);
+        // Half a second later the clock shows 1500 ms
+        assert_eq!(clock.catch_up_ms_at(start + ms(500), 1000), Some(1400));
+        assert_eq!(clock.catch_up_ms_at(start + ms(500), 1600), None);
+
+        // Once paced, later anchors move the clock even without a full ring
+        clock.anchor_at(start + ms(500), 2000, false);
+        assert_eq!(clock.catch_up_ms_at(start + ms(500), 1950), None);
+        assert_eq!(clock.catch_up_ms_at(start + ms(700), 2050), Some(2100));
+    }
+
+    #[test]
+    fn test_drop_boundary_is_late_tolerance() {
+        let start = Instant::now();
+        let mut clock = PlaybackClock::default();
+        clock.anchor_at(start, 1000, true);
+        let now = start + ms(500);
+        let tolerance = LATE_TOLERANCE.as_millis() as u64;
+
+        // Finishing exactly `LATE_TOLERANCE` behind is still on time
+        assert_eq!(clock.catch_up_ms_at(now, 1500 - tolerance), None);
+        assert_eq!(clock.catch_up_ms_at(now, 1500 - tolerance - 1), Some(1500 - tolerance));
+
+        // The expected render cost moves the finish line
+        clock.record_render(ms(50));
+        assert_eq!(clock.catch_up_ms_at(now, 1550 - tolerance), None);
+        assert_eq!(clock.catch_up_ms_at(now, 1549 - tolerance), Some(1550 - tolerance));
+    }
+
+    #[test]
+    fn test_reset_waits_for_pacing_again() {
+        let start = Instant::now();
+        let mut clock = PlaybackClock::default();
+        clock.anchor_at(start, 1000, true);
+        assert!(clock.catch_up_ms_at(start + ms(1000), 1000).is_some());
+
+        // A seek or pause: nothing is late while VLC refills
+        clock.reset();
+        assert_eq!(clock.catch_up_ms_at(start + ms(1000), 1000), None);
+        clock.anchor_at(start + ms(1000), 8000, false);
+        assert_eq!(clock.catch_up_ms_at(start + ms(3000), 8000), None);
+
+        // Paced again: deadlines follow the new anchor, not the old one
+        clock.anchor_at(start + ms(3000), 8100, true);
+        assert_eq!(clock.catch_up_ms_at(start + ms(3000), 8000), None);
+        assert_eq!(clock.catch_up_ms_at(start + ms(3300), 8000), Some(8300));
+    }
+}
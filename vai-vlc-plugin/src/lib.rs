@@ -3,13 +3,19 @@
 //! Exposes a C-ABI interface (`vai_plugin_*`) that the C shim in
 //! `vlc_shim.c` calls.  Rust never touches VLC structs directly.
 
+mod clock;
+mod producer;
+
 use image::RgbaImage;
-use std::io::Cursor;
-use std::os::raw::c_int;
+use std::io::{self, Read, Seek, SeekFrom};
+use std::os::raw::{c_int, c_void};
 use std::panic;
 use std::ptr;
-use vai_core::VaiContainer;
-use vai_decoder::FrameCompositor;
+use std::sync::{Arc, Mutex};
+use producer::{Dequeued, FrameFormat, FrameProducer, StreamLayout, ThreadContext};
+use vai_core::{VaiContainer, VaiHeader};
+use vai_decoder::yuv::I420Frame;
+use vai_decoder::{DecoderConfig, FrameCompositor};
 
 /// Info about the opened VAI file, shared with C via repr(C).
 #[repr(C)]
@@ -23,11 +29,110 @@ pub struct VaiPluginInfo {
     pub fps: f64,
 }
 
+/// Byte source callbacks for `vai_plugin_open_stream`, shared with C via
+/// repr(C).  The shim backs them with `vlc_stream_Read` / `vlc_stream_Seek`.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct VaiPluginReader {
+    /// Passed back to every callback
+    pub opaque: *mut c_void,
+    /// Reads up to `len` bytes into `buf`; returns the count, 0 at end of
+    /// stream, or negative on error
+    pub read: unsafe extern "C" fn(opaque: *mut c_void, buf: *mut u8, len: usize) -> isize,
+    /// Moves to absolute byte `offset`; returns 0 on success
+    pub seek: unsafe extern "C" fn(opaque: *mut c_void, offset: u64) -> c_int,
+    /// Optional; called on the producer thread before it first reads.  The
+    /// shim installs an interrupt context there so `Close` can abort a read
+    /// that blocks on the network.
+    pub thread_enter: Option<unsafe extern "C" fn(opaque: *mut c_void)>,
+    /// Optional; called on the producer thread as it exits
+    pub thread_exit: Option<unsafe extern "C" fn(opaque: *mut c_void)>,
+}
+
+// The callbacks are plain function pointers and `opaque` is only handed
+// back to them; see `StreamReader` for which threads call them
+unsafe impl Send for VaiPluginReader {}
+
+impl ThreadContext for VaiPluginReader {
+    fn enter(&self) {
+        if let Some(enter) = self.thread_enter {
+            unsafe { enter(self.opaque) }
+        }
+    }
+
+    fn exit(&self) {
+        if let Some(exit) = self.thread_exit {
+            unsafe { exit(self.opaque) }
+        }
+    }
+}
+
+/// `Read + Seek` adapter over the C callbacks
+struct StreamReader {
+    callbacks: VaiPluginReader,
+    position: u64,
+}
+
+// Threading contract: the reader lives inside the compositor, so every
+// callback runs under the compositor lock, one thread at a time, which is
+// all VLC requires of its stream API.  The caller's thread reads during
+// `vai_plugin_open_stream` and `vai_plugin_render*`; the producer thread
+// reads between `thread_enter` and `thread_exit`, and a read blocked there
+// is only released by the interrupt those hooks installed, so the shim must
+// kill that interrupt before `vai_plugin_close` joins the thread.
+unsafe impl Send for StreamReader {}
+
+impl Read for StreamReader {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        let n = unsafe { (self.callbacks.read)(self.callbacks.opaque, buf.as_mut_ptr(), buf.len()) };
+        if n < 0 {
+            return Err(io::Error::other("stream read failed"));
+        }
+        self.position += n as u64;
+        Ok(n as usize)
+    }
+}
+
+impl Seek for StreamReader {
+    fn seek(&mut self, pos: SeekFrom) -> io::Result<u64> {
+        let target = match pos {
+            SeekFrom::Start(offset) => offset,
+            SeekFrom::Current(delta) => self
+                .position
+                .checked_add_signed(delta)
+                .ok_or(io::ErrorKind::InvalidInput)?,
+            SeekFrom::End(_) => return Err(io::ErrorKind::Unsupported.into()),
+        };
+        if target != self.position {
+            if unsafe { (self.callbacks.seek)(self.callbacks.opaque, target) } != 0 {
+                return Err(io::Error::other("stream seek failed"));
+            }
+            self.position = target;
+        }
+        Ok(target)
+    }
+}
+
 /// Internal playback state.
 struct PluginState {
-    compositor: FrameCompositor,
+    /// Shared with the producer thread once started
+    compositor: Arc<Mutex<FrameCompositor>>,
+    /// Background renderer feeding `vai_plugin_next_frame`
+    producer: Option<FrameProducer>,
+    /// Reader callbacks whose thread hooks the producer runs under, for
+    /// handles opened with `vai_plugin_open_stream`
+    reader: Option<VaiPluginReader>,
     info: VaiPluginInfo,
+    /// Frame timing, read without locking the compositor
+    header: VaiHeader,
     current_frame: u64,
+    /// Reused target for `vai_plugin_render_i420`
+    i420_frame: Option<I420Frame>,
+    /// A seek just happened: show the embedded preview for the next frame
+    /// instead of waiting for a full decode
+    preview_pending: bool,
+    /// Playback is paused, so a preview would stay on screen; seeks skip it
+    paused: bool,
 }
 
 // ──────────────────── C-ABI functions ────────────────────
@@ -46,8 +151,11 @@ pub unsafe extern "C" fn vai_plugin_open(
             return ptr::null_mut();
         }
 
-        let slice = unsafe { std::slice::from_raw_parts(data, len) };
-        let container = match VaiContainer::read(Cursor::new(slice.to_vec())) {
+        // Parsed straight from the caller's buffer without copying the whole
+        // file first; each payload is still copied into its own Vec, which
+        // the compositor keeps after the buffer is freed
+        let mut bytes = unsafe { std::slice::from_raw_parts(data, len) };
+        let container = match VaiContainer::read(&mut bytes) {
             Ok(c) => c,
             Err(e) => {
                 eprintln!("VAI plugin: parse error: {e}");
@@ -55,44 +163,97 @@ pub unsafe extern "C" fn vai_plugin_open(
             }
         };
 
-        let fps = container.fps();
-        let duration_ms = container.header.duration_ms;
-        let total_frames = ((duration_ms as f64 * fps) / 1000.0).ceil() as u64;
-
-        let info = VaiPluginInfo {
-            width: container.header.width,
-            height: container.header.height,
-            fps_num: container.header.fps_num,
-            fps_den: container.header.fps_den,
-            duration_ms,
-            total_frames,
-            fps,
-        };
+        unsafe { into_handle(FrameCompositor::new(container), None, out_info) }
+    });
 
-        unsafe {
-            ptr::write(out_info, VaiPluginInfo {
-                width: info.width,
-                height: info.height,
-                fps_num: info.fps_num,
-                fps_den: info.fps_den,
-                duration_ms: info.duration_ms,
-                total_frames: info.total_frames,
-                fps: info.fps,
-            });
+    result.unwrap_or(ptr::null_mut())
+}
+
+/// Open a VAI container through reader callbacks.
+/// Only the header, record table and timeline are read here; asset
+/// payloads are fetched through `reader` as playback needs them, so the
+/// callbacks (and their `opaque` pointer) must stay valid until
+/// `vai_plugin_close`.
+/// On success returns an opaque handle and fills `out_info`.
+/// On failure returns NULL.
+#[no_mangle]
+pub unsafe extern "C" fn vai_plugin_open_stream(
+    reader: *const VaiPluginReader,
+    out_info: *mut VaiPluginInfo,
+) -> *mut std::ffi::c_void {
+    let result = panic::catch_unwind(|| {
+        if reader.is_null() || out_info.is_null() {
+            return ptr::null_mut();
         }
 
-        let state = Box::new(PluginState {
-            compositor: FrameCompositor::new(container),
-            info,
-            current_frame: 0,
-        });
+        let callbacks = unsafe { *reader };
+        let reader = StreamReader { callbacks, position: 0 };
+        let compositor = match FrameCompositor::open_lazy(reader, DecoderConfig::default()) {
+            Ok(c) => c,
+            Err(e) => {
+                eprintln!("VAI plugin: parse error: {e}");
+                return ptr::null_mut();
+            }
+        };
 
-        Box::into_raw(state) as *mut std::ffi::c_void
+        unsafe { into_handle(compositor, Some(callbacks), out_info) }
     });
 
     result.unwrap_or(ptr::null_mut())
 }
 
+/// Fills `out_info` and boxes the playback state into an opaque handle
+unsafe fn into_handle(
+    mut compositor: FrameCompositor,
+    reader: Option<VaiPluginReader>,
+    out_info: *mut VaiPluginInfo,
+) -> *mut c_void {
+    let container = compositor.container();
+    let header = container.header;
+    let fps = container.fps();
+    let duration_ms = container.header.duration_ms;
+    let total_frames = container.frame_count();
+
+    let info = VaiPluginInfo {
+        width: container.header.width,
+        height: container.header.height,
+        fps_num: container.header.fps_num,
+        fps_den: container.header.fps_den,
+        duration_ms,
+        total_frames,
+        fps,
+    };
+
+    unsafe {
+        ptr::write(out_info, VaiPluginInfo {
+            width: info.width,
+            height: info.height,
+            fps_num: info.fps_num,
+            fps_den: info.fps_den,
+            duration_ms: info.duration_ms,
+            total_frames: info.total_frames,
+            fps: info.fps,
+        });
+    }
+
+    // Playback is real-time: fall back to reduced tiers rather than stall
+    compositor.set_adaptive_tiers(true);
+
+    let state = Box::new(PluginState {
+        compositor: Arc::new(Mutex::new(compositor)),
+        producer: None,
+        reader,
+        info,
+        header,
+        current_frame: 0,
+        i420_frame: None,
+        preview_pending: false,
+        paused: false,
+    });
+
+    Box::into_raw(state) as *mut c_void
+}
+
 /// Render the frame at `timestamp_ms` into `out_buf` (RGBA, row-major).
 /// Returns 0 on success, -1 on failure.
 #[no_mangle]
@@ -107,8 +268,18 @@ pub unsafe extern "C" fn vai_plugin_render(
             return -1;
         }
         let state = unsafe { &mut *(handle as *mut PluginState) };
+        let mut compositor = state.compositor.lock().unwrap_or_else(|e| e.into_inner());
 
-        let frame: RgbaImage = match state.compositor.render_frame(timestamp_ms) {
+        let preview = if std::mem::take(&mut state.preview_pending) {
+            compositor.render_preview(timestamp_ms).ok().flatten()
+        } else {
+            None
+        };
+        let rendered = match preview {
+            Some(frame) => Ok(frame),
+            None => compositor.render_frame(timestamp_ms),
+        };
+        let frame: RgbaImage = match rendered {
             Ok(f) => f,
             Err(e) => {
                 eprintln!("VAI plugin: render error: {e}");
@@ -127,6 +298,125 @@ pub unsafe extern "C" fn vai_plugin_render(
     result.unwrap_or(-1)
 }
 
+/// Render the frame at `timestamp_ms` into `out_buf` as planar I420
+/// (Y plane, then U, then V, each tightly packed).
+/// Returns 0 on success, -1 on failure.
+#[no_mangle]
+pub unsafe extern "C" fn vai_plugin_render_i420(
+    handle: *mut std::ffi::c_void,
+    timestamp_ms: u64,
+    out_buf: *mut u8,
+    buf_size: usize,
+) -> c_int {
+    let result = panic::catch_unwind(|| {
+        if handle.is_null() || out_buf.is_null() {
+            return -1;
+        }
+        let state = unsafe { &mut *(handle as *mut PluginState) };
+        let mut compositor = state.compositor.lock().unwrap_or_else(|e| e.into_inner());
+
+        let (width, height) = (state.info.width, state.info.height);
+        let frame = state
+            .i420_frame
+            .get_or_insert_with(|| I420Frame::new(width, height));
+
+        // Right after a seek the preview stands in; full frames resume next call
+        let previewed = std::mem::take(&mut state.preview_pending)
+            && matches!(compositor.render_preview_i420_into(timestamp_ms, frame), Ok(true));
+        if !previewed {
+            if let Err(e) = compositor.render_frame_i420_into(timestamp_ms, frame) {
+                eprintln!("VAI plugin: render error: {e}");
+                return -1;
+            }
+        }
+
+        let raw = frame.as_raw();
+        let copy_len = raw.len().min(buf_size);
+        unsafe {
+            ptr::copy_nonoverlapping(raw.as_ptr(), out_buf, copy_len);
+        }
+        0
+    });
+
+    result.unwrap_or(-1)
+}
+
+/// Start rendering ahead on a background thread, in I420 when `i420` is
+/// non-zero and RGBA otherwise.  Frames are then taken with
+/// `vai_plugin_next_frame`.
+/// Returns 0 on success, -1 on failure.
+#[no_mangle]
+pub unsafe extern "C" fn vai_plugin_start(handle: *mut std::ffi::c_void, i420: c_int) -> c_int {
+    let result = panic::catch_unwind(|| {
+        if handle.is_null() {
+            return -1;
+        }
+        let state = unsafe { &mut *(handle as *mut PluginState) };
+        if state.producer.is_none() {
+            let layout = StreamLayout {
+                width: state.info.width,
+                height: state.info.height,
+                header: state.header,
+                total_frames: state.info.total_frames,
+                format: if i420 != 0 { FrameFormat::I420 } else { FrameFormat::Rgba },
+            };
+            let compositor = Arc::clone(&state.compositor);
+            let producer = match state.reader {
+                Some(reader) => FrameProducer::start(compositor, layout, state.current_frame, reader),
+                None => FrameProducer::start(compositor, layout, state.current_frame, ()),
+            };
+            if state.paused {
+                producer.set_paused(true);
+            }
+            if std::mem::take(&mut state.preview_pending) {
+                producer.seek(state.current_frame);
+            }
+            state.producer = Some(producer);
+        }
+        0
+    });
+
+    result.unwrap_or(-1)
+}
+
+/// Take the next frame rendered by the background thread into `out_buf`
+/// and store its frame number in `out_frame`.  Blocks until it is ready.
+/// Returns 0 on success, 1 at end of stream, -1 on failure.
+#[no_mangle]
+pub unsafe extern "C" fn vai_plugin_next_frame(
+    handle: *mut std::ffi::c_void,
+    out_buf: *mut u8,
+    buf_size: usize,
+    out_frame: *mut u64,
+) -> c_int {
+    let result = panic::catch_unwind(|| {
+        if handle.is_null() || out_buf.is_null() || out_frame.is_null() {
+            return -1;
+        }
+        let state = unsafe { &mut *(handle as *mut PluginState) };
+        let producer = match &state.producer {
+            Some(producer) => producer,
+            None => return -1,
+        };
+
+        let out = unsafe { std::slice::from_raw_parts_mut(out_buf, buf_size) };
+        match producer.next(out) {
+            Dequeued::Frame(frame) => {
+                state.current_frame = frame + 1;
+                unsafe { ptr::write(out_frame, frame) };
+                0
+            }
+            Dequeued::Failed(frame) => {
+                state.current_frame = frame + 1;
+                -1
+            }
+            Dequeued::EndOfStream => 1,
+        }
+    });
+
+    result.unwrap_or(-1)
+}
+
 /// Return the current frame number.
 #[no_mangle]
 pub unsafe extern "C" fn vai_plugin_current_frame(
@@ -139,6 +429,33 @@ pub unsafe extern "C" fn vai_plugin_current_frame(
     state.current_frame
 }
 
+/// Presentation time of `frame` in milliseconds, in exact frame units.
+#[no_mangle]
+pub unsafe extern "C" fn vai_plugin_frame_timestamp_ms(
+    handle: *mut std::ffi::c_void,
+    frame: u64,
+) -> u64 {
+    if handle.is_null() {
+        return 0;
+    }
+    let state = unsafe { &*(handle as *const PluginState) };
+    state.header.frame_timestamp_ms(frame)
+}
+
+/// Number of the frame on screen at `timestamp_ms`, clamped to the last
+/// frame.
+#[no_mangle]
+pub unsafe extern "C" fn vai_plugin_frame_at_ms(
+    handle: *mut std::ffi::c_void,
+    timestamp_ms: u64,
+) -> u64 {
+    if handle.is_null() {
+        return 0;
+    }
+    let state = unsafe { &*(handle as *const PluginState) };
+    state.header.frame_at_ms(timestamp_ms).min(state.info.total_frames.saturating_sub(1))
+}
+
 /// Advance to the next frame.
 #[no_mangle]
 pub unsafe extern "C" fn vai_plugin_advance(handle: *mut std::ffi::c_void) {
@@ -160,9 +477,62 @@ pub unsafe extern "C" fn vai_plugin_seek_frame(
     }
     let state = unsafe { &mut *(handle as *mut PluginState) };
     state.current_frame = frame;
+    match &state.producer {
+        Some(producer) => producer.seek(frame),
+        None => state.preview_pending = !state.paused,
+    }
+}
+
+/// Suspend late-frame drops until VLC paces delivery again.  Called when
+/// playback is paused or resumed, after which VLC refills its buffer as fast
+/// as frames arrive.
+#[no_mangle]
+pub unsafe extern "C" fn vai_plugin_reset_clock(handle: *mut std::ffi::c_void) {
+    if handle.is_null() {
+        return;
+    }
+    let state = unsafe { &*(handle as *const PluginState) };
+    if let Some(producer) = &state.producer {
+        producer.reset_clock();
+    }
+}
+
+/// Record whether playback is paused (`paused` non-zero) and reset the
+/// late-frame clock as `vai_plugin_reset_clock` does.  Seeks while paused
+/// skip the embedded preview: a paused player keeps showing the last frame
+/// it was given, so that frame must be the full render.
+#[no_mangle]
+pub unsafe extern "C" fn vai_plugin_set_paused(handle: *mut std::ffi::c_void, paused: c_int) {
+    if handle.is_null() {
+        return;
+    }
+    let state = unsafe { &mut *(handle as *mut PluginState) };
+    state.paused = paused != 0;
+    if state.paused {
+        state.preview_pending = false;
+    }
+    if let Some(producer) = &state.producer {
+        producer.set_paused(state.paused);
+    }
+}
+
+/// Number of frames skipped so far because they could not be rendered
+/// before their deadline.  Frame numbers from `vai_plugin_next_frame` jump
+/// over them.
+#[no_mangle]
+pub unsafe extern "C" fn vai_plugin_dropped_frames(
+    handle: *mut std::ffi::c_void,
+) -> u64 {
+    if handle.is_null() {
+        return 0;
+    }
+    let state = unsafe { &*(handle as *const PluginState) };
+    state.producer.as_ref().map_or(0, FrameProducer::dropped)
 }
 
-/// Free the plugin state.
+/// Free the plugin state, joining the producer thread.  For stream handles,
+/// interrupt the producer's reads (see `VaiPluginReader::thread_enter`)
+/// first, or this waits for a blocked read to return.
 #[no_mangle]
 pub unsafe extern "C" fn vai_plugin_close(handle: *mut std::ffi::c_void) {
     if !handle.is_null() {
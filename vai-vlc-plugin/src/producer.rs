@@ -0,0 +1,414 @@
+//! Background frame rendering
+//!
+//! Rendering inside VLC's demux thread means every decode spike delays
+//! delivery.  `FrameProducer` renders frames ahead on its own thread into a
+//! bounded ring of pre-allocated buffers, so `Demux` only dequeues them.
+//! Seeks flush the ring and restart the producer at the new frame.  Unless
+//! playback is paused, the embedded preview stands in for that frame first
+//! and the frame is then rendered in full for the same PTS, after the
+//! compositor's caches are warmed for the frames about to be rendered.  A
+//! paused player shows only the frame it was handed last, so it gets the
+//! full render straight away.
+//!
+//! When rendering falls behind playback, the producer skips frames that
+//! could no longer be delivered on time (see [`PlaybackClock`]) and resumes
+//! at the first frame it can still make, counting the ones it dropped.
+
+use image::RgbaImage;
+use std::collections::VecDeque;
+use std::panic::{self, AssertUnwindSafe};
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, Instant};
+use vai_core::VaiHeader;
+use vai_decoder::yuv::I420Frame;
+use vai_decoder::FrameCompositor;
+
+use crate::clock::PlaybackClock;
+
+/// Frames rendered ahead of delivery
+pub const RING_DEPTH: usize = 8;
+
+/// Frames whose stills are decoded in parallel after a seek: one ring's worth
+const WARM_FRAMES: u32 = RING_DEPTH as u32;
+
+/// Pixel layout of delivered frames
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum FrameFormat {
+    Rgba,
+    I420,
+}
+
+/// What the producer renders
+#[derive(Debug, Clone, Copy)]
+pub struct StreamLayout {
+    pub width: u32,
+    pub height: u32,
+    /// Frame rate and duration
+    pub header: VaiHeader,
+    pub total_frames: u64,
+    pub format: FrameFormat,
+}
+
+impl StreamLayout {
+    /// Presentation time of `frame`
+    pub fn timestamp_ms(&self, frame: u64) -> u64 {
+        self.header.frame_timestamp_ms(frame)
+    }
+
+    /// First frame presented at or after `timestamp_ms`
+    pub fn frame_at(&self, timestamp_ms: u64) -> u64 {
+        let frame = self.header.frame_at_ms(timestamp_ms);
+        if self.timestamp_ms(frame) < timestamp_ms {
+            frame + 1
+        } else {
+            frame
+        }
+    }
+
+    /// Bytes per delivered frame
+    pub fn frame_size(&self) -> usize {
+        let pixels = self.width as usize * self.height as usize;
+        match self.format {
+            FrameFormat::Rgba => pixels * 4,
+            FrameFormat::I420 => vai_decoder::yuv::i420_frame_size(self.width, self.height),
+        }
+    }
+}
+
+/// Set-up and tear-down run on the producer thread itself
+pub trait ThreadContext: Send + 'static {
+    fn enter(&self);
+    fn exit(&self);
+}
+
+impl ThreadContext for () {
+    fn enter(&self) {}
+    fn exit(&self) {}
+}
+
+/// Result of [`FrameProducer::next`]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Dequeued {
+    /// This frame number was copied out
+    Frame(u64),
+    /// This frame failed to render
+    Failed(u64),
+    /// No frames left
+    EndOfStream,
+}
+
+/// Renders frames ahead of playback on a dedicated thread
+pub struct FrameProducer {
+    shared: Arc<Shared>,
+    layout: StreamLayout,
+    worker: Option<JoinHandle<()>>,
+}
+
+struct Shared {
+    ring: Mutex<Ring>,
+    /// Signalled when a frame is queued
+    filled: Condvar,
+    /// Signalled when a buffer is freed, on seeks and on shutdown
+    drained: Condvar,
+}
+
+struct Ring {
+    ready: VecDeque<Slot>,
+    free: Vec<Vec<u8>>,
+    /// Next frame the producer will render
+    next_frame: u64,
+    /// Bumped by every seek; frames rendered for an older one are discarded
+    generation: u64,
+    /// Render the next frame from the embedded preview (set by seeks)
+    preview: bool,
+    /// Playback is paused; seeks skip the preview
+    paused: bool,
+    /// Deadlines of upcoming frames
+    clock: PlaybackClock,
+    /// Frames skipped because they would have been late
+    dropped: u64,
+    shutdown: bool,
+}
+
+struct Slot {
+    frame: u64,
+    /// Rendered pixels, or `None` if rendering failed
+    data: Option<Vec<u8>>,
+}
+
+impl FrameProducer {
+    /// Starts rendering from `first_frame`, with `context` entered on the
+    /// producer thread for its lifetime
+    pub fn start(
+        compositor: Arc<Mutex<FrameCompositor>>,
+        layout: StreamLayout,
+        first_frame: u64,
+        context: impl ThreadContext,
+    ) -> Self {
+        let ring = Ring {
+            ready: VecDeque::with_capacity(RING_DEPTH),
+            free: (0..RING_DEPTH).map(|_| vec![0u8; layout.frame_size()]).collect(),
+            next_frame: first_frame,
+            generation: 0,
+            preview: false,
+            paused: false,
+            clock: PlaybackClock::default(),
+            dropped: 0,
+            shutdown: false,
+        };
+        let shared = Arc::new(Shared {
+            ring: Mutex::new(ring),
+            filled: Condvar::new(),
+            drained: Condvar::new(),
+        });
+
+        let worker = {
+            let shared = Arc::clone(&shared);
+            thread::Builder::new()
+                .name("vai-producer".into())
+                .spawn(move || {
+                    context.enter();
+                    produce(&shared, &compositor, layout);
+                    context.exit();
+                })
+                .expect("failed to spawn VAI producer thread")
+        };
+
+        Self {
+            shared,
+            layout,
+            worker: Some(worker),
+        }
+    }
+
+    /// Waits for the next frame in order and copies it into `out`
+    pub fn next(&self, out: &mut [u8]) -> Dequeued {
+        let mut ring = self.shared.lock();
+        let mut waited = false;
+        loop {
+            if let Some(slot) = ring.ready.pop_front() {
+                // A frame that was already waiting means VLC, not the
+                // producer, sets the pace: re-anchor the clock to this PCR
+                if !waited {
+                    let ring_full = ring.free.is_empty();
+                    ring.clock.anchor(self.layout.timestamp_ms(slot.frame), ring_full);
+                }
+                let dequeued = match slot.data {
+                    Some(data) => {
+                        let len = data.len().min(out.len());
+                        out[..len].copy_from_slice(&data[..len]);
+                        ring.free.push(data);
+                        Dequeued::Frame(slot.frame)
+                    }
+                    None => Dequeued::Failed(slot.frame),
+                };
+                self.shared.drained.notify_one();
+                return dequeued;
+            }
+            if ring.next_frame >= self.layout.total_frames {
+                return Dequeued::EndOfStream;
+            }
+            waited = true;
+            ring = self.shared.filled.wait(ring).unwrap();
+        }
+    }
+
+    /// Drops everything rendered ahead and restarts at `frame`
+    pub fn seek(&self, frame: u64) {
+        let mut ring = self.shared.lock();
+        if ring.ready.front().map(|slot| slot.frame) == Some(frame) {
+            return;
+        }
+
+        ring.generation += 1;
+        let stale: Vec<Vec<u8>> = ring.ready.drain(..).filter_map(|slot| slot.data).collect();
+        ring.free.extend(stale);
+        ring.next_frame = frame;
+        ring.preview = !ring.paused;
+        ring.clock.reset();
+        self.shared.drained.notify_one();
+    }
+
+    /// Stops late-frame checks until VLC is pacing again, for pauses
+    pub fn reset_clock(&self) {
+        self.shared.lock().clock.reset();
+    }
+
+    /// Records whether playback is paused, and restarts the clock
+    pub fn set_paused(&self, paused: bool) {
+        let mut ring = self.shared.lock();
+        ring.paused = paused;
+        ring.clock.reset();
+    }
+
+    /// Total frames skipped for lateness since the producer started
+    pub fn dropped(&self) -> u64 {
+        self.shared.lock().dropped
+    }
+}
+
+impl Drop for FrameProducer {
+    fn drop(&mut self) {
+        self.shared.lock().shutdown = true;
+        self.shared.drained.notify_one();
+        if let Some(worker) = self.worker.take() {
+            let _ = worker.join();
+        }
+    }
+}
+
+impl Shared {
+    fn lock(&self) -> MutexGuard<'_, Ring> {
+        self.ring.lock().unwrap()
+    }
+}
+
+/// Producer thread body
+fn produce(shared: &Shared, compositor: &Mutex<FrameCompositor>, layout: StreamLayout) {
+    let mut ring = shared.lock();
+    // The first frame, and the full render after a seek preview, warm the caches
+    let mut warm_next = true;
+    loop {
+        if ring.shutdown {
+            return;
+        }
+        if ring.next_frame >= layout.total_frames || ring.free.is_empty() {
+            ring = shared.drained.wait(ring).unwrap();
+            continue;
+        }
+
+        let (frame, generation) = (ring.next_frame, ring.generation);
+        if let Some(on_time_ms) = ring.clock.catch_up_ms(layout.timestamp_ms(frame)) {
+            // Jump to the first frame that can still make its deadline, but
+            // always render the last one
+            let target = layout.frame_at(on_time_ms).min(layout.total_frames - 1);
+            if target > frame {
+                ring.dropped += target - frame;
+                ring.next_frame = target;
+                continue;
+            }
+        }
+
+        let preview = std::mem::take(&mut ring.preview);
+        let warm = std::mem::take(&mut warm_next) && !preview;
+        let mut buffer = ring.free.pop().unwrap();
+        drop(ring);
+
+        // A panic must not leave `next` waiting forever
+        let rendered = panic::catch_unwind(AssertUnwindSafe(|| {
+            render(compositor, &layout, frame, preview, warm, &mut buffer)
+        }));
+        let mut composed = None;
+        let mut previewed = false;
+        let ok = match rendered {
+            Ok(Ok(elapsed)) => {
+                // The preview stood in: warm before rendering it in full
+                previewed = elapsed.is_none();
+                warm_next = previewed;
+                composed = elapsed;
+                true
+            }
+            Ok(Err(e)) => {
+                eprintln!("VAI plugin: render error: {e}");
+                false
+            }
+            Err(_) => {
+                eprintln!("VAI plugin: render panicked at frame {frame}");
+                false
+            }
+        };
+
+        ring = shared.lock();
+        // Only composition predicts the next frame's cost; warming and
+        // previews happen once per seek
+        if let Some(elapsed) = composed {
+            ring.clock.record_render(elapsed);
+        }
+        if ring.generation != generation {
+            // A seek made this frame stale
+            ring.free.push(buffer);
+            continue;
+        }
+
+        // The same frame follows its preview, so the thumbnail is never the
+        // last picture for that PTS
+        ring.next_frame = if previewed { frame } else { frame + 1 };
+        let data = if ok {
+            Some(buffer)
+        } else {
+            ring.free.push(buffer);
+            None
+        };
+        ring.ready.push_back(Slot { frame, data });
+        shared.filled.notify_one();
+    }
+}
+
+/// Renders one frame into a ring buffer.  Returns how long composing it
+/// took, or `None` if the embedded preview stood in for it.
+///
+/// Right after a seek (`preview`) the preview is delivered first, and the
+/// same frame is rendered in full on the next call after warming the caches
+/// (`warm`); files without previews warm before composing the seek target.
+fn render(
+    compositor: &Mutex<FrameCompositor>,
+    layout: &StreamLayout,
+    frame: u64,
+    preview: bool,
+    warm: bool,
+    buffer: &mut Vec<u8>,
+) -> vai_decoder::Result<Option<Duration>> {
+    let timestamp_ms = layout.timestamp_ms(frame);
+    let mut compositor = compositor.lock().unwrap_or_else(|e| e.into_inner());
+    let i420 = layout.format == FrameFormat::I420;
+
+    if preview && render_preview(&mut compositor, layout, timestamp_ms, buffer) {
+        return Ok(None);
+    }
+    if preview || warm {
+        compositor.warm(timestamp_ms, WARM_FRAMES, i420)?;
+    }
+
+    let started = Instant::now();
+    if i420 {
+        let mut target = I420Frame::from_raw(layout.width, layout.height, std::mem::take(buffer))
+            .expect("ring buffers are frame-sized");
+        let result = compositor.render_frame_i420_into(timestamp_ms, &mut target);
+        *buffer = target.into_raw();
+        result?;
+    } else {
+        let mut target = RgbaImage::from_raw(layout.width, layout.height, std::mem::take(buffer))
+            .expect("ring buffers are frame-sized");
+        let result = compositor.render_frame_into(timestamp_ms, &mut target);
+        *buffer = target.into_raw();
+        result?;
+    }
+    Ok(Some(started.elapsed()))
+}
+
+/// Renders the embedded preview nearest `timestamp_ms`, if the file has one
+fn render_preview(
+    compositor: &mut FrameCompositor,
+    layout: &StreamLayout,
+    timestamp_ms: u64,
+    buffer: &mut Vec<u8>,
+) -> bool {
+    match layout.format {
+        FrameFormat::I420 => {
+            let mut target = I420Frame::from_raw(layout.width, layout.height, std::mem::take(buffer))
+                .expect("ring buffers are frame-sized");
+            let previewed = matches!(compositor.render_preview_i420_into(timestamp_ms, &mut target), Ok(true));
+            *buffer = target.into_raw();
+            previewed
+        }
+        FrameFormat::Rgba => match compositor.render_preview(timestamp_ms) {
+            Ok(Some(image)) => {
+                let len = buffer.len().min(image.as_raw().len());
+                buffer[..len].copy_from_slice(&image.as_raw()[..len]);
+                true
+            }
+            _ => false,
+        },
+    }
+}
@@ -26,6 +26,7 @@
 #include <vlc/plugins/vlc_es_out.h>
 #include <vlc/plugins/vlc_block.h>
 #include <vlc/plugins/vlc_stream.h>
+#include <vlc/plugins/vlc_interrupt.h>
 
 /* ── Shared info struct (matches Rust repr(C)) ── */
 typedef struct {
@@ -38,13 +39,34 @@ typedef struct {
     double   fps;
 } vai_plugin_info_t;
 
+/* ── Byte source callbacks (matches Rust repr(C)) ── */
+typedef struct {
+    void    *opaque;
+    ssize_t (*read)(void *opaque, uint8_t *buf, size_t len);
+    int     (*seek)(void *opaque, uint64_t offset);
+    void    (*thread_enter)(void *opaque);   /* optional */
+    void    (*thread_exit)(void *opaque);    /* optional */
+} vai_plugin_reader_t;
+
 /* ── Rust extern "C" functions implemented in lib.rs ── */
 extern void *vai_plugin_open(const uint8_t *data, size_t len,
                              vai_plugin_info_t *out_info);
+extern void *vai_plugin_open_stream(const vai_plugin_reader_t *reader,
+                                    vai_plugin_info_t *out_info);
 extern int   vai_plugin_render(void *handle, uint64_t timestamp_ms,
                                uint8_t *out_buf, size_t buf_size);
+extern int   vai_plugin_render_i420(void *handle, uint64_t timestamp_ms,
+                                    uint8_t *out_buf, size_t buf_size);
+extern int   vai_plugin_start(void *handle, int i420);
+extern int   vai_plugin_next_frame(void *handle, uint8_t *out_buf,
+                                   size_t buf_size, uint64_t *out_frame);
 extern void  vai_plugin_seek_frame(void *handle, uint64_t frame);
+extern uint64_t vai_plugin_dropped_frames(void *handle);
+extern void  vai_plugin_reset_clock(void *handle);
+extern void  vai_plugin_set_paused(void *handle, int paused);
 extern uint64_t vai_plugin_current_frame(void *handle);
+extern uint64_t vai_plugin_frame_timestamp_ms(void *handle, uint64_t frame);
+extern uint64_t vai_plugin_frame_at_ms(void *handle, uint64_t timestamp_ms);
 extern void  vai_plugin_advance(void *handle);
 extern void  vai_plugin_close(void *handle);
 
@@ -53,6 +75,11 @@ struct demux_sys_t {
     void           *rust_handle;   /* opaque ptr returned by vai_plugin_open */
     es_out_id_t    *es_id;
     vai_plugin_info_t info;
+    bool            i420;          /* deliver I420 instead of RGBA */
+    size_t          frame_size;    /* bytes per delivered frame */
+    uint64_t        dropped;       /* late frames already reported */
+    stream_t       *stream;        /* read by Rust through the callbacks */
+    vlc_interrupt_t *producer_intr; /* interrupts the producer's reads */
 };
 
 /* ── Forward declarations for callbacks ── */
@@ -75,48 +102,128 @@ vlc_module_begin()
 vlc_module_end()
 
 /* ═════════════════════════════════════════════════════════════════════
- *  Open – probe the stream and initialise the demuxer
+ *  Stream access for Rust
  * ═════════════════════════════════════════════════════════════════════ */
-static int Open(vlc_object_t *obj)
+static ssize_t StreamRead(void *opaque, uint8_t *buf, size_t len)
 {
-    demux_t *demux = (demux_t *)obj;
+    return vlc_stream_Read(((demux_sys_t *)opaque)->stream, buf, len);
+}
 
-    /* Probe: first 4 bytes must be "VAI\0" */
-    const uint8_t *peek;
-    if (vlc_stream_Peek(demux->s, &peek, 4) < 4)
-        return VLC_EGENERIC;
-    if (memcmp(peek, "VAI\0", 4) != 0)
-        return VLC_EGENERIC;
+static int StreamSeek(void *opaque, uint64_t offset)
+{
+    stream_t *s = ((demux_sys_t *)opaque)->stream;
+    return vlc_stream_Seek(s, offset) == VLC_SUCCESS ? 0 : -1;
+}
 
-    /* Read the entire file into a temporary buffer */
+/* The Rust producer thread reads the stream too.  It runs under its own
+ * interrupt context so Close can wake a read blocked on the network before
+ * joining the thread; the demux thread keeps VLC's input context. */
+static void StreamThreadEnter(void *opaque)
+{
+    vlc_interrupt_set(((demux_sys_t *)opaque)->producer_intr);
+}
+
+static void StreamThreadExit(void *opaque)
+{
+    (void)opaque;
+    vlc_interrupt_set(NULL);
+}
+
+static void FreeSys(demux_sys_t *sys)
+{
+    if (sys->producer_intr)
+        vlc_interrupt_destroy(sys->producer_intr);
+    free(sys);
+}
+
+/* Reads the whole file and hands the bytes to Rust (non-seekable streams) */
+static void *OpenBuffered(demux_t *demux, vai_plugin_info_t *info)
+{
     uint64_t file_size = 0;
     if (vlc_stream_GetSize(demux->s, &file_size) || file_size == 0
         || file_size > (uint64_t)1024 * 1024 * 1024)
-        return VLC_EGENERIC;
+        return NULL;
 
     uint8_t *buf = malloc((size_t)file_size);
     if (!buf)
-        return VLC_ENOMEM;
+        return NULL;
 
     ssize_t n = vlc_stream_Read(demux->s, buf, (size_t)file_size);
     if (n < 0 || (size_t)n != (size_t)file_size) {
         free(buf);
-        return VLC_EGENERIC;
+        return NULL;
     }
 
-    /* Hand the bytes to Rust for parsing */
+    void *rust_handle = vai_plugin_open(buf, (size_t)file_size, info);
+    free(buf);   /* Rust copied out the payloads it keeps */
+    return rust_handle;
+}
+
+/* ═════════════════════════════════════════════════════════════════════
+ *  Open – probe the stream and initialise the demuxer
+ * ═════════════════════════════════════════════════════════════════════ */
+static int Open(vlc_object_t *obj)
+{
+    demux_t *demux = (demux_t *)obj;
+
+    /* Probe: first 4 bytes must be "VAI\0" */
+    const uint8_t *peek;
+    if (vlc_stream_Peek(demux->s, &peek, 4) < 4)
+        return VLC_EGENERIC;
+    if (memcmp(peek, "VAI\0", 4) != 0)
+        return VLC_EGENERIC;
+
+    /* Seekable streams are opened lazily: Rust reads the index through the
+     * callbacks now and fetches asset payloads as playback needs them.
+     * Otherwise the whole file has to be read up front. */
+    bool can_seek = false;
+    vlc_stream_Control(demux->s, STREAM_CAN_SEEK, &can_seek);
+
+    /* Allocated first: the reader callbacks get it as their opaque pointer */
+    demux_sys_t *sys = calloc(1, sizeof(*sys));
+    if (!sys)
+        return VLC_ENOMEM;
+    sys->stream = demux->s;
+
     vai_plugin_info_t info;
     memset(&info, 0, sizeof(info));
 
-    void *rust_handle = vai_plugin_open(buf, (size_t)file_size, &info);
-    free(buf);   /* Rust made its own copy */
+    void *rust_handle = NULL;
+    if (can_seek) {
+        sys->producer_intr = vlc_interrupt_create();
+        if (!sys->producer_intr) {
+            FreeSys(sys);
+            return VLC_ENOMEM;
+        }
+        const vai_plugin_reader_t reader = {
+            .opaque       = sys,
+            .read         = StreamRead,
+            .seek         = StreamSeek,
+            .thread_enter = StreamThreadEnter,
+            .thread_exit  = StreamThreadExit,
+        };
+        rust_handle = vai_plugin_open_stream(&reader, &info);
+    } else {
+        rust_handle = OpenBuffered(demux, &info);
+    }
 
-    if (!rust_handle)
+    if (!rust_handle) {
+        FreeSys(sys);
         return VLC_EGENERIC;
+    }
+
+    /* Prefer planar I420: 1.5 bytes per pixel and no conversion before
+     * display.  VLC's I420 chroma planes are width/2 × height/2, so odd
+     * sizes fall back to RGBA. */
+    bool i420 = (info.width % 2 == 0) && (info.height % 2 == 0);
+    vlc_fourcc_t chroma = i420 ? VLC_CODEC_I420 : VLC_CODEC_RGBA;
+    size_t frame_size = (size_t)info.width * info.height;
+    frame_size = i420 ? frame_size + frame_size / 2 : frame_size * 4;
 
-    /* Set up an RGBA video elementary stream */
+    /* Set up a raw video elementary stream */
     es_format_t fmt;
-    es_format_Init(&fmt, VIDEO_ES, VLC_CODEC_RGBA);
+    es_format_Init(&fmt, VIDEO_ES, chroma);
+    fmt.video.i_chroma         = chroma;
     fmt.video.i_width          = info.width;
     fmt.video.i_height         = info.height;
     fmt.video.i_visible_width  = info.width;
@@ -131,26 +238,32 @@ static int Open(vlc_object_t *obj)
 
     if (!es_id) {
         vai_plugin_close(rust_handle);
+        FreeSys(sys);
         return VLC_EGENERIC;
     }
 
-    /* Allocate and populate p_sys */
-    demux_sys_t *sys = calloc(1, sizeof(*sys));
-    if (!sys) {
+    /* Frames are rendered ahead on a Rust thread; Demux only dequeues */
+    if (vai_plugin_start(rust_handle, i420) != 0) {
+        es_out_Del(demux->out, es_id);
         vai_plugin_close(rust_handle);
-        return VLC_ENOMEM;
+        FreeSys(sys);
+        return VLC_EGENERIC;
     }
+
+    /* Populate p_sys */
     sys->rust_handle = rust_handle;
     sys->es_id       = es_id;
     sys->info        = info;
+    sys->i420        = i420;
+    sys->frame_size  = frame_size;
 
     demux->p_sys     = sys;
     demux->pf_demux  = Demux;
     demux->pf_control = Control;
 
-    msg_Info(demux, "VAI: opened %ux%u @ %u/%u fps, %"PRIu64" ms, %"PRIu64" frames",
+    msg_Info(demux, "VAI: opened %ux%u @ %u/%u fps, %"PRIu64" ms, %"PRIu64" frames (%s)",
              info.width, info.height, info.fps_num, info.fps_den,
-             info.duration_ms, info.total_frames);
+             info.duration_ms, info.total_frames, i420 ? "I420" : "RGBA");
 
     return VLC_SUCCESS;
 }
@@ -164,9 +277,16 @@ static void Close(vlc_object_t *obj)
     demux_sys_t *sys  = demux->p_sys;
 
     if (sys) {
-        if (sys->rust_handle)
+        if (sys->rust_handle) {
+            uint64_t dropped = vai_plugin_dropped_frames(sys->rust_handle);
+            if (dropped > 0)
+                msg_Info(demux, "VAI: %"PRIu64" late frame(s) dropped", dropped);
+            /* Wake a producer read blocked on the stream, then join it */
+            if (sys->producer_intr)
+                vlc_interrupt_kill(sys->producer_intr);
             vai_plugin_close(sys->rust_handle);
-        free(sys);
+        }
+        FreeSys(sys);
     }
     demux->p_sys = NULL;
 }
@@ -178,34 +298,39 @@ static int Demux(demux_t *demux)
 {
     demux_sys_t *sys = demux->p_sys;
 
-    uint64_t cur = vai_plugin_current_frame(sys->rust_handle);
-    uint64_t timestamp_ms = (uint64_t)((double)cur * 1000.0 / sys->info.fps);
-
-    if (timestamp_ms >= sys->info.duration_ms)
-        return VLC_DEMUXER_EOF;
-
-    size_t frame_size = (size_t)sys->info.width * sys->info.height * 4;
+    size_t frame_size = sys->frame_size;
     block_t *blk = block_Alloc(frame_size);
     if (!blk)
         return VLC_DEMUXER_EGENERIC;
 
-    int ok = vai_plugin_render(sys->rust_handle, timestamp_ms,
-                               blk->p_buffer, frame_size);
-    if (ok != 0) {
+    /* Already rendered by the producer thread (or being finished now) */
+    uint64_t frame = 0;
+    if (vai_plugin_next_frame(sys->rust_handle, blk->p_buffer,
+                              frame_size, &frame) != 0) {
         block_Release(blk);
         return VLC_DEMUXER_EOF;
     }
 
+    /* Frames that could not make their deadline were skipped, not rendered;
+     * the frame number (and so the PTS) jumps over them */
+    uint64_t dropped = vai_plugin_dropped_frames(sys->rust_handle);
+    if (dropped > sys->dropped) {
+        msg_Dbg(demux, "VAI: dropped %"PRIu64" late frame(s) before frame %"PRIu64,
+                dropped - sys->dropped, frame);
+        sys->dropped = dropped;
+    }
+
+    /* Exact frame units, the same timestamps the compositor renders at */
+    uint64_t timestamp_ms = vai_plugin_frame_timestamp_ms(sys->rust_handle, frame);
+    uint64_t next_ms = vai_plugin_frame_timestamp_ms(sys->rust_handle, frame + 1);
     mtime_t pts = (mtime_t)timestamp_ms * 1000;   /* ms → µs */
     blk->i_pts    = pts;
     blk->i_dts    = pts;
-    blk->i_length = (mtime_t)(1000000.0 / sys->info.fps);
+    blk->i_length = (mtime_t)(next_ms - timestamp_ms) * 1000;
 
     es_out_Send(demux->out, sys->es_id, blk);
     es_out_Control(demux->out, ES_OUT_SET_PCR, pts);
 
-    vai_plugin_advance(sys->rust_handle);
-
     return VLC_DEMUXER_SUCCESS;
 }
 
@@ -226,7 +351,7 @@ static int Control(demux_t *demux, int query, va_list args)
         double *pd = va_arg(args, double *);
         if (sys->info.duration_ms > 0) {
             uint64_t cur = vai_plugin_current_frame(sys->rust_handle);
-            uint64_t ts  = (uint64_t)((double)cur * 1000.0 / sys->info.fps);
+            uint64_t ts  = vai_plugin_frame_timestamp_ms(sys->rust_handle, cur);
             *pd = (double)ts / (double)sys->info.duration_ms;
         } else {
             *pd = 0.0;
@@ -241,6 +366,20 @@ static int Control(demux_t *demux, int query, va_list args)
         vai_plugin_seek_frame(sys->rust_handle, frame);
         return VLC_SUCCESS;
     }
+    case DEMUX_CAN_PAUSE:
+    case DEMUX_CAN_CONTROL_PACE: {
+        bool *pb = va_arg(args, bool *);
+        *pb = true;
+        return VLC_SUCCESS;
+    }
+    case DEMUX_SET_PAUSE_STATE: {
+        /* Pausing and resuming both interrupt VLC's pacing; the producer
+         * must not judge lateness until it is back to real time.  Seeks
+         * while paused also skip the preview, which would stay on screen. */
+        int paused = va_arg(args, int);
+        vai_plugin_set_paused(sys->rust_handle, paused);
+        return VLC_SUCCESS;
+    }
     case DEMUX_GET_LENGTH: {
         int64_t *pi = va_arg(args, int64_t *);
         *pi = (int64_t)sys->info.duration_ms * 1000;  /* µs */
@@ -249,15 +388,13 @@ static int Control(demux_t *demux, int query, va_list args)
     case DEMUX_GET_TIME: {
         int64_t *pi = va_arg(args, int64_t *);
         uint64_t cur = vai_plugin_current_frame(sys->rust_handle);
-        *pi = (int64_t)((double)cur * 1000000.0 / sys->info.fps);
+        *pi = (int64_t)vai_plugin_frame_timestamp_ms(sys->rust_handle, cur) * 1000;
         return VLC_SUCCESS;
     }
     case DEMUX_SET_TIME: {
         int64_t us = va_arg(args, int64_t);
-        uint64_t ms = (uint64_t)(us / 1000);
-        uint64_t frame = (uint64_t)((double)ms * sys->info.fps / 1000.0);
-        if (frame >= sys->info.total_frames && sys->info.total_frames > 0)
-            frame = sys->info.total_frames - 1;
+        uint64_t ms = us > 0 ? (uint64_t)(us / 1000) : 0;
+        uint64_t frame = vai_plugin_frame_at_ms(sys->rust_handle, ms);
         vai_plugin_seek_frame(sys->rust_handle, frame);
         return VLC_SUCCESS;
     }